@@ -0,0 +1,259 @@
+#include "hex.h"
+#include "omni.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tinyformat.h>
+#include <util/strencodings.h>
+#include <vector>
+
+/**
+ * Parser benchmark over a RawTx corpus (see bench/gen_corpus.py).
+ *
+ * Every tx is run through the three stages of the RawTx API separately: building the RawTx
+ * from its json, ParseTx and OmniTx::dumps, plus "reuse", the whole json to record parse of an
+ * OmniParser that keeps its buffers between txs. Per class and stage it reports throughput and
+ * the p50/p99/p999 latency; with -json the same numbers are printed as one json document,
+ * for diffing between library versions.
+ *
+ * The hex codec of the parse path is measured on its own, on the tx hex of the corpus: "unhex"
+ * and "hex" are DecodeHex and EncodeHex, "unhex0" and "hex0" Core's per byte ParseHex and HexStr
+ * they replace. A tx is a few hundred bytes, which a clock read costs as much as, so each codec
+ * is timed over all txs of a class at once per iteration and reported in tx bytes per second.
+ *
+ *   bench.out [-corpus=bench/corpus.ndjson] [-iterations=20] [-json] [-label=<version>]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample {
+    std::string cls;
+    std::string json;
+};
+
+//! Latencies in nanoseconds of one class and stage
+struct Series {
+    std::vector<uint64_t> ns;
+    uint64_t total = 0;
+
+    void Add(Clock::duration d)
+    {
+        uint64_t n = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        ns.push_back(n);
+        total += n;
+    }
+
+    uint64_t Percentile(double p)
+    {
+        if (ns.empty()) return 0;
+        size_t k = std::min(ns.size() - 1, static_cast<size_t>(p * ns.size()));
+        std::nth_element(ns.begin(), ns.begin() + k, ns.end());
+        return ns[k];
+    }
+
+    double PerSecond() const
+    {
+        return total ? ns.size() * 1e9 / total : 0;
+    }
+};
+
+//! Time and tx bytes of the loops of one class and hex codec
+struct Throughput {
+    uint64_t ns = 0;
+    uint64_t bytes = 0;
+
+    void Add(Clock::duration d, uint64_t n)
+    {
+        ns += std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        bytes += n;
+    }
+
+    double BytesPerSecond() const
+    {
+        return ns ? bytes * 1e9 / ns : 0;
+    }
+};
+
+//! Runs codec over every tx of txs and returns the time it took
+template <typename Tx, typename Codec>
+Clock::duration timeLoop(const std::vector<Tx>& txs, Codec codec)
+{
+    auto t0 = Clock::now();
+    for (const Tx& tx : txs) {
+        codec(tx);
+    }
+    return Clock::now() - t0;
+}
+
+std::string classOf(const std::string& json)
+{
+    static const std::string key = "\"class\":\"";
+    size_t pos = json.find(key);
+    if (pos == std::string::npos) return "unknown";
+    pos += key.size();
+    return json.substr(pos, json.find('"', pos) - pos);
+}
+
+std::string argValue(int argc, char const* argv[], const std::string& name, const std::string& fallback)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], name.c_str(), name.size()) == 0 && argv[i][name.size()] == '=') {
+            return argv[i] + name.size() + 1;
+        }
+    }
+    return fallback;
+}
+
+bool argFlag(int argc, char const* argv[], const std::string& name)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i] == name) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char const* argv[])
+{
+    std::string corpusPath = argValue(argc, argv, "-corpus", "bench/corpus.ndjson");
+    int iterations = std::stoi(argValue(argc, argv, "-iterations", "20"));
+    bool json = argFlag(argc, argv, "-json");
+    std::string label = argValue(argc, argv, "-label", "");
+
+    std::ifstream corpus(corpusPath);
+    if (!corpus) {
+        std::cerr << "can't open corpus " << corpusPath << std::endl;
+        return 1;
+    }
+    std::vector<Sample> samples;
+    for (std::string line; std::getline(corpus, line);) {
+        if (!line.empty()) samples.push_back({classOf(line), line});
+    }
+
+    Init(CBaseChainParams::MAIN, false);
+
+    // class -> stage -> latencies, "all" aggregates the classes
+    static const char* stages[] = {"rawtx", "parse", "dumps", "reuse"};
+    std::map<std::string, std::map<std::string, Series>> results;
+    std::map<std::string, size_t> parsed;
+    OmniParser parser;
+    OmniTxRecord record;
+
+    for (int it = 0; it < iterations; ++it) {
+        for (const Sample& sample : samples) {
+            auto t0 = Clock::now();
+            RawTx rawTx(sample.json);
+            auto t1 = Clock::now();
+            auto tx = ParseTx(rawTx);
+            auto t2 = Clock::now();
+            std::string dumped = tx ? tx->dumps() : std::string();
+            auto t3 = Clock::now();
+            parser.Parse(sample.json.data(), sample.json.size(), &record);
+            auto t4 = Clock::now();
+
+            for (const std::string& cls : {sample.cls, std::string("all")}) {
+                auto& byStage = results[cls];
+                byStage["rawtx"].Add(t1 - t0);
+                byStage["parse"].Add(t2 - t1);
+                if (tx) byStage["dumps"].Add(t3 - t2);
+                byStage["reuse"].Add(t4 - t3);
+            }
+            if (it == 0 && tx) {
+                ++parsed[sample.cls];
+                ++parsed["all"];
+            }
+        }
+    }
+
+    // the tx hex of each class, and its bytes for the encoders
+    static const char* codecs[] = {"unhex", "unhex0", "hex", "hex0"};
+    std::map<std::string, std::vector<std::string>> hexByClass;
+    std::map<std::string, std::vector<std::vector<unsigned char>>> bytesByClass;
+    std::map<std::string, uint64_t> txBytes;
+    for (const Sample& sample : samples) {
+        std::string txHex = RawTx(sample.json).hex;
+        for (const std::string& cls : {sample.cls, std::string("all")}) {
+            hexByClass[cls].push_back(txHex);
+            bytesByClass[cls].push_back(ParseHex(txHex));
+            txBytes[cls] += txHex.size() / 2;
+        }
+    }
+
+    // class -> codec -> throughput; sink keeps the results alive
+    std::map<std::string, std::map<std::string, Throughput>> hexResults;
+    std::vector<unsigned char> bytes;
+    std::string hex;
+    size_t sink = 0;
+    for (int it = 0; it < iterations; ++it) {
+        for (const auto& [cls, txs] : hexByClass) {
+            auto& byCodec = hexResults[cls];
+            const auto& decoded = bytesByClass[cls];
+            byCodec["unhex"].Add(timeLoop(txs, [&](const std::string& h) {
+                bytes.resize(h.size() / 2);
+                sink += DecodeHex(h, bytes.data());
+            }), txBytes[cls]);
+            byCodec["unhex0"].Add(timeLoop(txs, [&](const std::string& h) { sink += ParseHex(h).size(); }), txBytes[cls]);
+            byCodec["hex"].Add(timeLoop(decoded, [&](const std::vector<unsigned char>& b) {
+                hex.resize(2 * b.size());
+                EncodeHex(b, hex.data());
+                sink += hex[0];
+            }), txBytes[cls]);
+            byCodec["hex0"].Add(timeLoop(decoded, [&](const std::vector<unsigned char>& b) { sink += HexStr(b).size(); }), txBytes[cls]);
+        }
+    }
+    if (sink == 0) std::cerr << "empty corpus" << std::endl;
+
+    if (json) {
+        std::cout << "{\"label\":\"" << label << "\",\"corpus\":\"" << corpusPath << "\",\"iterations\":" << iterations << ",\"results\":[";
+        bool first = true;
+        for (auto& [cls, byStage] : results) {
+            for (const char* stage : stages) {
+                auto found = byStage.find(stage);
+                if (found == byStage.end()) continue;
+                Series& series = found->second;
+                std::cout << (first ? "" : ",")
+                          << strprintf("{\"class\":\"%s\",\"stage\":\"%s\",\"count\":%u,\"tx_per_s\":%.0f,\"p50_ns\":%u,\"p99_ns\":%u,\"p999_ns\":%u}",
+                                 cls, stage, series.ns.size(), series.PerSecond(), series.Percentile(0.5), series.Percentile(0.99), series.Percentile(0.999));
+                first = false;
+            }
+        }
+        std::cout << "],\"hex\":[";
+        first = true;
+        for (auto& [cls, byCodec] : hexResults) {
+            for (const char* codec : codecs) {
+                const Throughput& throughput = byCodec[codec];
+                std::cout << (first ? "" : ",")
+                          << strprintf("{\"class\":\"%s\",\"codec\":\"%s\",\"tx_bytes\":%u,\"bytes_per_s\":%.0f}", cls, codec, throughput.bytes, throughput.BytesPerSecond());
+                first = false;
+            }
+        }
+        std::cout << "]}" << std::endl;
+    } else {
+        std::cout << strprintf("%d txs x %d iterations from %s\n\n", samples.size(), iterations, corpusPath);
+        std::cout << strprintf("%-6s %-6s %6s %10s %12s %10s %10s %10s\n", "class", "stage", "parsed", "count", "tx/s", "p50 us", "p99 us", "p999 us");
+        for (auto& [cls, byStage] : results) {
+            for (const char* stage : stages) {
+                auto found = byStage.find(stage);
+                if (found == byStage.end()) continue;
+                Series& series = found->second;
+                std::cout << strprintf("%-6s %-6s %6d %10d %12.0f %10.2f %10.2f %10.2f\n", cls, stage, parsed[cls], series.ns.size(), series.PerSecond(),
+                                       series.Percentile(0.5) / 1e3, series.Percentile(0.99) / 1e3, series.Percentile(0.999) / 1e3);
+            }
+        }
+        std::cout << strprintf("\n%-6s %-6s %12s %12s\n", "class", "codec", "tx bytes", "MB/s");
+        for (auto& [cls, byCodec] : hexResults) {
+            for (const char* codec : codecs) {
+                const Throughput& throughput = byCodec[codec];
+                std::cout << strprintf("%-6s %-6s %12d %12.1f\n", cls, codec, throughput.bytes, throughput.BytesPerSecond() / 1e6);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+"""Generates bench/corpus.ndjson, the RawTx corpus of the bench target.
+
+One RawTx json per line, in the shape ParseTx reads, with two extra members the parser
+skips: "class" (A, B, C, dex or none) and "expect", the parse result the tx was built for.
+The txs are synthetic mainnet txs at realistic heights, encoded the way omnicore encodes
+them (Class B obfuscated with the sender's hash chain); the RNG is seeded, so rerunning the
+script reproduces the checked in file.
+
+    python3 bench/gen_corpus.py > bench/corpus.ndjson
+"""
+
+import hashlib
+import json
+import random
+import struct
+import sys
+
+PER_CLASS = 100
+HEIGHT = 817811
+TIME = 1700577787
+
+B58 = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz"
+
+rng = random.Random(20231121)
+
+
+def sha256(data):
+    return hashlib.sha256(data).digest()
+
+
+def b58decode_check(s):
+    n = 0
+    for c in s:
+        n = n * 58 + B58.index(c)
+    raw = n.to_bytes(25, "big")
+    assert sha256(sha256(raw[:-4]))[:4] == raw[-4:]
+    return raw[:-4]
+
+
+def b58encode_check(payload):
+    raw = payload + sha256(sha256(payload))[:4]
+    n = int.from_bytes(raw, "big")
+    out = ""
+    while n:
+        n, r = divmod(n, 58)
+        out = B58[r] + out
+    pad = len(raw) - len(raw.lstrip(b"\0"))
+    return "1" * pad + out
+
+
+EXODUS_HASH = b58decode_check("1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P")[1:]
+
+
+def varint(n):
+    if n < 0xFD:
+        return bytes([n])
+    if n <= 0xFFFF:
+        return b"\xfd" + struct.pack("<H", n)
+    return b"\xfe" + struct.pack("<I", n)
+
+
+def push(data):
+    if len(data) <= 75:
+        return bytes([len(data)]) + data
+    assert len(data) <= 255
+    return b"\x4c" + bytes([len(data)]) + data
+
+
+def p2pkh(h160):
+    return b"\x76\xa9" + push(h160) + b"\x88\xac"
+
+
+def p2wpkh(h160):
+    return b"\x00" + push(h160)
+
+
+def multisig(pubkeys):
+    # 1-of-n bare multisig, OP_1 <keys> OP_n OP_CHECKMULTISIG
+    return bytes([0x51]) + b"".join(push(k) for k in pubkeys) + bytes([0x50 + len(pubkeys), 0xAE])
+
+
+def op_return(data):
+    return b"\x6a" + push(data)
+
+
+def address(h160):
+    return b58encode_check(b"\x00" + h160)
+
+
+def rand_hash160(first=None):
+    h = bytes(rng.getrandbits(8) for _ in range(20))
+    if first is not None:
+        h = bytes([first]) + h[1:]
+    return h
+
+
+def rand_pubkey():
+    return bytes([rng.choice((2, 3))]) + bytes(rng.getrandbits(8) for _ in range(32))
+
+
+def serialize(vin, vout):
+    """vin: [(txid bytes in display order, n)], vout: [(value, script)]"""
+    tx = struct.pack("<i", 2) + varint(len(vin))
+    for txid, n in vin:
+        script_sig = push(bytes(rng.getrandbits(8) for _ in range(71))) + push(rand_pubkey())
+        tx += txid[::-1] + struct.pack("<I", n) + varint(len(script_sig)) + script_sig + struct.pack("<I", 0xFFFFFFFE)
+    tx += varint(len(vout))
+    for value, script in vout:
+        tx += struct.pack("<q", value) + varint(len(script)) + script
+    tx += struct.pack("<I", HEIGHT - 1)
+    return tx
+
+
+def raw_tx(cls, idx, prevouts, vout, expect):
+    """prevouts: [(script, value)]"""
+    vin = []
+    vin_json = []
+    for script, value in prevouts:
+        txid = bytes(rng.getrandbits(8) for _ in range(32))
+        n = rng.randrange(4)
+        vin.append((txid, n))
+        vin_json.append({"txid": txid.hex(), "vout": n, "prevout": {"scriptPubKey": {"hex": script.hex()}, "value": value, "height": HEIGHT - 1 - rng.randrange(5000)}})
+    tx = serialize(vin, vout)
+    txid = sha256(sha256(tx))[::-1].hex()
+    return {"txid": txid, "height": HEIGHT, "time": TIME, "idx": idx, "hex": tx.hex(), "vin": vin_json, "class": cls, "expect": expect}
+
+
+def simple_send(prop, amount):
+    return struct.pack(">HHIQ", 0, 0, prop, amount)
+
+
+def create_fixed(name, url, data, amount):
+    # version 0, type 50, ecosystem 1, divisible, no previous property
+    fields = [b"Companies", b"Bitcoin Mining", name, url, data]
+    return struct.pack(">HHBHI", 0, 50, 1, 2, 0) + b"".join(f + b"\0" for f in fields) + struct.pack(">Q", amount)
+
+
+def class_a(idx):
+    sender = rand_hash160()
+    in_value = 100000 + rng.randrange(10 ** 7)
+    amount = 1 + rng.randrange(10 ** 10)
+    seq = rng.randrange(1, 250)
+    data = bytes([seq]) + simple_send(1, amount)[:8] + struct.pack(">Q", amount) + b"\0\0\0"
+    reference = rand_hash160(first=seq + 1)
+    change = rand_hash160(first=(seq + 3) % 256)
+    dust = 6000
+    vout = [(dust, p2pkh(EXODUS_HASH)), (dust, p2pkh(data[:20])), (dust, p2pkh(reference)), (in_value - 4 * dust - 10000, p2pkh(change))]
+    rng.shuffle(vout)
+    expect = {"status": 0, "type": 0, "propertyid": 1, "amount": amount, "sendingaddress": address(sender), "referenceaddress": address(reference)}
+    return raw_tx("A", idx, [(p2pkh(sender), in_value)], vout, expect)
+
+
+def obfuscate(sender_address, payload):
+    """Class B packets: seqnum + 30 payload bytes each, xor'ed with the sender's hash chain"""
+    chunks = [payload[i:i + 30] for i in range(0, len(payload), 30)]
+    keys = []
+    digest = sha256(sender_address.encode())
+    for k, chunk in enumerate(chunks):
+        if k:
+            digest = sha256(digest.hex().upper().encode())
+        packet = bytes([k + 1]) + chunk.ljust(30, b"\0")
+        obfuscated = bytes(a ^ b for a, b in zip(packet, digest[:31]))
+        keys.append(bytes([2]) + obfuscated + bytes([rng.getrandbits(8)]))
+    return keys
+
+
+def class_b(idx):
+    sender = rand_hash160()
+    sender_address = address(sender)
+    in_value = 100000 + rng.randrange(10 ** 7)
+    amount = 1 + rng.randrange(10 ** 12)
+    if rng.random() < 0.5:
+        payload = simple_send(31, amount)
+        expect = {"status": 0, "type": 0, "propertyid": 31, "amount": amount}
+        reference = rand_hash160()
+    else:
+        name = "Token %d" % rng.randrange(10 ** 6)
+        payload = create_fixed(name.encode(), b"https://example.com/" + name.replace(" ", "").lower().encode(), b"synthetic bench property " * rng.randrange(1, 4), amount)
+        expect = {"status": 0, "type": 50, "propertyid": 0, "amount": amount}
+        reference = None
+    keys = obfuscate(sender_address, payload)
+    vout = [(5460, p2pkh(EXODUS_HASH))]
+    if reference:
+        vout.append((5460, p2pkh(reference)))
+    # two data keys per output next to the sender's key, as omnicore's Class B encoder packs them
+    for i in range(0, len(keys), 2):
+        vout.append((7800, multisig([rand_pubkey()] + keys[i:i + 2])))
+    vout.append((in_value - 30000 - 7800 * len(keys), p2pkh(sender)))
+    expect["sendingaddress"] = sender_address
+    if reference:
+        expect["referenceaddress"] = address(reference)
+    return raw_tx("B", idx, [(p2pkh(sender), in_value)], vout, expect)
+
+
+def class_c(idx):
+    sender = rand_hash160()
+    in_value = 10000 + rng.randrange(10 ** 7)
+    amount = 1 + rng.randrange(10 ** 12)
+    reference = rand_hash160()
+    kind = rng.random()
+    if kind < 0.7:
+        payload = simple_send(31, amount)
+        expect = {"status": 0, "type": 0, "propertyid": 31, "amount": amount}
+    elif kind < 0.85:
+        payload = struct.pack(">HHB", 0, 4, 1)
+        expect = {"status": 0, "type": 4, "propertyid": 0, "amount": 0}
+    else:
+        payload = create_fixed(b"C token", b"", b"", amount)
+        expect = {"status": 0, "type": 50, "propertyid": 0, "amount": amount}
+        reference = None
+    vout = [(0, op_return(b"omni" + payload))]
+    if reference:
+        vout.append((546, p2pkh(reference)))
+    vout.append((in_value - 546 - 2000, p2pkh(sender)))
+    expect["sendingaddress"] = address(sender)
+    if reference:
+        expect["referenceaddress"] = address(reference)
+    return raw_tx("C", idx, [(p2pkh(sender), in_value)], vout, expect)
+
+
+def dex_payment(idx):
+    # a BTC payment for a DEx offer: Class A marker, no data address
+    buyer = rand_hash160()
+    in_value = 10 ** 6 + rng.randrange(10 ** 8)
+    vout = [(6000, p2pkh(EXODUS_HASH)), (in_value // 2, p2pkh(rand_hash160())), (in_value // 2 - 16000, p2pkh(buyer))]
+    return raw_tx("dex", idx, [(p2pkh(buyer), in_value)], vout, {"status": -202})
+
+
+def non_omni(idx):
+    inputs = [(p2pkh(rand_hash160()), 10 ** 5 + rng.randrange(10 ** 8)) for _ in range(rng.randrange(1, 4))]
+    total = sum(v for _, v in inputs)
+    vout = [(total // 3, p2pkh(rand_hash160())), (total // 3, p2wpkh(rand_hash160()))]
+    return raw_tx("none", idx, inputs, vout, {"status": -1})
+
+
+def main():
+    makers = [class_a, class_b, class_c, dex_payment, non_omni]
+    txs = []
+    for make in makers:
+        txs += [make(len(txs) + i + 1) for i in range(PER_CLASS)]
+    rng.shuffle(txs)
+    for tx in txs:
+        sys.stdout.write(json.dumps(tx, separators=(",", ":")) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -137,10 +137,31 @@ fn main() -> miette::Result<()> {
     .build()
     .expect("Unable to generate bindings");
 
+    // the no-trace feature compiles the parser trace points out
+    if env::var("CARGO_FEATURE_NO_TRACE").is_ok() {
+        build.define("OMNI_DISABLE_TRACE", None);
+    }
+
     build
         .flag_if_supported("-std=c++17")
         .define("HAVE_CONFIG_H", None)
         .file(&src.join("omni.cpp"))
+        .file(&src.join("prefilter.cpp"))
+        .file(&src.join("rawtx_json.cpp"))
+        .file(&src.join("rawtx_bin.cpp"))
+        .file(&src.join("payload.cpp"))
+        .file(&src.join("addresscache.cpp"))
+        .file(&src.join("parserstate.cpp"))
+        .file(&src.join("trace.cpp"))
+        .file(&src.join("metrics.cpp"))
+        .file(&src.join("prevoutstore.cpp"))
+        .file(&src.join("parsebuffers.cpp"))
+        .file(&src.join("parsecache.cpp"))
+        .file(&src.join("blockfiles.cpp"))
+        .file(&src.join("watchlist.cpp"))
+        .file(&src.join("hex.cpp"))
+        .file(&src.join("balances.cpp"))
+        .file(&src.join("parsequeue.cpp"))
         .compile("omni_ffi");
 
     // println!(
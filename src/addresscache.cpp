@@ -0,0 +1,60 @@
+#include "addresscache.h"
+#include <algorithm>
+
+AddressCache::AddressCache(size_t capacity)
+{
+    SetCapacity(capacity);
+}
+
+void AddressCache::SetCapacity(size_t capacity)
+{
+    m_shardCapacity = std::max<size_t>(1, capacity / SHARDS);
+}
+
+AddressCache::Stats AddressCache::GetStats() const
+{
+    Stats stats{};
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    stats.misses = m_misses.load(std::memory_order_relaxed);
+    stats.evictions = m_evictions.load(std::memory_order_relaxed);
+    for (const Shard& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.size += shard.map.size();
+    }
+    return stats;
+}
+
+AddressCache::Shard& AddressCache::shardOf(const Key& key)
+{
+    // the low bits pick the bucket inside the shard's map, use the high ones here
+    return m_shards[(KeyHasher()(key) >> 28) % SHARDS];
+}
+
+bool AddressCache::lookup(const Key& key, std::string& address)
+{
+    Shard& shard = shardOf(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it != shard.map.end()) {
+            address = it->second;
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void AddressCache::insert(const Key& key, const std::string& address)
+{
+    Shard& shard = shardOf(key);
+    size_t capacity = m_shardCapacity.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    while (!shard.map.empty() && shard.map.size() >= capacity) {
+        shard.map.erase(shard.map.begin());
+        m_evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.map.emplace(key, address);
+}
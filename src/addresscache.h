@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * Bounded, thread-safe cache from scriptPubKey to its encoded address.
+ *
+ * Entries are keyed by chain and encoding kind next to the script bytes, so one cache
+ * serves every chain and both the plain and the Omni address encodings. The cache is
+ * split into shards with a lock each; a full shard evicts an arbitrary entry.
+ */
+class AddressCache
+{
+public:
+    enum Kind : uint8_t {
+        BITCOIN = 0, //! EncodeDestination
+        OMNI = 1,    //! TryEncodeOmniAddress(EncodeDestination)
+    };
+
+    //! Largest script with an address, an uncompressed P2PK; longer scripts bypass the cache
+    static constexpr size_t MAX_SCRIPT_SIZE = 67;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t size;
+    };
+
+    explicit AddressCache(size_t capacity);
+
+    //! Upper bound of entries, applied as entries are added
+    void SetCapacity(size_t capacity);
+    Stats GetStats() const;
+
+    /**
+     * Sets address to the cached address of script, or to what encode(address) produces on a miss.
+     * Returns false, without caching, if encode does.
+     */
+    template <typename Fn>
+    bool Get(uint8_t chain, Kind kind, Span<const unsigned char> script, std::string& address, Fn encode)
+    {
+        if (script.size() > MAX_SCRIPT_SIZE) {
+            return encode(address);
+        }
+
+        Key key;
+        key.chain = chain;
+        key.kind = kind;
+        key.size = script.size();
+        std::memcpy(key.script, script.data(), script.size());
+
+        if (lookup(key, address)) return true;
+        if (!encode(address)) return false;
+        insert(key, address);
+        return true;
+    }
+
+private:
+    static constexpr size_t SHARDS = 16;
+
+    struct Key {
+        uint8_t chain;
+        uint8_t kind;
+        uint8_t size;
+        unsigned char script[MAX_SCRIPT_SIZE];
+
+        //! the members in use are contiguous
+        std::string_view Bytes() const
+        {
+            return std::string_view(reinterpret_cast<const char*>(&chain), 3 + size);
+        }
+        bool operator==(const Key& other) const
+        {
+            return Bytes() == other.Bytes();
+        }
+    };
+
+    struct KeyHasher {
+        size_t operator()(const Key& key) const
+        {
+            return std::hash<std::string_view>()(key.Bytes());
+        }
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<Key, std::string, KeyHasher> map;
+    };
+
+    bool lookup(const Key& key, std::string& address);
+    void insert(const Key& key, const std::string& address);
+    Shard& shardOf(const Key& key);
+
+    Shard m_shards[SHARDS];
+    std::atomic<size_t> m_shardCapacity;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_evictions{0};
+};
@@ -0,0 +1,530 @@
+#include "balances.h"
+#include "blockfiles.h"
+#include "omni.h"
+#include "parserstate.h"
+#include <algorithm>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <cstring>
+#include <fcntl.h>
+#include <omnicore/log.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/rules.h>
+#include <omnicore/sp.h>
+#include <omnicore/tx.h>
+#include <sys/mman.h>
+#include <tinyformat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace mastercore;
+
+namespace {
+
+// snapshot header: magic, version, chain, height, time, body size, SHA256 of the body
+constexpr unsigned char SNAPSHOT_MAGIC[8] = {'o', 'm', 'n', 'i', 'b', 'a', 'l', 0};
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+constexpr size_t SNAPSHOT_HEADER = 8 + 4 + 4 + 4 + 8 + 8 + CSHA256::OUTPUT_SIZE;
+
+//! Little endian writer into a snapshot, or only a byte counter when there is no buffer
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(unsigned char* buffer) : m_buffer(buffer) {}
+
+    void U8(uint8_t n)
+    {
+        if (m_buffer) m_buffer[m_pos] = n;
+        m_pos += 1;
+    }
+    void U32(uint32_t n)
+    {
+        if (m_buffer) WriteLE32(m_buffer + m_pos, n);
+        m_pos += 4;
+    }
+    void I64(int64_t n)
+    {
+        if (m_buffer) WriteLE64(m_buffer + m_pos, n);
+        m_pos += 8;
+    }
+    //! Addresses and issuers, a byte of length and the characters
+    void Str(const std::string& str)
+    {
+        uint8_t size = std::min<size_t>(str.size(), 255);
+        U8(size);
+        if (m_buffer) memcpy(m_buffer + m_pos, str.data(), size);
+        m_pos += size;
+    }
+
+    size_t Pos() const
+    {
+        return m_pos;
+    }
+
+private:
+    unsigned char* m_buffer;
+    size_t m_pos{0};
+};
+
+//! Bounds checked reader of a snapshot body
+class SnapshotReader
+{
+public:
+    explicit SnapshotReader(Span<const unsigned char> data) : m_data(data) {}
+
+    bool U8(uint8_t& n)
+    {
+        if (m_data.size() - m_pos < 1) return false;
+        n = m_data[m_pos++];
+        return true;
+    }
+    bool U32(uint32_t& n)
+    {
+        if (m_data.size() - m_pos < 4) return false;
+        n = ReadLE32(m_data.data() + m_pos);
+        m_pos += 4;
+        return true;
+    }
+    bool I64(int64_t& n)
+    {
+        if (m_data.size() - m_pos < 8) return false;
+        n = ReadLE64(m_data.data() + m_pos);
+        m_pos += 8;
+        return true;
+    }
+    bool Str(std::string& str)
+    {
+        uint8_t size;
+        if (!U8(size) || m_data.size() - m_pos < size) return false;
+        str.assign(reinterpret_cast<const char*>(m_data.data() + m_pos), size);
+        m_pos += size;
+        return true;
+    }
+
+    bool AtEnd() const
+    {
+        return m_pos == m_data.size();
+    }
+
+private:
+    Span<const unsigned char> m_data;
+    size_t m_pos{0};
+};
+
+//! The amount checks of omnicore's logic, an amount has to fit an int64_t and be positive
+bool isValidAmount(uint64_t amount)
+{
+    return amount > 0 && amount <= static_cast<uint64_t>(MAX_INT_8_BYTES);
+}
+
+} // namespace
+
+BalanceEngine::BalanceEngine(const ParserState& state, fs::path checkpoint, int interval)
+    : m_state(state), m_checkpoint(std::move(checkpoint)), m_interval(interval)
+{
+    // OMNI and TOMNI exist from the start, with the balances of the Exodus crowdsale that no Omni tx carries
+    m_properties[OMNI_PROPERTY_MSC] = {OMNI_PROPERTY_MSC, PropertyKind::NATIVE, false, 0, ""};
+    m_properties[OMNI_PROPERTY_TMSC] = {OMNI_PROPERTY_TMSC, PropertyKind::NATIVE, false, 0, ""};
+    m_nextMain = OMNI_PROPERTY_TMSC + 1;
+    m_nextTest = TEST_ECO_PROPERTY_1;
+}
+
+int BalanceEngine::Height() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_height;
+}
+
+int64_t BalanceEngine::GetBalance(const std::string& address, uint32_t property, TallyType type) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_tally.find(address);
+    return it == m_tally.end() ? 0 : it->second.getMoney(property, type);
+}
+
+bool BalanceEngine::IsExact(uint32_t property) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Property* entry = findProperty(property);
+    return entry && entry->exact;
+}
+
+const BalanceEngine::Property* BalanceEngine::findProperty(uint32_t property) const
+{
+    auto it = m_properties.find(property);
+    return it == m_properties.end() ? nullptr : &it->second;
+}
+
+void BalanceEngine::markInexact(uint32_t property)
+{
+    auto it = m_properties.find(property);
+    if (it != m_properties.end()) it->second.exact = false;
+}
+
+bool& BalanceEngine::uncertain(uint8_t ecosystem)
+{
+    return ecosystem == OMNI_PROPERTY_TMSC ? m_uncertainTest : m_uncertainMain;
+}
+
+uint32_t BalanceEngine::createProperty(uint8_t ecosystem, PropertyKind kind, const std::string& issuer)
+{
+    // numbered in order of creation per ecosystem, as CMPSPInfo::putSP does
+    uint32_t property = ecosystem == OMNI_PROPERTY_TMSC ? m_nextTest++ : m_nextMain++;
+    m_properties[property] = {ecosystem, kind, kind != PropertyKind::VARIABLE && !uncertain(ecosystem), 0, issuer};
+    return property;
+}
+
+bool BalanceEngine::move(const std::string& from, const std::string& to, uint32_t property, int64_t amount)
+{
+    // updateMoney refuses to take a balance below zero
+    if (!m_tally[from].updateMoney(property, -amount, BALANCE)) return false;
+    m_tally[to].updateMoney(property, amount, BALANCE);
+    return true;
+}
+
+bool BalanceEngine::applyTx(int height, int64_t time, const BalanceTx& tx)
+{
+    const OmniPayload& payload = *tx.payload;
+    const PayloadTokens& tokens = payload.tokens;
+    auto allowed = [&](uint32_t property) { return m_state.IsTransactionTypeAllowed(height, property, payload.type, payload.version); };
+
+    switch (payload.type) {
+    case MSC_TYPE_SIMPLE_SEND: {
+        if (!allowed(tokens.property) || !isValidAmount(tokens.amount) || !findProperty(tokens.property) || tx.receiver.empty()) return false;
+        if (!move(tx.sender, tx.receiver, tokens.property, tokens.amount)) return false;
+        // a send to the issuer of a crowdsale that accepts the property buys tokens of the crowdsale, which is inexact already
+        return true;
+    }
+    case MSC_TYPE_SEND_ALL: {
+        uint8_t ecosystem = payload.send_all.ecosystem;
+        if (!allowed(ecosystem) || (ecosystem != OMNI_PROPERTY_MSC && ecosystem != OMNI_PROPERTY_TMSC) || tx.receiver.empty()) return false;
+        auto it = m_tally.find(tx.sender);
+        if (it == m_tally.end()) return false;
+
+        // collected first, the receiver may be the sender
+        std::vector<std::pair<uint32_t, int64_t>> sent;
+        CMPTally& tally = it->second;
+        tally.init();
+        for (uint32_t property; (property = tally.next()) != 0;) {
+            if (isTestEcosystemProperty(property) != (ecosystem == OMNI_PROPERTY_TMSC)) continue;
+            int64_t available = tally.getMoney(property, BALANCE);
+            if (available > 0) sent.emplace_back(property, available);
+        }
+        for (const auto& [property, amount] : sent) {
+            move(tx.sender, tx.receiver, property, amount);
+        }
+        return !sent.empty();
+    }
+    case MSC_TYPE_CREATE_PROPERTY_FIXED:
+    case MSC_TYPE_CREATE_PROPERTY_VARIABLE:
+    case MSC_TYPE_CREATE_PROPERTY_MANUAL: {
+        const PayloadCreateProperty& create = payload.create_property;
+        if (!allowed(create.ecosystem) || (create.ecosystem != OMNI_PROPERTY_MSC && create.ecosystem != OMNI_PROPERTY_TMSC)) return false;
+        bool nonfungible = payload.type == MSC_TYPE_CREATE_PROPERTY_MANUAL && create.property_type == MSC_PROPERTY_TYPE_NONFUNGIBLE;
+        if (create.property_type != MSC_PROPERTY_TYPE_INDIVISIBLE && create.property_type != MSC_PROPERTY_TYPE_DIVISIBLE && !nonfungible) return false;
+        if (create.name[0] == 0) return false;
+        if (nonfungible && !m_state.IsFeatureActivated(FEATURE_NONFUNGIBLE, height)) {
+            // an activation tx the params don't know of may have enabled it, then omnicore numbers this one
+            uncertain(create.ecosystem) = true;
+            return false;
+        }
+
+        if (payload.type == MSC_TYPE_CREATE_PROPERTY_FIXED) {
+            if (!isValidAmount(create.amount)) return false;
+            uint32_t property = createProperty(create.ecosystem, PropertyKind::FIXED, tx.sender);
+            m_properties[property].total = create.amount;
+            m_tally[tx.sender].updateMoney(property, create.amount, BALANCE);
+        } else if (payload.type == MSC_TYPE_CREATE_PROPERTY_VARIABLE) {
+            if (!findProperty(create.property_desired) || !isValidAmount(create.amount) || create.deadline < time) return false;
+            // a crowdsale may take tokens of the other ecosystem until the crossover feature
+            bool crossover = isTestEcosystemProperty(create.property_desired) != (create.ecosystem == OMNI_PROPERTY_TMSC);
+            if (crossover && m_state.IsFeatureActivated(FEATURE_SPCROWDCROSSOVER, height)) return false;
+            if (m_crowdsales.count(tx.sender)) {
+                // the open crowdsale may have sold out unseen, then omnicore numbers this one
+                uncertain(create.ecosystem) = true;
+                return false;
+            }
+            uint32_t property = createProperty(create.ecosystem, PropertyKind::VARIABLE, tx.sender);
+            m_crowdsales[tx.sender] = {property, create.deadline};
+        } else {
+            uint32_t property = createProperty(create.ecosystem, PropertyKind::MANAGED, tx.sender);
+            // the ranges of non-fungible tokens aren't kept
+            if (nonfungible) markInexact(property);
+        }
+        return true;
+    }
+    case MSC_TYPE_CLOSE_CROWDSALE: {
+        auto it = m_crowdsales.find(tx.sender);
+        if (!allowed(tokens.property) || it == m_crowdsales.end() || it->second.property != tokens.property) return false;
+        m_crowdsales.erase(it);
+        return true;
+    }
+    case MSC_TYPE_GRANT_PROPERTY_TOKENS:
+    case MSC_TYPE_REVOKE_PROPERTY_TOKENS: {
+        auto it = m_properties.find(tokens.property);
+        if (!allowed(tokens.property) || !isValidAmount(tokens.amount) || it == m_properties.end()) return false;
+        Property& entry = it->second;
+        if (entry.kind != PropertyKind::MANAGED || entry.issuer != tx.sender) return false;
+
+        int64_t amount = tokens.amount;
+        if (payload.type == MSC_TYPE_GRANT_PROPERTY_TOKENS) {
+            if (amount > static_cast<int64_t>(MAX_INT_8_BYTES) - entry.total) return false;
+            // without a reference the issuer grants to itself
+            m_tally[tx.receiver.empty() ? tx.sender : tx.receiver].updateMoney(tokens.property, amount, BALANCE);
+            entry.total += amount;
+            // before FEATURE_GRANTEFFECTS a grant to the issuer of a crowdsale that accepts the property buys tokens of the crowdsale, which is inexact already
+        } else {
+            if (!m_tally[tx.sender].updateMoney(tokens.property, -amount, BALANCE)) return false;
+            entry.total -= amount;
+        }
+        return true;
+    }
+    case MSC_TYPE_CHANGE_ISSUER_ADDRESS: {
+        auto it = m_properties.find(tokens.property);
+        if (!allowed(tokens.property) || it == m_properties.end() || it->second.issuer != tx.sender || tx.receiver.empty()) return false;
+        auto crowdsale = m_crowdsales.find(tx.sender);
+        if (crowdsale != m_crowdsales.end() && crowdsale->second.property == tokens.property) return false;
+        it->second.issuer = tx.receiver;
+        return true;
+    }
+    case MSC_TYPE_SEND_TO_OWNERS:
+        // the owners and the OMNI fee per owner
+        markInexact(tokens.property);
+        markInexact(tokens.distribution_property ? tokens.distribution_property : tokens.property);
+        markInexact(isTestEcosystemProperty(tokens.property) ? OMNI_PROPERTY_TMSC : OMNI_PROPERTY_MSC);
+        return true;
+    case MSC_TYPE_TRADE_OFFER:
+        markInexact(payload.dex_offer.property);
+        return true;
+    case MSC_TYPE_ACCEPT_OFFER_BTC:
+    case MSC_TYPE_ENABLE_FREEZING:
+    case MSC_TYPE_DISABLE_FREEZING:
+    case MSC_TYPE_ADD_DELEGATE:
+    case MSC_TYPE_REMOVE_DELEGATE:
+    case MSC_TYPE_FREEZE_PROPERTY_TOKENS:
+    case MSC_TYPE_UNFREEZE_PROPERTY_TOKENS:
+        markInexact(tokens.property);
+        return true;
+    case MSC_TYPE_SEND_NONFUNGIBLE:
+        markInexact(payload.nonfungible.property);
+        return true;
+    case MSC_TYPE_SEND_TO_MANY:
+        markInexact(payload.send_to_many.property);
+        return true;
+    case MSC_TYPE_METADEX_TRADE:
+    case MSC_TYPE_METADEX_CANCEL_PRICE:
+    case MSC_TYPE_METADEX_CANCEL_PAIR:
+        markInexact(payload.metadex.property);
+        markInexact(payload.metadex.property_desired);
+        return true;
+    case MSC_TYPE_METADEX_CANCEL_ECOSYSTEM:
+        // any of the ecosystem's properties may have had an order of the sender
+        for (auto& [property, entry] : m_properties) {
+            if (isTestEcosystemProperty(property) == (payload.metadex.ecosystem == OMNI_PROPERTY_TMSC)) entry.exact = false;
+        }
+        return true;
+    default:
+        // no balance changes: data, activations, alerts
+        return true;
+    }
+}
+
+void BalanceEngine::ApplyBlock(int height, int64_t time, Span<const BalanceTx> txs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (height <= m_height) return;
+
+    // eraseExpiredCrowdsale of omnicore, at the start of the block
+    for (auto it = m_crowdsales.begin(); it != m_crowdsales.end();) {
+        it = time > it->second.deadline ? m_crowdsales.erase(it) : std::next(it);
+    }
+    for (const BalanceTx& tx : txs) {
+        applyTx(height, time, tx);
+    }
+    m_height = height;
+    m_time = time;
+
+    if (m_interval > 0 && height % m_interval == 0) {
+        std::string error;
+        if (!writeSnapshot(error)) PrintToLog("%s() ERROR: balance checkpoint at height %d: %s\n", __func__, height, error);
+    }
+}
+
+size_t BalanceEngine::serialize(unsigned char* buffer)
+{
+    SnapshotWriter writer(buffer);
+    writer.U32(m_nextMain);
+    writer.U32(m_nextTest);
+    writer.U8(m_uncertainMain);
+    writer.U8(m_uncertainTest);
+
+    writer.U32(m_properties.size());
+    for (const auto& [property, entry] : m_properties) {
+        writer.U32(property);
+        writer.U8(entry.ecosystem);
+        writer.U8(static_cast<uint8_t>(entry.kind));
+        writer.U8(entry.exact);
+        writer.I64(entry.total);
+        writer.Str(entry.issuer);
+    }
+
+    writer.U32(m_crowdsales.size());
+    for (const auto& [issuer, crowdsale] : m_crowdsales) {
+        writer.Str(issuer);
+        writer.U32(crowdsale.property);
+        writer.I64(crowdsale.deadline);
+    }
+
+    writer.U32(m_tally.size());
+    std::vector<uint32_t> properties;
+    for (auto& [address, tally] : m_tally) {
+        properties.clear();
+        tally.init();
+        for (uint32_t property; (property = tally.next()) != 0;) {
+            properties.push_back(property);
+        }
+        writer.Str(address);
+        writer.U32(properties.size());
+        for (uint32_t property : properties) {
+            // a mask of the tally types that aren't zero, then their amounts; most addresses only have a balance
+            uint8_t mask = 0;
+            for (int type = 0; type < TALLY_TYPE_COUNT; ++type) {
+                if (tally.getMoney(property, static_cast<TallyType>(type))) mask |= 1 << type;
+            }
+            writer.U32(property);
+            writer.U8(mask);
+            for (int type = 0; type < TALLY_TYPE_COUNT; ++type) {
+                if (mask & 1 << type) writer.I64(tally.getMoney(property, static_cast<TallyType>(type)));
+            }
+        }
+    }
+    return writer.Pos();
+}
+
+bool BalanceEngine::deserialize(Span<const unsigned char> body)
+{
+    SnapshotReader reader(body);
+    uint8_t uncertainMain, uncertainTest;
+    if (!reader.U32(m_nextMain) || !reader.U32(m_nextTest) || !reader.U8(uncertainMain) || !reader.U8(uncertainTest)) return false;
+    m_uncertainMain = uncertainMain;
+    m_uncertainTest = uncertainTest;
+
+    uint32_t count;
+    if (!reader.U32(count)) return false;
+    m_properties.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t property;
+        uint8_t kind, exact;
+        Property entry;
+        if (!reader.U32(property) || !reader.U8(entry.ecosystem) || !reader.U8(kind) || !reader.U8(exact) || !reader.I64(entry.total) || !reader.Str(entry.issuer)) return false;
+        entry.kind = static_cast<PropertyKind>(kind);
+        entry.exact = exact;
+        m_properties[property] = entry;
+    }
+
+    if (!reader.U32(count)) return false;
+    m_crowdsales.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string issuer;
+        Crowdsale crowdsale;
+        if (!reader.Str(issuer) || !reader.U32(crowdsale.property) || !reader.I64(crowdsale.deadline)) return false;
+        m_crowdsales[issuer] = crowdsale;
+    }
+
+    if (!reader.U32(count)) return false;
+    m_tally.clear();
+    m_tally.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string address;
+        uint32_t entries;
+        if (!reader.Str(address) || !reader.U32(entries)) return false;
+        CMPTally& tally = m_tally[address];
+        for (uint32_t j = 0; j < entries; ++j) {
+            uint32_t property;
+            uint8_t mask;
+            if (!reader.U32(property) || !reader.U8(mask)) return false;
+            for (int type = 0; type < TALLY_TYPE_COUNT; ++type) {
+                int64_t amount;
+                if (!(mask & 1 << type)) continue;
+                if (!reader.I64(amount) || amount < 0) return false;
+                tally.updateMoney(property, amount, static_cast<TallyType>(type));
+            }
+        }
+    }
+    return reader.AtEnd();
+}
+
+bool BalanceEngine::Checkpoint(std::string& error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return writeSnapshot(error);
+}
+
+bool BalanceEngine::writeSnapshot(std::string& error)
+{
+    // sized by a counting pass, then written straight into the mapping of a new file
+    size_t bodySize = serialize(nullptr);
+    size_t size = SNAPSHOT_HEADER + bodySize;
+    fs::path tmp = m_checkpoint;
+    tmp += ".tmp";
+
+    int fd = open(fs::PathToString(tmp).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = strprintf("can't create %s", fs::PathToString(tmp));
+        return false;
+    }
+    void* data = ftruncate(fd, size) == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (data == MAP_FAILED) {
+        close(fd);
+        error = strprintf("can't map %u bytes of %s", size, fs::PathToString(tmp));
+        return false;
+    }
+
+    unsigned char* header = static_cast<unsigned char*>(data);
+    unsigned char* body = header + SNAPSHOT_HEADER;
+    serialize(body);
+    memcpy(header, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    WriteLE32(header + 8, SNAPSHOT_VERSION);
+    WriteLE32(header + 12, m_state.ChainId());
+    WriteLE32(header + 16, m_height);
+    WriteLE64(header + 20, m_time);
+    WriteLE64(header + 28, bodySize);
+    CSHA256().Write(body, bodySize).Finalize(header + 36);
+
+    bool synced = msync(data, size, MS_SYNC) == 0 && fsync(fd) == 0;
+    munmap(data, size);
+    close(fd);
+    if (!synced || rename(fs::PathToString(tmp).c_str(), fs::PathToString(m_checkpoint).c_str()) != 0) {
+        error = strprintf("can't write %s", fs::PathToString(m_checkpoint));
+        return false;
+    }
+    return true;
+}
+
+bool BalanceEngine::Load(std::string& error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!fs::exists(m_checkpoint)) return true;
+
+    MappedFile file(m_checkpoint);
+    Span<const unsigned char> data = file.Data();
+    if (data.size() < SNAPSHOT_HEADER || memcmp(data.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || ReadLE32(data.data() + 8) != SNAPSHOT_VERSION) {
+        error = strprintf("%s is not a balance checkpoint", fs::PathToString(m_checkpoint));
+        return false;
+    }
+    if (ReadLE32(data.data() + 12) != m_state.ChainId()) {
+        error = strprintf("%s is a checkpoint of another chain", fs::PathToString(m_checkpoint));
+        return false;
+    }
+
+    Span<const unsigned char> body = data.subspan(SNAPSHOT_HEADER);
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(body.data(), body.size()).Finalize(hash);
+    if (ReadLE64(data.data() + 28) != body.size() || memcmp(hash, data.data() + 36, sizeof(hash)) != 0 || !deserialize(body)) {
+        error = strprintf("%s is damaged", fs::PathToString(m_checkpoint));
+        return false;
+    }
+    m_height = static_cast<int32_t>(ReadLE32(data.data() + 16));
+    m_time = ReadLE64(data.data() + 20);
+    return true;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <fs.h>
+#include <map>
+#include <mutex>
+#include <omnicore/tally.h>
+#include <span.h>
+#include <string>
+#include <unordered_map>
+
+class ParserState;
+struct OmniPayload;
+
+//! An Omni tx as BalanceEngine applies it: its payload and the addresses it names, formatted
+struct BalanceTx {
+    const OmniPayload* payload;
+    std::string sender;
+    std::string receiver; // the reference address, empty for none
+};
+
+/**
+ * Omni balances in memory, kept by applying the Omni txs of every block in chain order to one
+ * CMPTally per address, as omnicore's mp_tally_map does.
+ *
+ * The engine applies the token movements it can check from a tx and the state it keeps:
+ * simple sends, send all, property creation with omnicore's numbering, grants and revokes of
+ * managed properties, issuer changes and crowdsale closes, each only if omnicore's logic would
+ * accept it (type allowed at the height, features active by the chain's params, property known,
+ * sender issuer, balance sufficient).
+ * Balances of those properties are the ones omnicore has. The other types need state the
+ * engine doesn't keep (the DEx and MetaDEx order books, crowdsale purchases, the STO owner
+ * list, send-to-many outputs, non-fungible ranges, freezing): they mark the properties they
+ * name as inexact, see IsExact, and so are OMNI and TOMNI, whose balances start with the
+ * 2013 Exodus crowdsale. A crowdsale that sells out closes early without a tx, which the
+ * engine doesn't see: once it refuses a crowdsale because the issuer's last one may still be
+ * open, omnicore may have numbered one more property in that ecosystem, and every property
+ * created there afterwards is inexact. The same goes for a creation refused because the
+ * chain's params don't activate its feature yet: an activation tx, which the engine doesn't
+ * apply, may have.
+ *
+ * Balances start at the first block applied, which has to be before the first Omni tx of the
+ * chain, or at a checkpoint. Checkpoints are snapshots of the whole state in one file, written
+ * through a memory mapping every interval blocks and renamed over the last one, so a crash
+ * leaves the previous snapshot in place. Reorgs are not undone. All methods lock, reads may
+ * run concurrently with ApplyBlock.
+ */
+class BalanceEngine
+{
+public:
+    //! checkpoint: snapshot file; interval: blocks between snapshots, 0 for none but Checkpoint()
+    BalanceEngine(const ParserState& state, fs::path checkpoint, int interval);
+
+    //! Loads the snapshot if there is one; false and error for a snapshot that can't be read or is of another chain
+    bool Load(std::string& error);
+    //! Writes the snapshot now
+    bool Checkpoint(std::string& error);
+
+    /**
+     * Applies the Omni txs of the block at height in block order, first closing the crowdsales
+     * whose deadline is before the block time. Blocks at or below Height() are skipped, they
+     * are in the balances already. Blocks without Omni txs only have to be applied for the
+     * crowdsale deadlines and the checkpoint interval to be exact.
+     */
+    void ApplyBlock(int height, int64_t time, Span<const BalanceTx> txs);
+
+    //! Last block applied, -1 before the first
+    int Height() const;
+    int64_t GetBalance(const std::string& address, uint32_t property, TallyType type = BALANCE) const;
+    //! false for a property a tx the engine can't apply touched, or that doesn't exist
+    bool IsExact(uint32_t property) const;
+
+private:
+    enum class PropertyKind : uint8_t {
+        NATIVE,   // OMNI and TOMNI
+        FIXED,    // type 50
+        VARIABLE, // type 51, a crowdsale
+        MANAGED,  // type 54
+    };
+
+    struct Property {
+        uint8_t ecosystem;
+        PropertyKind kind;
+        bool exact;
+        int64_t total; // tokens issued
+        std::string issuer;
+    };
+
+    struct Crowdsale {
+        uint32_t property;
+        int64_t deadline;
+    };
+
+    //! Snapshot in the memory-mapped format, buffer null only counts the bytes
+    size_t serialize(unsigned char* buffer);
+    bool deserialize(Span<const unsigned char> body);
+    //! Writes the snapshot to a new file and renames it over the checkpoint, the lock held
+    bool writeSnapshot(std::string& error);
+
+    //! Applies one tx, false if omnicore would reject it
+    bool applyTx(int height, int64_t time, const BalanceTx& tx);
+    bool move(const std::string& from, const std::string& to, uint32_t property, int64_t amount);
+    void markInexact(uint32_t property);
+    //! The numbering flag of an ecosystem, see m_uncertainMain
+    bool& uncertain(uint8_t ecosystem);
+    uint32_t createProperty(uint8_t ecosystem, PropertyKind kind, const std::string& issuer);
+    const Property* findProperty(uint32_t property) const;
+
+    const ParserState& m_state;
+    const fs::path m_checkpoint;
+    const int m_interval;
+
+    mutable std::mutex m_mutex;
+    int m_height{-1};
+    int64_t m_time{0};
+    std::unordered_map<std::string, CMPTally> m_tally;
+    std::map<uint32_t, Property> m_properties;
+    std::map<std::string, Crowdsale> m_crowdsales; // by issuer, omnicore allows one per address
+    uint32_t m_nextMain;
+    uint32_t m_nextTest;
+    // per ecosystem, whether omnicore may have created a property the engine refused
+    bool m_uncertainMain{false};
+    bool m_uncertainTest{false};
+};
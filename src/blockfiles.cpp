@@ -0,0 +1,295 @@
+#include "blockfiles.h"
+#include <chainparams.h>
+#include <crypto/common.h>
+#include <cstring>
+#include <fcntl.h>
+#include <hash.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tinyformat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <util/hasher.h>
+
+namespace {
+
+//! Bounds checked cursor over a serialized block
+class BlockReader
+{
+public:
+    BlockReader(Span<const unsigned char> data, size_t pos) : m_data(data), m_pos(pos) {}
+
+    bool Skip(uint64_t size)
+    {
+        if (m_data.size() - m_pos < size) return false;
+        m_pos += size;
+        return true;
+    }
+
+    bool ReadCompactSize(uint64_t& out)
+    {
+        if (m_pos == m_data.size()) return false;
+        unsigned char first = m_data[m_pos++];
+        size_t size = first < 0xfd ? 0 : first == 0xfd ? 2 : first == 0xfe ? 4 : 8;
+        if (m_data.size() - m_pos < size) return false;
+        const unsigned char* p = m_data.data() + m_pos;
+        out = size == 0 ? first : size == 2 ? ReadLE16(p) : size == 4 ? ReadLE32(p) : ReadLE64(p);
+        m_pos += size;
+        return true;
+    }
+
+    //! Compact size followed by that many bytes
+    bool SkipSized()
+    {
+        uint64_t size;
+        return ReadCompactSize(size) && Skip(size);
+    }
+
+    size_t Pos() const
+    {
+        return m_pos;
+    }
+
+private:
+    Span<const unsigned char> m_data;
+    size_t m_pos;
+};
+
+struct Header {
+    uint256 hash;
+    uint256 prev;
+    BlockPos pos;
+    int height;
+};
+
+constexpr int HEIGHT_UNKNOWN = -2;
+constexpr int HEIGHT_ORPHAN = -1; // doesn't lead back to the genesis block
+
+//! Appends the headers of the blocks in a blk*.dat file, records are magic, u32 size and block
+void readHeaders(uint32_t file, Span<const unsigned char> data, const unsigned char* magic, std::vector<Header>& headers)
+{
+    size_t pos = 0;
+    while (data.size() - pos >= 8) {
+        if (memcmp(data.data() + pos, magic, 4) != 0) {
+            // the zeros Core preallocates at the end of a file, or a partly written record
+            const void* next = memchr(data.data() + pos + 1, magic[0], data.size() - pos - 1);
+            if (!next) break;
+            pos = static_cast<const unsigned char*>(next) - data.data();
+            continue;
+        }
+        uint32_t size = ReadLE32(data.data() + pos + 4);
+        if (size < 80 || size > data.size() - pos - 8) {
+            ++pos;
+            continue;
+        }
+        pos += 8;
+
+        Header& header = headers.emplace_back();
+        header.hash = Hash(data.subspan(pos, 80));
+        memcpy(header.prev.begin(), data.data() + pos + 4, 32);
+        header.pos = BlockPos{file, static_cast<uint32_t>(pos), size};
+        header.height = HEIGHT_UNKNOWN;
+        pos += size;
+    }
+}
+
+//! Core 28 and later obfuscate new block files with the key in xor.dat, all zero means none
+bool isObfuscated(const fs::path& blocksDir)
+{
+    MappedFile key(blocksDir / fs::PathFromString("xor.dat"));
+    for (unsigned char c : key.Data()) {
+        if (c) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+MappedFile::MappedFile(const fs::path& path)
+{
+    int fd = open(fs::PathToString(path).c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            m_data = static_cast<const unsigned char*>(data);
+            m_size = st.st_size;
+        }
+    }
+    close(fd); // the mapping keeps the file open
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data) munmap(const_cast<unsigned char*>(m_data), m_size);
+}
+
+uint256 TxLayout::Txid(Span<const unsigned char> block) const
+{
+    // version, inputs and outputs, lock time: the serialization without marker, flag and witnesses
+    uint256 txid;
+    CHash256()
+        .Write(block.subspan(begin, 4))
+        .Write(block.subspan(vin, witness - vin))
+        .Write(block.subspan(end - 4, 4))
+        .Finalize(Span<unsigned char>(txid.begin(), txid.size()));
+    return txid;
+}
+
+bool ScanTx(Span<const unsigned char> block, size_t& pos, TxLayout& layout)
+{
+    BlockReader reader(block, pos);
+    layout.begin = pos;
+    if (!reader.Skip(4)) return false;
+
+    // an extended tx starts with an empty input vector and the flag
+    bool segwit = block.size() - reader.Pos() >= 2 && block[reader.Pos()] == 0 && block[reader.Pos() + 1] == 1;
+    if (segwit) reader.Skip(2);
+
+    layout.vin = reader.Pos();
+    uint64_t inputs;
+    if (!reader.ReadCompactSize(inputs)) return false;
+    for (uint64_t i = 0; i < inputs; ++i) {
+        if (!reader.Skip(36) || !reader.SkipSized() || !reader.Skip(4)) return false;
+    }
+
+    layout.vout = reader.Pos();
+    uint64_t outputs;
+    if (!reader.ReadCompactSize(outputs)) return false;
+    for (uint64_t i = 0; i < outputs; ++i) {
+        if (!reader.Skip(8) || !reader.SkipSized()) return false;
+    }
+
+    layout.witness = reader.Pos();
+    if (segwit) {
+        for (uint64_t i = 0; i < inputs; ++i) {
+            uint64_t items;
+            if (!reader.ReadCompactSize(items)) return false;
+            for (uint64_t j = 0; j < items; ++j) {
+                if (!reader.SkipSized()) return false;
+            }
+        }
+    }
+    if (!reader.Skip(4)) return false;
+    layout.end = pos = reader.Pos();
+    return true;
+}
+
+void GetTxPrevouts(Span<const unsigned char> block, const TxLayout& layout, std::vector<COutPoint>& prevouts)
+{
+    // ScanTx checked the bounds already
+    BlockReader reader(block, layout.vin);
+    uint64_t inputs;
+    reader.ReadCompactSize(inputs);
+    for (uint64_t i = 0; i < inputs; ++i) {
+        COutPoint& prevout = prevouts.emplace_back();
+        memcpy(prevout.hash.begin(), block.data() + reader.Pos(), 32);
+        prevout.n = ReadLE32(block.data() + reader.Pos() + 32);
+        reader.Skip(36);
+        reader.SkipSized();
+        reader.Skip(4);
+    }
+}
+
+bool GetTxOut(Span<const unsigned char> block, const TxLayout& layout, uint32_t n, CAmount& value, Span<const unsigned char>& script)
+{
+    BlockReader reader(block, layout.vout);
+    uint64_t outputs;
+    reader.ReadCompactSize(outputs);
+    if (n >= outputs) return false;
+    for (uint32_t i = 0; i < n; ++i) {
+        reader.Skip(8);
+        reader.SkipSized();
+    }
+    value = ReadLE64(block.data() + reader.Pos());
+    reader.Skip(8);
+    uint64_t size;
+    reader.ReadCompactSize(size);
+    script = block.subspan(reader.Pos(), size);
+    return true;
+}
+
+uint32_t BlockTime(Span<const unsigned char> block)
+{
+    return ReadLE32(block.data() + 68);
+}
+
+bool BlockTxs(Span<const unsigned char> block, size_t& pos, uint64_t& count)
+{
+    BlockReader reader(block, 0);
+    if (!reader.Skip(80) || !reader.ReadCompactSize(count)) return false;
+    pos = reader.Pos();
+    return true;
+}
+
+bool BlockFiles::Open(const fs::path& blocksDir, const CChainParams& params, std::string& error)
+{
+    m_files.clear();
+    m_chain.clear();
+    if (isObfuscated(blocksDir)) {
+        error = "obfuscated block files (xor.dat) are not supported";
+        return false;
+    }
+
+    std::vector<Header> headers;
+    for (uint32_t n = 0;; ++n) {
+        fs::path path = blocksDir / fs::PathFromString(strprintf("blk%05u.dat", n));
+        if (!fs::exists(path)) break;
+        m_files.push_back(std::make_unique<MappedFile>(path));
+        readHeaders(n, m_files.back()->Data(), params.MessageStart(), headers);
+    }
+    if (m_files.empty()) {
+        error = strprintf("no blk00000.dat in %s", fs::PathToString(blocksDir));
+        return false;
+    }
+
+    std::unordered_map<uint256, size_t, SaltedTxidHasher> byHash;
+    byHash.reserve(headers.size());
+    for (size_t i = 0; i < headers.size(); ++i) {
+        byHash.emplace(headers[i].hash, i);
+    }
+
+    // heights by walking back to a block of known height, then forward again along the path
+    const uint256& genesis = params.GetConsensus().hashGenesisBlock;
+    std::vector<size_t> path;
+    int best = HEIGHT_ORPHAN;
+    size_t tip = 0;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        path.clear();
+        size_t j = i;
+        while (headers[j].height == HEIGHT_UNKNOWN) {
+            if (headers[j].hash == genesis) {
+                headers[j].height = 0;
+                break;
+            }
+            auto prev = byHash.find(headers[j].prev);
+            if (prev == byHash.end()) {
+                headers[j].height = HEIGHT_ORPHAN;
+                break;
+            }
+            path.push_back(j);
+            j = prev->second;
+        }
+        int height = headers[j].height;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            if (height >= 0) ++height;
+            headers[*it].height = height;
+        }
+        if (headers[i].height > best) {
+            best = headers[i].height;
+            tip = i;
+        }
+    }
+    if (best < 0) {
+        error = strprintf("no block of the %s chain leads back to its genesis block", params.NetworkIDString());
+        return false;
+    }
+
+    m_chain.resize(best + 1);
+    for (size_t i = tip;; i = byHash.at(headers[i].prev)) {
+        m_chain[headers[i].height] = headers[i].pos;
+        if (headers[i].height == 0) break;
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <consensus/amount.h>
+#include <fs.h>
+#include <memory>
+#include <primitives/transaction.h>
+#include <span.h>
+#include <string>
+#include <uint256.h>
+#include <vector>
+
+class CChainParams;
+
+//! Read-only memory map of a whole file, empty if the file is empty or can't be mapped
+class MappedFile
+{
+public:
+    explicit MappedFile(const fs::path& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    Span<const unsigned char> Data() const
+    {
+        return {m_data, m_size};
+    }
+
+private:
+    const unsigned char* m_data{nullptr};
+    size_t m_size{0};
+};
+
+//! Offsets of the parts of a serialized tx in the block that holds it
+struct TxLayout {
+    size_t begin;   // version
+    size_t vin;     // input count, after the segwit marker and flag if there are any
+    size_t vout;    // output count
+    size_t witness; // end of the outputs: the witnesses, or the lock time without any
+    size_t end;     // past the lock time
+
+    Span<const unsigned char> Bytes(Span<const unsigned char> block) const
+    {
+        return block.subspan(begin, end - begin);
+    }
+    //! Hash of the tx without its witnesses, hashed in place
+    uint256 Txid(Span<const unsigned char> block) const;
+};
+
+//! Reads the offsets of the tx at pos in block, bounds checked, and moves pos past it; false if it is cut short
+bool ScanTx(Span<const unsigned char> block, size_t& pos, TxLayout& layout);
+//! Appends the outpoints spent by a scanned tx
+void GetTxPrevouts(Span<const unsigned char> block, const TxLayout& layout, std::vector<COutPoint>& prevouts);
+//! Value and script, pointing into block, of output n of a scanned tx; false if there is no such output
+bool GetTxOut(Span<const unsigned char> block, const TxLayout& layout, uint32_t n, CAmount& value, Span<const unsigned char>& script);
+
+//! Where a block is in the blk*.dat files
+struct BlockPos {
+    uint32_t file;
+    uint32_t offset; // of the serialized block, past magic and size
+    uint32_t size;
+};
+
+/**
+ * The blk*.dat files of a Bitcoin Core blocks directory, memory-mapped, and the chain they
+ * hold.
+ *
+ * Core appends blocks to the files as they arrive, out of height order and stale blocks
+ * included. Open reads the header of every block, links the headers by previous block hash
+ * and takes the longest branch from the genesis block as the chain; without the block index
+ * there is no chain work, which only makes a difference while a fork is running. Blocks are
+ * read in place from the mapping, the files must not change while they are open: the node
+ * has to be stopped, or be a copy. Files written with -blocksxor (xor.dat) are not supported,
+ * neither are pruned nodes, whose files don't reach back to the genesis block.
+ */
+class BlockFiles
+{
+public:
+    //! Returns false and sets error if there are no files or no chain from the genesis block of params
+    bool Open(const fs::path& blocksDir, const CChainParams& params, std::string& error);
+
+    //! Blocks of the chain, indexed by height
+    const std::vector<BlockPos>& Chain() const
+    {
+        return m_chain;
+    }
+    Span<const unsigned char> Block(const BlockPos& pos) const
+    {
+        return m_files[pos.file]->Data().subspan(pos.offset, pos.size);
+    }
+
+private:
+    std::vector<std::unique_ptr<MappedFile>> m_files;
+    std::vector<BlockPos> m_chain;
+};
+
+//! Block header time of a serialized block
+uint32_t BlockTime(Span<const unsigned char> block);
+//! Offset of the first tx of a serialized block and the number of txs; false if the block is too short
+bool BlockTxs(Span<const unsigned char> block, size_t& pos, uint64_t& count);
@@ -0,0 +1,276 @@
+#include "hex.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HEX_AVX2 1
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+constexpr unsigned char INVALID = 0xff;
+
+//! Value of every character, INVALID for the ones that aren't hex digits
+struct DigitTable {
+    unsigned char value[256];
+
+    constexpr DigitTable() : value()
+    {
+        for (int c = 0; c < 256; ++c) {
+            value[c] = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : INVALID;
+        }
+    }
+};
+
+constexpr DigitTable DIGITS;
+constexpr char LOWER[] = "0123456789abcdef";
+constexpr char UPPER[] = "0123456789ABCDEF";
+
+// 'a' - '0' - 10 and 'A' - '0' - 10: added to the digits above 9, on top of '0'
+constexpr char letterOffset(bool upper)
+{
+    return upper ? 7 : 39;
+}
+
+bool decodeScalar(const char* hex, unsigned char* out, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char high = DIGITS.value[static_cast<unsigned char>(hex[2 * i])];
+        unsigned char low = DIGITS.value[static_cast<unsigned char>(hex[2 * i + 1])];
+        if ((high | low) == INVALID) return false; // any digit is below 16
+        out[i] = high << 4 | low;
+    }
+    return true;
+}
+
+void encodeScalar(const unsigned char* bytes, char* out, size_t size, bool upper)
+{
+    const char* digits = upper ? UPPER : LOWER;
+    for (size_t i = 0; i < size; ++i) {
+        out[2 * i] = digits[bytes[i] >> 4];
+        out[2 * i + 1] = digits[bytes[i] & 0x0f];
+    }
+}
+
+/*
+ * The vector kernels convert whole blocks from the front of the input and advance the pointers
+ * and size past them; the scalar loops finish the rest. Digits map to values without a table:
+ * c - '0' is below 10 for a decimal digit, (c | 0x20) - 'a' below 6 for a letter of either case,
+ * every other character falls outside both ranges.
+ */
+
+#if defined(__SSE2__)
+
+//! Values of 16 characters, and in valid all ones for the hex digits among them
+inline __m128i digitValues(__m128i c, __m128i& valid)
+{
+    __m128i decimal = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    // unsigned x <= n as min(x, n) == x
+    __m128i isDecimal = _mm_cmpeq_epi8(_mm_min_epu8(decimal, _mm_set1_epi8(9)), decimal);
+    __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+    valid = _mm_or_si128(isDecimal, isLetter);
+    return _mm_or_si128(_mm_and_si128(isDecimal, decimal), _mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+//! Pairs of values to bytes: the even ones are the high nibbles, the low byte of each 16 bit lane
+inline __m128i pairValues(__m128i values)
+{
+    __m128i high = _mm_and_si128(values, _mm_set1_epi16(0x00ff));
+    __m128i low = _mm_srli_epi16(values, 8);
+    return _mm_or_si128(_mm_slli_epi16(high, 4), low);
+}
+
+bool decodeSse2(const char*& hex, unsigned char*& out, size_t& size)
+{
+    for (; size >= 16; size -= 16, hex += 32, out += 16) {
+        __m128i valid0, valid1;
+        __m128i values0 = digitValues(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex)), valid0);
+        __m128i values1 = digitValues(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 16)), valid1);
+        if (_mm_movemask_epi8(_mm_and_si128(valid0, valid1)) != 0xffff) return false;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(pairValues(values0), pairValues(values1)));
+    }
+    return true;
+}
+
+//! Hex digits of 16 nibbles
+inline __m128i nibbleDigits(__m128i nibbles, __m128i offset)
+{
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), offset);
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+void encodeSse2(const unsigned char*& bytes, char*& out, size_t& size, bool upper)
+{
+    const __m128i offset = _mm_set1_epi8(letterOffset(upper));
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    for (; size >= 16; size -= 16, bytes += 16, out += 32) {
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+        __m128i high = nibbleDigits(_mm_and_si128(_mm_srli_epi16(b, 4), mask), offset);
+        __m128i low = nibbleDigits(_mm_and_si128(b, mask), offset);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(high, low));
+    }
+}
+
+#if defined(HEX_AVX2)
+
+// the same kernels on 32 byte vectors, compiled for AVX2 only; called after a run time check of the CPU
+
+__attribute__((target("avx2"))) inline __m256i digitValues256(__m256i c, __m256i& valid)
+{
+    __m256i decimal = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i isDecimal = _mm256_cmpeq_epi8(_mm256_min_epu8(decimal, _mm256_set1_epi8(9)), decimal);
+    __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+    valid = _mm256_or_si256(isDecimal, isLetter);
+    return _mm256_or_si256(_mm256_and_si256(isDecimal, decimal), _mm256_and_si256(isLetter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+}
+
+__attribute__((target("avx2"))) inline __m256i pairValues256(__m256i values)
+{
+    __m256i high = _mm256_and_si256(values, _mm256_set1_epi16(0x00ff));
+    __m256i low = _mm256_srli_epi16(values, 8);
+    return _mm256_or_si256(_mm256_slli_epi16(high, 4), low);
+}
+
+__attribute__((target("avx2"))) bool decodeAvx2(const char*& hex, unsigned char*& out, size_t& size)
+{
+    for (; size >= 32; size -= 32, hex += 64, out += 32) {
+        __m256i valid0, valid1;
+        __m256i values0 = digitValues256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hex)), valid0);
+        __m256i values1 = digitValues256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hex + 32)), valid1);
+        if (_mm256_movemask_epi8(_mm256_and_si256(valid0, valid1)) != -1) return false;
+        // packus works within the 128 bit halves, the permute restores the order
+        __m256i packed = _mm256_packus_epi16(pairValues256(values0), pairValues256(values1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute4x64_epi64(packed, 0xd8));
+    }
+    return true;
+}
+
+__attribute__((target("avx2"))) void encodeAvx2(const unsigned char*& bytes, char*& out, size_t& size, bool upper)
+{
+    const __m256i offset = _mm256_set1_epi8(letterOffset(upper));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i zero = _mm256_set1_epi8('0');
+    for (; size >= 32; size -= 32, bytes += 32, out += 64) {
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes));
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(b, 4), mask);
+        __m256i low = _mm256_and_si256(b, mask);
+        high = _mm256_add_epi8(_mm256_add_epi8(high, zero), _mm256_and_si256(_mm256_cmpgt_epi8(high, nine), offset));
+        low = _mm256_add_epi8(_mm256_add_epi8(low, zero), _mm256_and_si256(_mm256_cmpgt_epi8(low, nine), offset));
+        // unpack works within the 128 bit halves as well
+        __m256i first = _mm256_unpacklo_epi8(high, low);
+        __m256i second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+}
+
+bool haveAvx2()
+{
+    static const bool avx2 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return avx2;
+}
+
+#endif // HEX_AVX2
+
+#elif defined(__ARM_NEON)
+
+//! Values of 16 characters, and in valid all ones for the hex digits among them
+inline uint8x16_t digitValues(uint8x16_t c, uint8x16_t& valid)
+{
+    uint8x16_t decimal = vsubq_u8(c, vdupq_n_u8('0'));
+    uint8x16_t letter = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+    uint8x16_t isDecimal = vcleq_u8(decimal, vdupq_n_u8(9));
+    uint8x16_t isLetter = vcleq_u8(letter, vdupq_n_u8(5));
+    valid = vorrq_u8(isDecimal, isLetter);
+    return vorrq_u8(vandq_u8(isDecimal, decimal), vandq_u8(isLetter, vaddq_u8(letter, vdupq_n_u8(10))));
+}
+
+bool decodeNeon(const char*& hex, unsigned char*& out, size_t& size)
+{
+    for (; size >= 16; size -= 16, hex += 32, out += 16) {
+        // the de-interleaving load puts the high digits into val[0], the low ones into val[1]
+        uint8x16x2_t c = vld2q_u8(reinterpret_cast<const uint8_t*>(hex));
+        uint8x16_t validHigh, validLow;
+        uint8x16_t high = digitValues(c.val[0], validHigh);
+        uint8x16_t low = digitValues(c.val[1], validLow);
+        // narrow to 4 bits per byte lane
+        uint8x16_t valid = vandq_u8(validHigh, validLow);
+        if (vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(valid), 4)), 0) != ~uint64_t{0}) return false;
+        vst1q_u8(out, vorrq_u8(vshlq_n_u8(high, 4), low));
+    }
+    return true;
+}
+
+inline uint8x16_t nibbleDigits(uint8x16_t nibbles, uint8x16_t offset)
+{
+    uint8x16_t letters = vandq_u8(vcgtq_u8(nibbles, vdupq_n_u8(9)), offset);
+    return vaddq_u8(vaddq_u8(nibbles, vdupq_n_u8('0')), letters);
+}
+
+void encodeNeon(const unsigned char*& bytes, char*& out, size_t& size, bool upper)
+{
+    const uint8x16_t offset = vdupq_n_u8(letterOffset(upper));
+    for (; size >= 16; size -= 16, bytes += 16, out += 32) {
+        uint8x16_t b = vld1q_u8(bytes);
+        uint8x16x2_t digits;
+        digits.val[0] = nibbleDigits(vshrq_n_u8(b, 4), offset);
+        digits.val[1] = nibbleDigits(vandq_u8(b, vdupq_n_u8(0x0f)), offset);
+        vst2q_u8(reinterpret_cast<uint8_t*>(out), digits); // interleaving store
+    }
+}
+
+#endif
+
+} // namespace
+
+bool DecodeHex(std::string_view hex, unsigned char* out)
+{
+    const char* in = hex.data();
+    size_t size = hex.size() / 2;
+#if defined(HEX_AVX2)
+    if (size >= 32 && haveAvx2() && !decodeAvx2(in, out, size)) return false;
+#endif
+#if defined(__SSE2__)
+    if (!decodeSse2(in, out, size)) return false;
+#elif defined(__ARM_NEON)
+    if (!decodeNeon(in, out, size)) return false;
+#endif
+    return decodeScalar(in, out, size);
+}
+
+void EncodeHex(Span<const unsigned char> bytes, char* out, bool upper)
+{
+    const unsigned char* in = bytes.data();
+    size_t size = bytes.size();
+#if defined(HEX_AVX2)
+    if (size >= 32 && haveAvx2()) encodeAvx2(in, out, size, upper);
+#endif
+#if defined(__SSE2__)
+    encodeSse2(in, out, size, upper);
+#elif defined(__ARM_NEON)
+    encodeNeon(in, out, size, upper);
+#endif
+    encodeScalar(in, out, size, upper);
+}
+
+void EncodeHashHex(const unsigned char* hash, char* out)
+{
+    unsigned char reversed[32];
+    for (size_t i = 0; i < sizeof(reversed); ++i) {
+        reversed[i] = hash[sizeof(reversed) - 1 - i];
+    }
+    EncodeHex(reversed, out);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <span.h>
+#include <string_view>
+
+/**
+ * Hex codec of the parse path: tx and prevout script hex in, txids out.
+ *
+ * The kernels convert 64 digits at a time with AVX2 where the CPU has it (chosen at run time),
+ * 32 with SSE2 on any other x86-64 and with NEON on ARM, and the rest of an input with a table
+ * lookup per byte. Validation is part of the same pass: the vector loops check all digits of a
+ * block at once, so decoding tx hex costs about as much as copying it.
+ */
+
+//! Decodes the hex.size() / 2 bytes of hex, either case, to out; false if a character isn't a hex digit. hex.size() has to be even.
+bool DecodeHex(std::string_view hex, unsigned char* out);
+//! Writes the 2 * bytes.size() hex digits of bytes, lower case unless upper, to out
+void EncodeHex(Span<const unsigned char> bytes, char* out, bool upper = false);
+//! Writes the 64 digit display hex of a 32 byte hash, its bytes reversed as by uint256::GetHex, to out
+void EncodeHashHex(const unsigned char* hash, char* out);
@@ -1,6 +1,11 @@
 use anyhow::Result;
 use autocxx::prelude::*;
-pub use ffi::{OmniTx, RawTx};
+use std::collections::{BTreeMap, HashMap};
+use std::future::Future;
+use std::pin::Pin;
+use std::sync::{Arc, Condvar, Mutex};
+use std::task::{Context, Poll, Waker};
+pub use ffi::{AddressCacheStats, OmniAddress, OmniPayload, OmniTx, OmniTxRecord, ParseCacheStats, ParserMetrics, RawBlock, RawTx};
 
 include_cpp! {
     #include "omni.h"
@@ -10,6 +15,62 @@ include_cpp! {
     generate!("ParseTx")
     generate!("OmniTx")
     generate!("RawTx")
+    generate!("SetParseThreads")
+    generate!("ParseTxBatch")
+    generate!("RawTxBatch")
+    generate!("ParsedTxBatch")
+    generate!("ParseBlock")
+    generate!("RawBlock")
+    generate!("IsOmniCandidateHex")
+    generate!("ParseTxJson")
+    generate!("ParseTxBin")
+    generate_pod!("OmniTxRecord")
+    generate_pod!("OmniAddress")
+    generate!("ParseTxRecord")
+    generate!("ParseTxBinRecord")
+    generate!("ParseTxRecords")
+    generate_pod!("OmniPayload")
+    generate_pod!("PayloadTokens")
+    generate_pod!("PayloadSendAll")
+    generate_pod!("PayloadNonFungible")
+    generate_pod!("PayloadSendToMany")
+    generate_pod!("PayloadDexOffer")
+    generate_pod!("PayloadMetaDex")
+    generate_pod!("PayloadCreateProperty")
+    generate_pod!("PayloadAnyData")
+    generate_pod!("PayloadActivation")
+    generate_pod!("PayloadAlert")
+    generate!("ParseTxPayload")
+    generate!("ParseTxBinPayload")
+    generate!("FormatOmniTxid")
+    generate!("FormatOmniFee")
+    generate!("FormatOmniType")
+    generate!("FormatOmniAddress")
+    generate_pod!("AddressCacheStats")
+    generate!("SetAddressCacheSize")
+    generate!("GetAddressCacheStats")
+    generate_pod!("ParseCacheStats")
+    generate!("SetParseCacheSize")
+    generate!("GetParseCacheStats")
+    generate!("ParserContext")
+    generate!("DrainTrace")
+    generate!("GetTraceDropped")
+    generate_pod!("ParserMetrics")
+    generate!("GetParserMetrics")
+    generate!("ParseStatusIndex")
+    generate!("FormatPrometheusMetrics")
+    generate!("OpenPrevoutStore")
+    generate!("GetPrevoutStoreHeight")
+    generate!("OpenBalances")
+    generate!("GetBalancesHeight")
+    generate!("GetBalance")
+    generate!("IsBalanceExact")
+    generate!("WriteBalancesCheckpoint")
+    generate!("WatchProperty")
+    generate!("WatchAddress")
+    generate!("ClearWatchlist")
+    generate!("OmniParser")
+    generate!("ParseQueue")
 }
 
 pub struct OmniTransaction(pub cxx::UniquePtr<OmniTx>);
@@ -49,6 +110,245 @@ impl OmniTransaction {
     }
 }
 
+impl OmniTxRecord {
+    fn zeroed() -> Self {
+        // plain data, all zero is the empty record
+        unsafe { std::mem::zeroed() }
+    }
+
+    /// Parse status, the other fields are only set when it is 0
+    pub fn status(&self) -> i32 {
+        self.status
+    }
+    pub fn is_omni(&self) -> bool {
+        self.status == 0
+    }
+    pub fn txid(&self) -> String {
+        ffi::FormatOmniTxid(self).to_string()
+    }
+    pub fn fee(&self) -> String {
+        ffi::FormatOmniFee(self).to_string()
+    }
+    pub fn r#type(&self) -> String {
+        ffi::FormatOmniType(self).to_string()
+    }
+    pub fn sendingaddress(&self) -> String {
+        self.sendingaddress.to_string()
+    }
+    pub fn referenceaddress(&self) -> String {
+        self.referenceaddress.to_string()
+    }
+}
+
+impl OmniAddress {
+    pub fn is_empty(&self) -> bool {
+        self.size == 0
+    }
+    /// scriptPubKey of the address
+    pub fn script(&self) -> &[u8] {
+        &self.script[..self.size as usize]
+    }
+}
+
+/// Fields of a property creation, see `Payload`
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct PropertyInfo {
+    pub ecosystem: u8,
+    pub property_type: u16,
+    pub previous_property: u32,
+    pub category: String,
+    pub subcategory: String,
+    pub name: String,
+    pub url: String,
+    pub data: String,
+}
+
+/// Typed payload of an Omni tx, converted from the `OmniPayload` the parse filled; amounts are
+/// in the smallest unit, the bitcoin of DEx offers in satoshis
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub enum Payload {
+    SimpleSend { property: u32, amount: u64 },
+    /// `distribution_property` is 0 before version 1, which pays out in the property itself
+    SendToOwners { property: u32, amount: u64, distribution_property: u32 },
+    SendAll { ecosystem: u8 },
+    SendNonFungible { property: u32, token_start: u64, token_end: u64 },
+    /// Amounts sent to outputs of the tx, by vout
+    SendToMany { property: u32, outputs: Vec<(u8, u64)> },
+    DexOffer { property: u32, amount: u64, amount_desired: u64, min_fee: i64, block_time_limit: u8, subaction: u8 },
+    DexAccept { property: u32, amount: u64 },
+    MetaDexTrade { property: u32, amount: u64, property_desired: u32, amount_desired: u64 },
+    MetaDexCancelPrice { property: u32, amount: u64, property_desired: u32, amount_desired: u64 },
+    MetaDexCancelPair { property: u32, property_desired: u32 },
+    MetaDexCancelEcosystem { ecosystem: u8 },
+    CreatePropertyFixed { info: PropertyInfo, amount: u64 },
+    CreatePropertyVariable { info: PropertyInfo, property_desired: u32, tokens_per_unit: u64, deadline: i64, early_bird_bonus: u8, issuer_percentage: u8 },
+    CreatePropertyManual { info: PropertyInfo },
+    CloseCrowdsale { property: u32 },
+    Grant { property: u32, amount: u64 },
+    Revoke { property: u32, amount: u64 },
+    ChangeIssuer { property: u32 },
+    EnableFreezing { property: u32 },
+    DisableFreezing { property: u32 },
+    AddDelegate { property: u32 },
+    RemoveDelegate { property: u32 },
+    /// `script` is the scriptPubKey of the frozen address
+    Freeze { property: u32, script: Vec<u8> },
+    Unfreeze { property: u32, script: Vec<u8> },
+    AnyData { data: Vec<u8> },
+    NonFungibleData { property: u32, token_start: u64, token_end: u64, issuer_data: bool, data: String },
+    FeatureActivation { feature_id: u16, activation_block: u32, min_client_version: u32 },
+    FeatureDeactivation { feature_id: u16 },
+    Alert { alert_type: u16, expiry: u32, message: String },
+    /// A type `interpret_Transaction` accepts without fields of its own here
+    Other { type_int: u16 },
+}
+
+/// The NUL terminated string of a payload field
+fn payload_string(field: &[u8]) -> String {
+    let size = field.iter().position(|&c| c == 0).unwrap_or(field.len());
+    String::from_utf8_lossy(&field[..size]).into_owned()
+}
+
+impl OmniPayload {
+    fn zeroed() -> Self {
+        unsafe { std::mem::zeroed() }
+    }
+
+    fn property_info(&self) -> PropertyInfo {
+        let create = &self.create_property;
+        PropertyInfo {
+            ecosystem: create.ecosystem,
+            property_type: create.property_type,
+            previous_property: create.previous_property,
+            category: payload_string(&create.category),
+            subcategory: payload_string(&create.subcategory),
+            name: payload_string(&create.name),
+            url: payload_string(&create.url),
+            data: payload_string(&create.data),
+        }
+    }
+
+    /// The member `type_` selects, as a Rust enum
+    pub fn to_payload(&self) -> Payload {
+        let tokens = &self.tokens;
+        let metadex = &self.metadex;
+        let nonfungible = &self.nonfungible;
+        match self.type_ {
+            0 => Payload::SimpleSend { property: tokens.property, amount: tokens.amount },
+            3 => Payload::SendToOwners { property: tokens.property, amount: tokens.amount, distribution_property: tokens.distribution_property },
+            4 => Payload::SendAll { ecosystem: self.send_all.ecosystem },
+            5 => Payload::SendNonFungible { property: nonfungible.property, token_start: nonfungible.token_start, token_end: nonfungible.token_end },
+            7 => {
+                let stm = &self.send_to_many;
+                let count = stm.count as usize;
+                Payload::SendToMany { property: stm.property, outputs: stm.vout[..count].iter().copied().zip(stm.amount[..count].iter().copied()).collect() }
+            }
+            20 => {
+                let offer = &self.dex_offer;
+                Payload::DexOffer {
+                    property: offer.property,
+                    amount: offer.amount,
+                    amount_desired: offer.amount_desired,
+                    min_fee: offer.min_fee,
+                    block_time_limit: offer.block_time_limit,
+                    subaction: offer.subaction,
+                }
+            }
+            22 => Payload::DexAccept { property: tokens.property, amount: tokens.amount },
+            25 => Payload::MetaDexTrade { property: metadex.property, amount: metadex.amount, property_desired: metadex.property_desired, amount_desired: metadex.amount_desired },
+            26 => Payload::MetaDexCancelPrice { property: metadex.property, amount: metadex.amount, property_desired: metadex.property_desired, amount_desired: metadex.amount_desired },
+            27 => Payload::MetaDexCancelPair { property: metadex.property, property_desired: metadex.property_desired },
+            28 => Payload::MetaDexCancelEcosystem { ecosystem: metadex.ecosystem },
+            50 => Payload::CreatePropertyFixed { info: self.property_info(), amount: self.create_property.amount },
+            51 => {
+                let create = &self.create_property;
+                Payload::CreatePropertyVariable {
+                    info: self.property_info(),
+                    property_desired: create.property_desired,
+                    tokens_per_unit: create.amount,
+                    deadline: create.deadline,
+                    early_bird_bonus: create.early_bird_bonus,
+                    issuer_percentage: create.issuer_percentage,
+                }
+            }
+            53 => Payload::CloseCrowdsale { property: tokens.property },
+            54 => Payload::CreatePropertyManual { info: self.property_info() },
+            55 => Payload::Grant { property: tokens.property, amount: tokens.amount },
+            56 => Payload::Revoke { property: tokens.property, amount: tokens.amount },
+            70 => Payload::ChangeIssuer { property: tokens.property },
+            71 => Payload::EnableFreezing { property: tokens.property },
+            72 => Payload::DisableFreezing { property: tokens.property },
+            73 => Payload::AddDelegate { property: tokens.property },
+            74 => Payload::RemoveDelegate { property: tokens.property },
+            185 => Payload::Freeze { property: tokens.property, script: tokens.address.script().to_vec() },
+            186 => Payload::Unfreeze { property: tokens.property, script: tokens.address.script().to_vec() },
+            200 => Payload::AnyData { data: self.any_data.data[..self.any_data.size as usize].to_vec() },
+            201 => Payload::NonFungibleData {
+                property: nonfungible.property,
+                token_start: nonfungible.token_start,
+                token_end: nonfungible.token_end,
+                issuer_data: nonfungible.issuer_data != 0,
+                data: payload_string(&nonfungible.data),
+            },
+            65533 => Payload::FeatureDeactivation { feature_id: self.activation.feature_id },
+            65534 => Payload::FeatureActivation {
+                feature_id: self.activation.feature_id,
+                activation_block: self.activation.activation_block,
+                min_client_version: self.activation.min_client_version,
+            },
+            65535 => Payload::Alert { alert_type: self.alert.alert_type, expiry: self.alert.expiry, message: payload_string(&self.alert.message) },
+            type_int => Payload::Other { type_int },
+        }
+    }
+}
+
+/// Record and payload of a parse, the payload only for an Omni tx
+fn with_payload(record: OmniTxRecord, payload: &OmniPayload) -> (OmniTxRecord, Option<Payload>) {
+    let payload = if record.is_omni() { Some(payload.to_payload()) } else { None };
+    (record, payload)
+}
+
+/// Stages of `ParserMetrics`, in order
+pub const PARSE_STAGES: [&str; 7] = ["decode", "classify", "sender", "reference", "deobfuscate", "interpret", "total"];
+
+impl ParserMetrics {
+    /// Parses that ended with status, 0 for Omni txs, else one of the negative codes
+    pub fn status_count(&self, status: i32) -> u64 {
+        let slot: i32 = ffi::ParseStatusIndex(autocxx::c_int(status)).into();
+        if slot < 0 {
+            0
+        } else {
+            self.status[slot as usize]
+        }
+    }
+    /// Number of timed runs and their total nanoseconds of a stage, an index into `PARSE_STAGES`
+    pub fn stage(&self, stage: usize) -> (u64, u64) {
+        (self.stage_count[stage], self.stage_ns[stage])
+    }
+    /// Classified txs of Class A, B and C
+    pub fn class_count(&self, class: char) -> u64 {
+        match class {
+            'A' => self.classes[1],
+            'B' => self.classes[2],
+            'C' => self.classes[3],
+            _ => self.classes[0],
+        }
+    }
+    pub fn type_count(&self, type_int: u32) -> u64 {
+        self.types[(type_int as usize).min(self.types.len() - 1)]
+    }
+    /// Prometheus text exposition, `labels` like `chain="main"` are added to every sample
+    pub fn to_prometheus(&self, labels: &str) -> String {
+        ffi::FormatPrometheusMetrics(self, labels).to_string()
+    }
+}
+
+impl std::fmt::Display for OmniAddress {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.write_str(&ffi::FormatOmniAddress(self).to_string())
+    }
+}
+
 #[derive(Default)]
 pub enum Chain {
     #[default]
@@ -69,16 +369,36 @@ impl ToString for Chain {
     }
 }
 
+/// Sets up omnicore and the default parser of the free functions, once per process: calls
+/// after the first return at once, whatever their chain. Use a `Parser` for another chain.
 pub fn init(chain: Chain, debug: bool) {
     ffi::Init(chain.to_string(), debug);
 }
 
+/// Returns false if the hex encoded tx is definitely not an Omni transaction,
+/// without decoding it. `parse_tx` applies the same check first.
+pub fn is_omni_candidate(hex: &str) -> bool {
+    ffi::IsOmniCandidateHex(hex)
+}
+
 pub fn parse_tx(raw_str: &str) -> Result<OmniTransaction> {
-    moveit! {
-        let mut raw_tx = RawTx::new(raw_str);
+    parse_tx_json(raw_str.as_bytes())
+}
+
+/// Parse a RawTx json straight from the borrowed buffer, without copying it into a C++ string
+pub fn parse_tx_json(raw: &[u8]) -> Result<OmniTransaction> {
+    let result = unsafe { ffi::ParseTxJson(raw.as_ptr() as *const std::os::raw::c_char, raw.len()) };
+
+    if result.is_null() {
+        Err(anyhow::anyhow!("invalid omni tx"))
+    } else {
+        Ok(OmniTransaction(result))
     }
+}
 
-    let result = ffi::ParseTx(&raw_tx);
+/// Parse a binary RawTx, as built by `RawTxBin`, straight from the borrowed buffer
+pub fn parse_tx_bin(raw: &[u8]) -> Result<OmniTransaction> {
+    let result = unsafe { ffi::ParseTxBin(raw.as_ptr(), raw.len()) };
 
     if result.is_null() {
         Err(anyhow::anyhow!("invalid omni tx"))
@@ -86,3 +406,742 @@ pub fn parse_tx(raw_str: &str) -> Result<OmniTransaction> {
         Ok(OmniTransaction(result))
     }
 }
+
+/// Parse into a plain record in one FFI crossing, nothing is allocated for the result
+pub fn parse_tx_record(raw_str: &str) -> OmniTxRecord {
+    let mut record = OmniTxRecord::zeroed();
+    unsafe {
+        ffi::ParseTxRecord(raw_str.as_ptr() as *const std::os::raw::c_char, raw_str.len(), &mut record);
+    }
+    record
+}
+
+pub fn parse_tx_bin_record(raw: &[u8]) -> OmniTxRecord {
+    let mut record = OmniTxRecord::zeroed();
+    unsafe {
+        ffi::ParseTxBinRecord(raw.as_ptr(), raw.len(), &mut record);
+    }
+    record
+}
+
+/// Record and typed payload of one tx in the same pass, the payload is `None` unless the tx is an Omni tx
+pub fn parse_tx_payload(raw_str: &str) -> (OmniTxRecord, Option<Payload>) {
+    let mut record = OmniTxRecord::zeroed();
+    let mut payload = OmniPayload::zeroed();
+    unsafe {
+        ffi::ParseTxPayload(raw_str.as_ptr() as *const std::os::raw::c_char, raw_str.len(), &mut record, &mut payload);
+    }
+    with_payload(record, &payload)
+}
+
+pub fn parse_tx_bin_payload(raw: &[u8]) -> (OmniTxRecord, Option<Payload>) {
+    let mut record = OmniTxRecord::zeroed();
+    let mut payload = OmniPayload::zeroed();
+    unsafe {
+        ffi::ParseTxBinPayload(raw.as_ptr(), raw.len(), &mut record, &mut payload);
+    }
+    with_payload(record, &payload)
+}
+
+/// Batch version of `parse_tx_record` on the C++ worker pool, records keep the input order
+pub fn parse_txs_records(raw_strs: &[&str]) -> Vec<OmniTxRecord> {
+    let mut batch = ffi::RawTxBatch::new().within_unique_ptr();
+    for raw_str in raw_strs {
+        batch.pin_mut().push(*raw_str);
+    }
+
+    let mut records = Vec::with_capacity(raw_strs.len());
+    unsafe {
+        ffi::ParseTxRecords(&batch, records.as_mut_ptr());
+        records.set_len(raw_strs.len());
+    }
+    records
+}
+
+/// Builder of the binary RawTx format read by `parse_tx_bin`, see `src/rawtx_bin.h`
+pub struct RawTxBin {
+    data: Vec<u8>,
+    count_pos: usize,
+    count: u32,
+}
+
+impl RawTxBin {
+    const VERSION: u8 = 1;
+
+    /// `tx` is the serialized transaction
+    pub fn new(tx: &[u8], height: u32, time: u32, idx: u32) -> Self {
+        let mut data = Vec::with_capacity(1 + 4 * 5 + tx.len());
+        data.push(Self::VERSION);
+        data.extend_from_slice(&height.to_le_bytes());
+        data.extend_from_slice(&time.to_le_bytes());
+        data.extend_from_slice(&idx.to_le_bytes());
+        data.extend_from_slice(&(tx.len() as u32).to_le_bytes());
+        data.extend_from_slice(tx);
+        let count_pos = data.len();
+        data.extend_from_slice(&0u32.to_le_bytes());
+        RawTxBin {
+            data,
+            count_pos,
+            count: 0,
+        }
+    }
+
+    /// `txid` in serialization order, i.e. the display hex reversed
+    pub fn add_prevout(&mut self, txid: &[u8; 32], vout: u32, value: u64, height: u32, script_pubkey: &[u8]) -> &mut Self {
+        self.data.extend_from_slice(txid);
+        self.data.extend_from_slice(&vout.to_le_bytes());
+        self.data.extend_from_slice(&value.to_le_bytes());
+        self.data.extend_from_slice(&height.to_le_bytes());
+        self.data.extend_from_slice(&(script_pubkey.len() as u32).to_le_bytes());
+        self.data.extend_from_slice(script_pubkey);
+        self.count += 1;
+        self.data[self.count_pos..self.count_pos + 4].copy_from_slice(&self.count.to_le_bytes());
+        self
+    }
+
+    pub fn as_bytes(&self) -> &[u8] {
+        &self.data
+    }
+}
+
+/// Parser of one chain with its own params, Exodus scripts, log configuration and address cache.
+/// Parsers don't depend on the chain passed to `init` or on each other, so one process can parse
+/// several chains at once; a parser is shared between threads as is and its calls take no lock.
+/// `init` has to run once before, it sets up the log and the default parser of the free functions.
+pub struct Parser(cxx::UniquePtr<ffi::ParserContext>);
+unsafe impl Send for Parser {}
+unsafe impl Sync for Parser {}
+
+impl Parser {
+    pub fn new(chain: Chain, debug: bool) -> Self {
+        Parser(ffi::ParserContext::new(chain.to_string(), debug, false).within_unique_ptr())
+    }
+
+    /// A parser that traces every parse into lock free per thread rings instead of the
+    /// omnicore log, for `drain_trace` to collect off the hot path
+    pub fn new_traced(chain: Chain) -> Self {
+        Parser(ffi::ParserContext::new(chain.to_string(), true, true).within_unique_ptr())
+    }
+
+    pub fn is_omni_candidate(&self, hex: &str) -> bool {
+        self.0.IsOmniCandidateHex(hex)
+    }
+
+    pub fn parse_tx(&self, raw_str: &str) -> Result<OmniTransaction> {
+        let result = unsafe { self.0.ParseTxJson(raw_str.as_ptr() as *const std::os::raw::c_char, raw_str.len()) };
+
+        if result.is_null() {
+            Err(anyhow::anyhow!("invalid omni tx"))
+        } else {
+            Ok(OmniTransaction(result))
+        }
+    }
+
+    pub fn parse_tx_bin(&self, raw: &[u8]) -> Result<OmniTransaction> {
+        let result = unsafe { self.0.ParseTxBin(raw.as_ptr(), raw.len()) };
+
+        if result.is_null() {
+            Err(anyhow::anyhow!("invalid omni tx"))
+        } else {
+            Ok(OmniTransaction(result))
+        }
+    }
+
+    /// The record's addresses are formatted for this parser's chain with `format_address`
+    pub fn parse_tx_record(&self, raw_str: &str) -> OmniTxRecord {
+        let mut record = OmniTxRecord::zeroed();
+        unsafe {
+            self.0.ParseTxRecord(raw_str.as_ptr() as *const std::os::raw::c_char, raw_str.len(), &mut record);
+        }
+        record
+    }
+
+    pub fn parse_tx_bin_record(&self, raw: &[u8]) -> OmniTxRecord {
+        let mut record = OmniTxRecord::zeroed();
+        unsafe {
+            self.0.ParseTxBinRecord(raw.as_ptr(), raw.len(), &mut record);
+        }
+        record
+    }
+
+    /// Record and typed payload of one tx, see `parse_tx_payload`
+    pub fn parse_tx_payload(&self, raw_str: &str) -> (OmniTxRecord, Option<Payload>) {
+        let mut record = OmniTxRecord::zeroed();
+        let mut payload = OmniPayload::zeroed();
+        unsafe {
+            self.0.ParseTxPayload(raw_str.as_ptr() as *const std::os::raw::c_char, raw_str.len(), &mut record, &mut payload);
+        }
+        with_payload(record, &payload)
+    }
+
+    pub fn parse_tx_bin_payload(&self, raw: &[u8]) -> (OmniTxRecord, Option<Payload>) {
+        let mut record = OmniTxRecord::zeroed();
+        let mut payload = OmniPayload::zeroed();
+        unsafe {
+            self.0.ParseTxBinPayload(raw.as_ptr(), raw.len(), &mut record, &mut payload);
+        }
+        with_payload(record, &payload)
+    }
+
+    pub fn format_address(&self, address: &OmniAddress) -> String {
+        self.0.FormatOmniAddress(address).to_string()
+    }
+
+    pub fn address_cache_stats(&self) -> AddressCacheStats {
+        self.0.GetAddressCacheStats()
+    }
+
+    /// Bound of the parse result cache, 0 (the default) turns it off and empties it
+    pub fn set_parse_cache_size(&self, entries: usize) {
+        self.0.SetParseCacheSize(entries);
+    }
+
+    pub fn parse_cache_stats(&self) -> ParseCacheStats {
+        self.0.GetParseCacheStats()
+    }
+
+    /// Stage latency histograms and status, class and type counters of this parser
+    pub fn metrics(&self) -> ParserMetrics {
+        self.0.GetMetrics()
+    }
+
+    /// Opens the LevelDB prevout store at `path`, see `open_prevout_store`; `&mut` as no parse may run meanwhile
+    pub fn open_prevout_store(&mut self, path: &str, cache_bytes: usize) -> Result<()> {
+        if self.0.pin_mut().OpenPrevoutStore(path, cache_bytes) {
+            Ok(())
+        } else {
+            Err(anyhow::anyhow!("can't open prevout store {}", path))
+        }
+    }
+
+    /// Height of the last block added to the prevout store, -1 for none
+    pub fn prevout_store_height(&self) -> i32 {
+        self.0.GetPrevoutStoreHeight().into()
+    }
+
+    /// Keeps Omni balances in memory from now on: `parse_block` applies every block to them.
+    /// Resumes from the snapshot at `checkpoint_path` if there is one and writes a new one every
+    /// `checkpoint_interval` blocks, 0 for only on `checkpoint_balances`. `&mut` as no parse may run meanwhile
+    pub fn open_balances(&mut self, checkpoint_path: &str, checkpoint_interval: i32) -> Result<()> {
+        if self.0.pin_mut().OpenBalances(checkpoint_path, autocxx::c_int(checkpoint_interval)) {
+            Ok(())
+        } else {
+            Err(anyhow::anyhow!("can't open balances from {}", checkpoint_path))
+        }
+    }
+
+    /// Last block applied to the balances, -1 for none
+    pub fn balances_height(&self) -> i32 {
+        self.0.GetBalancesHeight().into()
+    }
+
+    /// Available balance of `address` in `property`, in the smallest unit
+    pub fn balance(&self, address: &str, property: u32) -> i64 {
+        self.0.GetBalance(address, property).into()
+    }
+
+    /// false if a tx type the balances don't apply (DEx, MetaDEx, send to owners, crowdsales,
+    /// freezing, ...) touched `property`, so its balances may differ from omnicore's
+    pub fn is_balance_exact(&self, property: u32) -> bool {
+        self.0.IsBalanceExact(property)
+    }
+
+    pub fn checkpoint_balances(&self) -> Result<()> {
+        if self.0.WriteBalancesCheckpoint() {
+            Ok(())
+        } else {
+            Err(anyhow::anyhow!("can't write the balance checkpoint"))
+        }
+    }
+
+    /// Only interpret the Omni txs naming `property`, or one of the other watched properties or
+    /// addresses, and the send-alls and MetaDEx cancels of their ecosystems; the others get
+    /// status -204. Fails with balances open, which need every tx. `&mut` as no parse may run meanwhile
+    pub fn watch_property(&mut self, property: u32) -> Result<()> {
+        if self.0.pin_mut().WatchProperty(property) {
+            Ok(())
+        } else {
+            Err(anyhow::anyhow!("can't watch property {} with balances open", property))
+        }
+    }
+
+    /// Only interpret the Omni txs sent from or to `address`, or touching another watched
+    /// property or address; fails for anything but a P2PKH or P2SH address of the chain, and
+    /// with balances open
+    pub fn watch_address(&mut self, address: &str) -> Result<()> {
+        if self.0.pin_mut().WatchAddress(address) {
+            Ok(())
+        } else {
+            Err(anyhow::anyhow!("can't watch {}, not a P2PKH or P2SH address of the chain, or balances are open", address))
+        }
+    }
+
+    /// Back to interpreting every Omni tx
+    pub fn clear_watchlist(&mut self) {
+        self.0.pin_mut().ClearWatchlist();
+    }
+
+    /// A reusable parser over this one, for the allocation free record parses of one thread
+    pub fn reusable(&self) -> ReusableParser<'_> {
+        ReusableParser(ffi::OmniParser::new(&self.0).within_unique_ptr(), std::marker::PhantomData)
+    }
+
+    /// Parser for async code on `threads` C++ workers of its own (0: the number of cores), with
+    /// at most `capacity` txs in flight, see `AsyncParser`
+    pub fn async_parser(&self, threads: u32, capacity: usize) -> AsyncParser<'_> {
+        AsyncParser::new(self, threads, capacity)
+    }
+
+    /// See `parse_block`, with the prevout store of this parser
+    pub fn parse_block(&self, raw_str: &str) -> Result<Vec<OmniTransaction>> {
+        moveit! {
+            let raw_block = RawBlock::new(raw_str);
+        }
+
+        let mut parsed = self.0.ParseBlock(&raw_block);
+        if parsed.is_null() {
+            return Err(anyhow::anyhow!("invalid block"));
+        }
+
+        Ok((0..parsed.size())
+            .map(|i| OmniTransaction(parsed.pin_mut().take(i)))
+            .collect())
+    }
+}
+
+/// Parser for one thread that keeps its working memory between parses, so that once warmed
+/// up a non Omni tx costs no heap allocation. Built by `Parser::reusable`; it can move to
+/// another thread but not be shared, use one per thread.
+pub struct ReusableParser<'a>(cxx::UniquePtr<ffi::OmniParser>, std::marker::PhantomData<&'a Parser>);
+unsafe impl Send for ReusableParser<'_> {}
+
+impl ReusableParser<'_> {
+    pub fn parse_tx_record(&mut self, raw_str: &str) -> OmniTxRecord {
+        let mut record = OmniTxRecord::zeroed();
+        unsafe {
+            self.0.pin_mut().Parse(raw_str.as_ptr() as *const std::os::raw::c_char, raw_str.len(), &mut record);
+        }
+        record
+    }
+
+    pub fn parse_tx_bin_record(&mut self, raw: &[u8]) -> OmniTxRecord {
+        let mut record = OmniTxRecord::zeroed();
+        unsafe {
+            self.0.pin_mut().ParseBin(raw.as_ptr(), raw.len(), &mut record);
+        }
+        record
+    }
+
+    pub fn parse_tx_payload(&mut self, raw_str: &str) -> (OmniTxRecord, Option<Payload>) {
+        let mut record = OmniTxRecord::zeroed();
+        let mut payload = OmniPayload::zeroed();
+        unsafe {
+            self.0.pin_mut().ParsePayload(raw_str.as_ptr() as *const std::os::raw::c_char, raw_str.len(), &mut record, &mut payload);
+        }
+        with_payload(record, &payload)
+    }
+}
+
+/// Parsed txs the collector thread of an `AsyncParser` takes per crossing
+const ASYNC_COMPLETE_BATCH: usize = 256;
+
+/// Parser for async code: `parse` returns a future of the record, which any executor can
+/// drive, and many of them may be pending at once. The txs of pending futures go to a C++
+/// `ParseQueue`, whose workers parse them off a lock free ring. One thread submits every tx
+/// that arrived since its last crossing in one call, another collects up to
+/// `ASYNC_COMPLETE_BATCH` records per call and wakes their futures, so the crossings don't
+/// grow with the number of requests. Once `capacity` txs are in flight, further futures wait
+/// for a slot before they submit. Built by `Parser::async_parser`.
+pub struct AsyncParser<'a> {
+    shared: Arc<AsyncShared>,
+    threads: Vec<std::thread::JoinHandle<()>>,
+    _parser: std::marker::PhantomData<&'a Parser>,
+}
+
+struct AsyncShared {
+    queue: cxx::UniquePtr<ffi::ParseQueue>,
+    capacity: usize,
+    state: Mutex<AsyncState>,
+    submitted: Condvar,
+}
+// ParseQueue is thread safe, the rest is behind the mutex
+unsafe impl Send for AsyncShared {}
+unsafe impl Sync for AsyncShared {}
+
+#[derive(Default)]
+struct AsyncState {
+    closed: bool,
+    next_tag: u64,
+    in_flight: usize,
+    // txs for the next submission, packed the way ParseQueue::Submit takes them
+    data: String,
+    ends: Vec<usize>,
+    tags: Vec<u64>,
+    slots: HashMap<u64, AsyncSlot>,
+    // futures waiting for a slot, by the order they first found none; an entry is removed
+    // when its future is woken, takes a slot or is dropped, so each future has at most one
+    blocked: BTreeMap<u64, Waker>,
+    next_blocked: u64,
+}
+
+impl AsyncState {
+    /// Wakes up to `count` of the futures waiting longest for a slot
+    fn unblock(&mut self, count: usize, wakers: &mut Vec<Waker>) {
+        for _ in 0..count {
+            let Some(id) = self.blocked.keys().next().copied() else { break };
+            wakers.extend(self.blocked.remove(&id));
+        }
+    }
+}
+
+enum AsyncSlot {
+    Waiting(Waker),
+    Done(OmniTxRecord),
+    Abandoned,
+}
+
+impl<'a> AsyncParser<'a> {
+    fn new(parser: &'a Parser, threads: u32, capacity: usize) -> Self {
+        let capacity = capacity.max(1);
+        let shared = Arc::new(AsyncShared {
+            queue: ffi::ParseQueue::new(&parser.0, autocxx::c_uint(threads), capacity).within_unique_ptr(),
+            capacity,
+            state: Mutex::new(AsyncState::default()),
+            submitted: Condvar::new(),
+        });
+        let submitter = shared.clone();
+        let collector = shared.clone();
+        AsyncParser {
+            shared,
+            threads: vec![
+                std::thread::spawn(move || submitter.submit_loop()),
+                std::thread::spawn(move || collector.complete_loop()),
+            ],
+            _parser: std::marker::PhantomData,
+        }
+    }
+
+    /// Record of one tx, as `Parser::parse_tx_record` gives it
+    pub fn parse<'s>(&'s self, raw_str: &'s str) -> ParseFuture<'s> {
+        ParseFuture {
+            shared: &self.shared,
+            raw_str,
+            stage: ParseStage::Unsent { blocked: None },
+        }
+    }
+
+    /// Txs submitted and not yet collected
+    pub fn in_flight(&self) -> usize {
+        self.shared.state.lock().unwrap().in_flight
+    }
+}
+
+impl Drop for AsyncParser<'_> {
+    fn drop(&mut self) {
+        self.shared.state.lock().unwrap().closed = true;
+        self.shared.submitted.notify_all();
+        self.shared.queue.Close();
+        for thread in self.threads.drain(..) {
+            let _ = thread.join();
+        }
+    }
+}
+
+impl AsyncShared {
+    fn submit_loop(&self) {
+        let (mut data, mut ends, mut tags) = (String::new(), Vec::new(), Vec::new());
+        loop {
+            {
+                let mut state = self.state.lock().unwrap();
+                while state.tags.is_empty() && !state.closed {
+                    state = self.submitted.wait(state).unwrap();
+                }
+                if state.closed {
+                    return;
+                }
+                // swap the buffers, so both sides keep their capacity
+                data.clear();
+                ends.clear();
+                tags.clear();
+                std::mem::swap(&mut state.data, &mut data);
+                std::mem::swap(&mut state.ends, &mut ends);
+                std::mem::swap(&mut state.tags, &mut tags);
+            }
+            // in_flight holds the queue within capacity, so it takes all of them
+            let accepted = unsafe { self.queue.Submit(data.as_ptr() as *const std::os::raw::c_char, ends.as_ptr(), tags.as_ptr(), tags.len()) };
+            debug_assert!(accepted == tags.len() || self.state.lock().unwrap().closed);
+        }
+    }
+
+    fn complete_loop(&self) {
+        let mut records: Vec<OmniTxRecord> = (0..ASYNC_COMPLETE_BATCH).map(|_| OmniTxRecord::zeroed()).collect();
+        let mut tags = vec![0u64; ASYNC_COMPLETE_BATCH];
+        let mut wakers = Vec::new();
+        loop {
+            let count = unsafe { self.queue.Complete(records.as_mut_ptr(), tags.as_mut_ptr(), ASYNC_COMPLETE_BATCH, autocxx::c_int(100)) };
+            let mut state = self.state.lock().unwrap();
+            if count == 0 {
+                if state.closed {
+                    return;
+                }
+                continue;
+            }
+            for i in 0..count {
+                match state.slots.remove(&tags[i]) {
+                    Some(AsyncSlot::Waiting(waker)) => {
+                        state.slots.insert(tags[i], AsyncSlot::Done(std::mem::replace(&mut records[i], OmniTxRecord::zeroed())));
+                        wakers.push(waker);
+                    }
+                    // the future was dropped
+                    _ => {}
+                }
+            }
+            state.in_flight -= count;
+            state.unblock(count, &mut wakers);
+            drop(state);
+            for waker in wakers.drain(..) {
+                waker.wake();
+            }
+        }
+    }
+}
+
+enum ParseStage {
+    // blocked: the id of the future in AsyncState::blocked once it found no slot
+    Unsent { blocked: Option<u64> },
+    Sent(u64),
+    Finished,
+}
+
+/// Future of `AsyncParser::parse`; dropping it before it is ready discards the parse
+pub struct ParseFuture<'a> {
+    shared: &'a AsyncShared,
+    raw_str: &'a str,
+    stage: ParseStage,
+}
+
+impl Future for ParseFuture<'_> {
+    type Output = OmniTxRecord;
+
+    fn poll(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<OmniTxRecord> {
+        let shared = self.shared;
+        let mut state = shared.state.lock().unwrap();
+        match self.stage {
+            ParseStage::Unsent { blocked } => {
+                if state.in_flight >= shared.capacity {
+                    // a re-poll replaces its waker, and one woken for a slot another future took
+                    // gets its place in line back
+                    let id = blocked.unwrap_or_else(|| {
+                        state.next_blocked += 1;
+                        state.next_blocked
+                    });
+                    state.blocked.insert(id, cx.waker().clone());
+                    self.stage = ParseStage::Unsent { blocked: Some(id) };
+                    return Poll::Pending;
+                }
+                if let Some(id) = blocked {
+                    state.blocked.remove(&id);
+                }
+                let tag = state.next_tag;
+                state.next_tag += 1;
+                state.in_flight += 1;
+                state.data.push_str(self.raw_str);
+                let end = state.data.len();
+                state.ends.push(end);
+                state.tags.push(tag);
+                state.slots.insert(tag, AsyncSlot::Waiting(cx.waker().clone()));
+                let first = state.tags.len() == 1;
+                drop(state);
+                if first {
+                    shared.submitted.notify_one();
+                }
+                self.stage = ParseStage::Sent(tag);
+                Poll::Pending
+            }
+            ParseStage::Sent(tag) => match state.slots.remove(&tag) {
+                Some(AsyncSlot::Done(record)) => {
+                    drop(state);
+                    self.stage = ParseStage::Finished;
+                    Poll::Ready(record)
+                }
+                _ => {
+                    state.slots.insert(tag, AsyncSlot::Waiting(cx.waker().clone()));
+                    Poll::Pending
+                }
+            },
+            ParseStage::Finished => panic!("ParseFuture polled after completion"),
+        }
+    }
+}
+
+impl Drop for ParseFuture<'_> {
+    fn drop(&mut self) {
+        let mut state = self.shared.state.lock().unwrap();
+        match self.stage {
+            ParseStage::Unsent { blocked: Some(id) } => {
+                // no entry: it was woken for a slot it won't take, pass the wakeup on
+                if state.blocked.remove(&id).is_none() {
+                    let mut wakers = Vec::new();
+                    state.unblock(1, &mut wakers);
+                    drop(state);
+                    for waker in wakers {
+                        waker.wake();
+                    }
+                }
+            }
+            ParseStage::Sent(tag) => {
+                if let Some(AsyncSlot::Waiting(_)) = state.slots.remove(&tag) {
+                    state.slots.insert(tag, AsyncSlot::Abandoned);
+                }
+            }
+            _ => {}
+        }
+    }
+}
+
+/// Pending trace lines of traced parsers as json lines, at most `max` of them (0: all)
+pub fn drain_trace(max: usize) -> String {
+    ffi::DrainTrace(max).to_string()
+}
+
+/// Trace lines lost because the ring of their thread was full
+pub fn trace_dropped() -> u64 {
+    ffi::GetTraceDropped()
+}
+
+/// Bound of the scriptPubKey to address cache shared by all parse paths
+pub fn set_address_cache_size(entries: usize) {
+    ffi::SetAddressCacheSize(entries);
+}
+
+/// Hit/miss counters and size of the address cache
+pub fn address_cache_stats() -> AddressCacheStats {
+    ffi::GetAddressCacheStats()
+}
+
+/// Bound of the parse result cache of the free functions, 0 (the default) turns it off
+pub fn set_parse_cache_size(entries: usize) {
+    ffi::SetParseCacheSize(entries);
+}
+
+/// Hit/miss counters and size of the parse result cache
+pub fn parse_cache_stats() -> ParseCacheStats {
+    ffi::GetParseCacheStats()
+}
+
+/// Stage latency histograms and status, class and type counters of the free functions' parser
+pub fn metrics() -> ParserMetrics {
+    ffi::GetParserMetrics()
+}
+
+/// Number of C++ worker threads used by `parse_txs`, 0 selects the number of cores
+pub fn set_parse_threads(threads: u32) {
+    ffi::SetParseThreads(autocxx::c_uint(threads));
+}
+
+/// Parse many transactions on the C++ worker pool in one FFI crossing.
+/// Results keep the input order; an error carries the parse status code.
+pub fn parse_txs(raw_strs: &[&str]) -> Vec<std::result::Result<OmniTransaction, i32>> {
+    let mut batch = ffi::RawTxBatch::new().within_unique_ptr();
+    for raw_str in raw_strs {
+        batch.pin_mut().push(*raw_str);
+    }
+
+    let mut parsed = ffi::ParseTxBatch(&batch);
+    (0..parsed.size())
+        .map(|i| {
+            let status: i32 = parsed.status(i).into();
+            let result = parsed.pin_mut().take(i);
+            if result.is_null() {
+                Err(status)
+            } else {
+                Ok(OmniTransaction(result))
+            }
+        })
+        .collect()
+}
+
+/// Opens or creates a LevelDB prevout store at `path` for the free functions. `parse_block`
+/// adds the outputs of every block to it, and parses look up the prevouts their input leaves
+/// out there, so with blocks parsed in order a RawTx needs no `vin` at all. Spent outputs stay
+/// for 100 blocks, so a tx parsed again after its block, say on confirmation, still resolves.
+/// Call it before parsing.
+pub fn open_prevout_store(path: &str, cache_bytes: usize) -> Result<()> {
+    if ffi::OpenPrevoutStore(path, cache_bytes) {
+        Ok(())
+    } else {
+        Err(anyhow::anyhow!("can't open prevout store {}", path))
+    }
+}
+
+/// Height of the last block added to the prevout store, -1 for none
+pub fn prevout_store_height() -> i32 {
+    ffi::GetPrevoutStoreHeight().into()
+}
+
+/// Balances of the free functions' parser, see `Parser::open_balances`
+pub fn open_balances(checkpoint_path: &str, checkpoint_interval: i32) -> Result<()> {
+    if ffi::OpenBalances(checkpoint_path, autocxx::c_int(checkpoint_interval)) {
+        Ok(())
+    } else {
+        Err(anyhow::anyhow!("can't open balances from {}", checkpoint_path))
+    }
+}
+
+pub fn balances_height() -> i32 {
+    ffi::GetBalancesHeight().into()
+}
+
+pub fn balance(address: &str, property: u32) -> i64 {
+    ffi::GetBalance(address, property).into()
+}
+
+pub fn is_balance_exact(property: u32) -> bool {
+    ffi::IsBalanceExact(property)
+}
+
+pub fn checkpoint_balances() -> Result<()> {
+    if ffi::WriteBalancesCheckpoint() {
+        Ok(())
+    } else {
+        Err(anyhow::anyhow!("can't write the balance checkpoint"))
+    }
+}
+
+/// Watchlist of the free functions' parser, see `Parser::watch_property`; call it before parsing
+pub fn watch_property(property: u32) -> Result<()> {
+    if ffi::WatchProperty(property) {
+        Ok(())
+    } else {
+        Err(anyhow::anyhow!("can't watch property {} with balances open", property))
+    }
+}
+
+pub fn watch_address(address: &str) -> Result<()> {
+    if ffi::WatchAddress(address) {
+        Ok(())
+    } else {
+        Err(anyhow::anyhow!("can't watch {}, not a P2PKH or P2SH address of the chain, or balances are open", address))
+    }
+}
+
+pub fn clear_watchlist() {
+    ffi::ClearWatchlist();
+}
+
+/// Parse a whole block, `raw_str` carries the block hex, its height and only the
+/// prevouts spent from outside of the block. Returns the Omni txs in block order.
+pub fn parse_block(raw_str: &str) -> Result<Vec<OmniTransaction>> {
+    moveit! {
+        let raw_block = RawBlock::new(raw_str);
+    }
+
+    let mut parsed = ffi::ParseBlock(&raw_block);
+    if parsed.is_null() {
+        return Err(anyhow::anyhow!("invalid block"));
+    }
+
+    Ok((0..parsed.size())
+        .map(|i| OmniTransaction(parsed.pin_mut().take(i)))
+        .collect())
+}
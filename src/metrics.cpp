@@ -0,0 +1,118 @@
+#include "metrics.h"
+#include <algorithm>
+#include <tinyformat.h>
+
+namespace {
+
+//! ParserMetrics::status slots
+const int STATUS_CODES[METRICS_STATUSES] = {PARSE_OK, -1, -5, -101, -102, -103, -104, -105, -106, -107, -108, -109, -110, PARSE_ERR_DECODE, PARSE_ERR_INTERPRET, PARSE_ERR_INPUT, PARSE_FILTERED};
+
+const char* STAGE_NAMES[PARSE_STAGES] = {"decode", "classify", "sender", "reference", "deobfuscate", "interpret", "total"};
+
+const char* CLASS_NAMES[4] = {"none", "A", "B", "C"};
+
+size_t bucketOf(uint64_t ns)
+{
+    size_t bits = ns ? 64 - __builtin_clzll(ns) : 0;
+    return bits <= 8 ? 0 : std::min(bits - 8, METRICS_BUCKETS - 1);
+}
+
+} // namespace
+
+int ParseStatusIndex(int status)
+{
+    for (size_t i = 0; i < METRICS_STATUSES; ++i) {
+        if (STATUS_CODES[i] == status) return i;
+    }
+    return -1;
+}
+
+ParseMetrics::Stripe& ParseMetrics::local()
+{
+    static std::atomic<size_t> next_stripe{0};
+    thread_local size_t stripe = next_stripe.fetch_add(1, std::memory_order_relaxed);
+    return m_stripes[stripe % STRIPES];
+}
+
+void ParseMetrics::Record(ParseStage stage, Clock::duration elapsed)
+{
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    Stripe& stripe = local();
+    stripe.stageCount[stage].fetch_add(1, std::memory_order_relaxed);
+    stripe.stageNs[stage].fetch_add(ns, std::memory_order_relaxed);
+    stripe.stageBuckets[stage][bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ParseMetrics::Count(int status, int omniClass, uint32_t type)
+{
+    Stripe& stripe = local();
+    int slot = ParseStatusIndex(status);
+    if (slot >= 0) stripe.status[slot].fetch_add(1, std::memory_order_relaxed);
+    if (omniClass >= 0 && omniClass < 4) stripe.classes[omniClass].fetch_add(1, std::memory_order_relaxed);
+    if (status == PARSE_OK) stripe.types[std::min<size_t>(type, METRICS_TYPES - 1)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ParseMetrics::Snapshot(ParserMetrics& out) const
+{
+    out = ParserMetrics{};
+    for (const Stripe& stripe : m_stripes) {
+        for (size_t stage = 0; stage < PARSE_STAGES; ++stage) {
+            out.stage_count[stage] += stripe.stageCount[stage].load(std::memory_order_relaxed);
+            out.stage_ns[stage] += stripe.stageNs[stage].load(std::memory_order_relaxed);
+            for (size_t bucket = 0; bucket < METRICS_BUCKETS; ++bucket) {
+                out.stage_buckets[stage * METRICS_BUCKETS + bucket] += stripe.stageBuckets[stage][bucket].load(std::memory_order_relaxed);
+            }
+        }
+        for (size_t i = 0; i < METRICS_STATUSES; ++i) {
+            out.status[i] += stripe.status[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < 4; ++i) {
+            out.classes[i] += stripe.classes[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < METRICS_TYPES; ++i) {
+            out.types[i] += stripe.types[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+std::string FormatPrometheusMetrics(const ParserMetrics& metrics, const std::string& labels)
+{
+    // labels go first in every label set, the ones of the sample follow
+    const std::string prefix = labels.empty() ? "" : labels + ",";
+    std::string out;
+
+    out += "# HELP omni_parse_stage_seconds Time spent in each parse stage.\n";
+    out += "# TYPE omni_parse_stage_seconds histogram\n";
+    for (size_t stage = 0; stage < PARSE_STAGES; ++stage) {
+        uint64_t cumulative = 0;
+        for (size_t bucket = 0; bucket + 1 < METRICS_BUCKETS; ++bucket) {
+            cumulative += metrics.stage_buckets[stage * METRICS_BUCKETS + bucket];
+            out += strprintf("omni_parse_stage_seconds_bucket{%sstage=\"%s\",le=\"%.9g\"} %u\n", prefix, STAGE_NAMES[stage], (uint64_t{1} << (bucket + 8)) * 1e-9, cumulative);
+        }
+        out += strprintf("omni_parse_stage_seconds_bucket{%sstage=\"%s\",le=\"+Inf\"} %u\n", prefix, STAGE_NAMES[stage], metrics.stage_count[stage]);
+        out += strprintf("omni_parse_stage_seconds_sum{%sstage=\"%s\"} %.9f\n", prefix, STAGE_NAMES[stage], metrics.stage_ns[stage] * 1e-9);
+        out += strprintf("omni_parse_stage_seconds_count{%sstage=\"%s\"} %u\n", prefix, STAGE_NAMES[stage], metrics.stage_count[stage]);
+    }
+
+    out += "# HELP omni_parse_status_total Parses by final status, 0 is an Omni tx.\n";
+    out += "# TYPE omni_parse_status_total counter\n";
+    for (size_t i = 0; i < METRICS_STATUSES; ++i) {
+        out += strprintf("omni_parse_status_total{%sstatus=\"%d\"} %u\n", prefix, STATUS_CODES[i], metrics.status[i]);
+    }
+
+    out += "# HELP omni_parse_class_total Classified txs by Omni encoding class.\n";
+    out += "# TYPE omni_parse_class_total counter\n";
+    for (size_t i = 0; i < 4; ++i) {
+        out += strprintf("omni_parse_class_total{%sclass=\"%s\"} %u\n", prefix, CLASS_NAMES[i], metrics.classes[i]);
+    }
+
+    // only the types seen, there are hundreds of possible ones
+    out += "# HELP omni_parse_type_total Parsed Omni txs by tx type.\n";
+    out += "# TYPE omni_parse_type_total counter\n";
+    for (size_t i = 0; i < METRICS_TYPES; ++i) {
+        if (!metrics.types[i]) continue;
+        std::string type = i + 1 < METRICS_TYPES ? strprintf("%d", i) : "other";
+        out += strprintf("omni_parse_type_total{%stype=\"%s\"} %u\n", prefix, type, metrics.types[i]);
+    }
+    return out;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "omni.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Parse latency histograms and outcome counters of one context.
+ *
+ * Counters are relaxed atomics, split into stripes on cache lines of their own; a thread
+ * always adds to the same stripe, so parsing threads don't share lines and a parse costs a
+ * few uncontended increments plus one clock read per stage. Snapshot sums the stripes.
+ */
+class ParseMetrics
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void Record(ParseStage stage, Clock::duration elapsed);
+    //! omniClass: GetEncodingClass result, -1 if the tx was not classified
+    void Count(int status, int omniClass, uint32_t type);
+    void Snapshot(ParserMetrics& out) const;
+
+private:
+    static constexpr size_t STRIPES = 8;
+
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> stageCount[PARSE_STAGES] = {};
+        std::atomic<uint64_t> stageNs[PARSE_STAGES] = {};
+        std::atomic<uint64_t> stageBuckets[PARSE_STAGES][METRICS_BUCKETS] = {};
+        std::atomic<uint64_t> status[METRICS_STATUSES] = {};
+        std::atomic<uint64_t> classes[4] = {};
+        std::atomic<uint64_t> types[METRICS_TYPES] = {};
+    };
+
+    //! Stripe of the calling thread
+    Stripe& local();
+
+    Stripe m_stripes[STRIPES];
+};
+
+//! Times the consecutive stages of one parse and counts its outcome
+class StageTimer
+{
+public:
+    explicit StageTimer(ParseMetrics& metrics) : m_metrics(metrics), m_start(ParseMetrics::Clock::now()), m_last(m_start) {}
+
+    //! Records the time since the previous lap as stage
+    void Lap(ParseStage stage)
+    {
+        auto now = ParseMetrics::Clock::now();
+        m_metrics.Record(stage, now - m_last);
+        m_last = now;
+    }
+    //! Starts the next lap, leaving the time since the previous one unaccounted
+    void Skip()
+    {
+        m_last = ParseMetrics::Clock::now();
+    }
+    void SetClass(int omniClass)
+    {
+        m_class = omniClass;
+    }
+    //! Records the whole parse and counts status, class and, for PARSE_OK, the tx type
+    void Finish(int status, uint32_t type)
+    {
+        m_metrics.Record(STAGE_TOTAL, ParseMetrics::Clock::now() - m_start);
+        m_metrics.Count(status, m_class, type);
+    }
+
+private:
+    ParseMetrics& m_metrics;
+    const ParseMetrics::Clock::time_point m_start;
+    ParseMetrics::Clock::time_point m_last;
+    int m_class = -1;
+};
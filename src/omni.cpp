@@ -1,12 +1,29 @@
 #include "omni.h"
+#include "blockfiles.h"
+#include "hex.h"
+#include "metrics.h"
+#include "parsebuffers.h"
+#include "parserstate.h"
+#include "payload.h"
+#include "rawtx_bin.h"
+#include "workerpool.h"
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <chainparams.h>
 #include <coins.h>
 #include <consensus/amount.h>
 #include <core_io.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <fs.h>
+#include <hash.h>
 #include <key_io.h>
+#include <logging.h>
 #include <memory>
+#include <mutex>
 #include <omnicore/dex.h>
+#include <omnicore/log.h>
 #include <omnicore/mdex.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/parsing.h>
@@ -16,18 +33,22 @@
 #include <omnicore/tally.h>
 #include <omnicore/tx.h>
 #include <omnicore/utilsui.h>
+#include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <script/script.h>
 #include <script/standard.h>
+#include <streams.h>
 #include <string>
 #include <sync.h>
 #include <tinyformat.h>
 #include <uint256.h>
 #include <univalue.h>
+#include <unordered_map>
+#include <util/hasher.h>
 #include <util/strencodings.h>
-#include <util/system.cpp>
 #include <util/time.h>
 #include <validation.h>
+#include <version.h>
 #include <vector>
 
 using namespace mastercore;
@@ -36,30 +57,53 @@ using namespace mastercore;
 // library aren't required to export this symbol
 extern const std::function<std::string(const char*)> G_TRANSLATION_FUN = nullptr;
 
-//! Exodus address (changes based on network)
-static std::string exodus_address = "1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P";
+//! Context of the free functions, created by Init
+static std::unique_ptr<ParserContext> default_context;
 
+//! Workers of the batch API, created on first use
+static std::mutex parse_pool_mutex;
+static std::shared_ptr<WorkerPool> parse_pool;
+static unsigned int parse_pool_threads = 0;
 
-void ArgsManager::ForceSetArgs(const std::string& strArg, const std::vector<std::string>& strVector)
+//! The omnicore log categories of the parse path on, and the log on the console: what
+//! InitDebugLogLevels makes of -omnidebug and -printtoconsole, without going through the ArgsManager
+static void enableOmniDebugLog()
 {
-    LOCK(cs_args);
-    UniValue arr = UniValue(UniValue::VARR);
-    for (const std::string& str : strVector) {
-        arr.push_back(str);
-    }
-    m_settings.forced_settings[SettingName(strArg)] = arr;
+    msc_debug_vin = true;
+    msc_debug_parser_data = true;
+    msc_debug_parser = true;
+    msc_debug_script = true;
+    msc_debug_exo = true;
+    msc_debug_parser_dex = true;
+    msc_debug_spec = true;
+    msc_debug_verbose = true;
+    msc_debug_parser_readonly = true;
+    LogInstance().m_print_to_console = true;
+}
+
+static void addTxOutputs(CCoinsViewCache& view, const CTransaction& wtx, int nBlock)
+{
+    bool forceOverride = true;
+    bool isCoinbase = wtx.IsCoinBase();
+    const uint256& txid = wtx.GetHash();
+    for (size_t i = 0; i < wtx.vout.size(); ++i)
+        view.AddCoin(COutPoint(txid, i), Coin(wtx.vout[i], nBlock, isCoinbase), forceOverride);
 }
 
+// false if a txid or script of vin isn't hex
 static bool fillTxInputCache(CCoinsViewCache& view, const std::vector<Vin>& vin)
 {
     for (auto it = vin.begin(); it != vin.end(); ++it) {
         const Vin& vin_one = *it;
         Coin newcoin;
-        const COutPoint vin(uint256S(vin_one.txid), vin_one.vout);
+        COutPoint vin;
+        if (!DecodeTxidInto(vin_one.txid, vin.hash)) return false;
+        vin.n = vin_one.vout;
 
-        auto pks_data = ParseHexUV(vin_one.prevout.scriptPubKey.hex, "prevout.scriptPubKey.hex");
-        CScript scriptPubKey(pks_data.begin(), pks_data.end());
-        newcoin.out.scriptPubKey = scriptPubKey;
+        const std::string& scriptHex = vin_one.prevout.scriptPubKey.hex;
+        if (scriptHex.size() % 2) return false;
+        newcoin.out.scriptPubKey.resize(scriptHex.size() / 2);
+        if (!DecodeHex(scriptHex, newcoin.out.scriptPubKey.data())) return false;
 
         const CAmount nValue(vin_one.prevout.value);
         newcoin.out.nValue = nValue;
@@ -73,94 +117,184 @@ static bool fillTxInputCache(CCoinsViewCache& view, const std::vector<Vin>& vin)
 }
 
 
+// the multisig destinations as " ; " separated list, for the script trace
+static std::string formatDestinations(const ParserState& state, const std::vector<CTxDestination>& vDest)
+{
+    std::string str;
+    for (const CTxDestination& dest : vDest) {
+        str += state.EncodeDestination(dest) + " ; ";
+    }
+    return str;
+}
+
+/**
+ * Early watch stage, before sender and reference: whether the tx may touch the watchlist at all.
+ * A Class C payload is known by now, Class A and B payloads only with the sender, so those pass
+ * whenever properties are watched. Sender and reference are among the spent coins and outputs.
+ */
+static bool mayBeWatched(const Watchlist& watch, int omniClass, const CTransaction& wtx, const std::vector<Coin>& coins, Span<const unsigned char> payload)
+{
+    if (watch.WatchesProperties() && (omniClass != OMNI_CLASS_C || watch.HasPayloadProperty(payload))) {
+        return true;
+    }
+    if (watch.WatchesScripts()) {
+        for (const Coin& coin : coins) {
+            if (watch.HasScript(coin.out.scriptPubKey)) return true;
+        }
+        for (const CTxOut& txOut : wtx.vout) {
+            if (watch.HasScript(txOut.scriptPubKey)) return true;
+        }
+    }
+    return false;
+}
+
 // idx is position within the block, 0-based
 // int msc_tx_push(const CTransaction &wtx, int nBlock, unsigned int idx)
 // INPUT: bRPConly -- set to true to avoid moving funds; to be called from various RPC calls like this
 // RETURNS: 0 if parsed a MP TX
 // RETURNS: < 0 if a non-MP-TX or invalid
 // RETURNS: >0 if 1 or more payments have been made
-static int parseTx(bool bRPConly, CCoinsViewCache& view, const CTransaction& wtx, int nBlock, unsigned int idx, CMPTransaction& mp_tx, unsigned int nTime, const std::vector<Vin>& vin)
+// INPUT: view -- has to provide the coins spent by wtx
+// INPUT: timer -- gets a lap per stage
+// INPUT: buffers -- reused working memory, buffers.coins holds the coins spent by wtx afterwards
+static int parseTx(const ParserState& state, StageTimer& timer, ParseBuffers& buffers, bool bRPConly, const CCoinsView& view, const CTransaction& wtx, int nBlock, unsigned int idx, CMPTransaction& mp_tx, unsigned int nTime)
 {
     assert(bRPConly == mp_tx.isRpcOnly());
 
     // ### CLASS IDENTIFICATION AND MARKER CHECK ###
-    int omniClass = GetEncodingClass(wtx, nBlock);
+    int omniClass = state.GetEncodingClass(wtx, nBlock);
+    timer.Lap(STAGE_CLASSIFY);
+    timer.SetClass(omniClass);
     if (omniClass == NO_MARKER) {
         return -1; // No Exodus/Omni marker, thus not a valid Omni transaction
     }
 
     mp_tx.Set(wtx.GetHash(), nBlock, idx, nTime);
 
-    if (!bRPConly || msc_debug_parser_readonly) {
-        PrintToLog("____________________________________________________________________________________________________________________________________\n");
-        PrintToLog("%s(block=%d, %s idx= %d); txid: %s\n", __func__, nBlock, FormatISO8601DateTime(nTime), idx, wtx.GetHash().GetHex());
+    // the payload is extracted into the buffers, where fillOmniPayload reads it after interpret_Transaction
+    buffers.packet.resize(MAX_PACKETS * PACKET_SIZE);
+    unsigned char* single_pkt = buffers.packet.data();
+    unsigned int& packet_size = buffers.packetSize;
+    packet_size = 0;
+
+    // ### CLASS C SPECIFIC PARSING ###
+    // the payload comes first, it is all there is to Class C without the sender and the watch stage looks at it
+    if (omniClass == OMNI_CLASS_C) {
+        std::vector<Span<const unsigned char>>& op_return_script_data = buffers.classCPushes;
+        op_return_script_data.clear();
+
+        // ### POPULATE OP RETURN SCRIPT DATA ###
+        for (unsigned int n = 0; n < wtx.vout.size(); ++n) {
+            TxoutType whichType;
+            if (!GetOutputType(wtx.vout[n].scriptPubKey, whichType)) {
+                continue;
+            }
+            if (!state.IsAllowedOutputType(whichType, nBlock)) {
+                continue;
+            }
+            // only consider outputs, which are explicitly tagged
+            size_t first = op_return_script_data.size();
+            if (whichType == TxoutType::NULL_DATA && GetClassCPushSpans(wtx.vout[n].scriptPubKey, op_return_script_data)) {
+                PARSER_TRACE(state, parser_data, "Class C transaction detected: %s parsed to %s at vout %d\n", wtx.GetHash().GetHex(), HexStr(op_return_script_data[first]), n);
+            }
+        }
+        // ### EXTRACT PAYLOAD FOR CLASS C ###
+        packet_size = ConcatClassCPayload(op_return_script_data, single_pkt);
+        timer.Lap(STAGE_DEOBFUSCATE);
     }
 
+    // the library only parses read only, see the assert above
+    PARSER_TRACE(state, parser_readonly, "____________________________________________________________________________________________________________________________________\n");
+    PARSER_TRACE(state, parser_readonly, "%s(block=%d, %s idx= %d); txid: %s\n", __func__, nBlock, FormatISO8601DateTime(nTime), idx, wtx.GetHash().GetHex());
+
     // ### SENDER IDENTIFICATION ###
+    // outputs and inputs are told apart by destination, only the sender and the reference get encoded to addresses
     std::string strSender;
+    CTxDestination senderDest;
     int64_t inAll = 0;
+    buffers.senderVin = -1;
+    buffers.referenceVout = -1;
 
-    bool forceOverride = true;
-    bool isCoinbase = wtx.IsCoinBase();
-    const uint256& txid = wtx.GetHash();
-    for (size_t i = 0; i < wtx.vout.size(); ++i)
-        view.AddCoin(COutPoint(txid, i), Coin(wtx.vout[i], nBlock, isCoinbase), forceOverride);
-
-    // Add previous transaction inputs to the cache
-    if (!fillTxInputCache(view, vin)) {
-        PrintToLog("%s() ERROR: failed to get inputs for %s\n", __func__, wtx.GetHash().GetHex());
-        return -101;
+    // fetch every spent coin once, this is HaveInputs, AccessCoin and GetValueIn in one go
+    std::vector<Coin>& coins = buffers.coins;
+    coins.resize(wtx.vin.size());
+    for (unsigned int i = 0; i < wtx.vin.size(); ++i) {
+        if (!view.GetCoin(wtx.vin[i].prevout, coins[i]) || coins[i].IsSpent()) {
+            PrintToLog("%s() ERROR: failed to get inputs for %s\n", __func__, wtx.GetHash().GetHex());
+            return -101;
+        }
+        inAll += coins[i].out.nValue;
     }
 
-    assert(view.HaveInputs(wtx));
+    // ### WATCH STAGE ### - nothing watched in sight, no sender or reference to look for
+    const Watchlist& watch = state.Watched();
+    if (!watch.Empty() && !mayBeWatched(watch, omniClass, wtx, coins, Span<const unsigned char>(single_pkt, packet_size))) {
+        return PARSE_FILTERED;
+    }
 
     if (omniClass != OMNI_CLASS_C) {
         // OLD LOGIC - collect input amounts and identify sender via "largest input by sum"
-        std::map<std::string, int64_t> inputs_sum_of_values;
+        // (a flat list by destination, in place of a std::map<std::string, int64_t> by address)
+        std::vector<ParseBuffers::InputSum>& inputs_sum_of_values = buffers.inputSums;
+        inputs_sum_of_values.clear();
 
         for (unsigned int i = 0; i < wtx.vin.size(); ++i) {
-            if (msc_debug_vin) PrintToLog("vin=%d:%s\n", i, ScriptToAsmStr(wtx.vin[i].scriptSig));
+            PARSER_TRACE(state, vin, "vin=%d:%s\n", i, ScriptToAsmStr(wtx.vin[i].scriptSig));
 
-            const CTxIn& txIn = wtx.vin[i];
-            const Coin& coin = view.AccessCoin(txIn.prevout);
-            const CTxOut& txOut = coin.out;
+            const CTxOut& txOut = coins[i].out;
 
             assert(!txOut.IsNull());
 
-            CTxDestination source;
             TxoutType whichType;
             if (!GetOutputType(txOut.scriptPubKey, whichType)) {
                 return -104;
             }
-            if (!IsAllowedInputType(whichType, nBlock)) {
+            if (!state.IsAllowedInputType(whichType, nBlock)) {
                 return -105;
             }
+            CTxDestination source;
             if (ExtractDestination(txOut.scriptPubKey, source)) { // extract the destination of the previous transaction's vout[n] and check it's allowed type
-                inputs_sum_of_values[EncodeDestination(source)] += txOut.nValue;
+                auto sum = std::find_if(inputs_sum_of_values.begin(), inputs_sum_of_values.end(), [&](const ParseBuffers::InputSum& sum) { return sum.dest == source; });
+                if (sum == inputs_sum_of_values.end()) {
+                    inputs_sum_of_values.push_back({source, txOut.nValue, i});
+                } else {
+                    sum->value += txOut.nValue;
+                }
             } else
                 return -106;
         }
 
+        // the std::map picked the lowest address of a tie, encode both only then
+        auto lowerAddress = [&](const ParseBuffers::InputSum& sum, const ParseBuffers::InputSum& than) {
+            std::string address, thanAddress;
+            state.EncodeAddress(coins[sum.vin].out.scriptPubKey, address);
+            state.EncodeAddress(coins[than.vin].out.scriptPubKey, thanAddress);
+            return address < thanAddress;
+        };
         int64_t nMax = 0;
-        for (std::map<std::string, int64_t>::iterator it = inputs_sum_of_values.begin(); it != inputs_sum_of_values.end(); ++it) { // find largest by sum
-            int64_t nTemp = it->second;
-            if (nTemp > nMax) {
-                strSender = it->first;
-                if (msc_debug_exo) PrintToLog("looking for The Sender: %s , nMax=%lu, nTemp=%d\n", strSender, nMax, nTemp);
+        const ParseBuffers::InputSum* largest = nullptr;
+        for (const ParseBuffers::InputSum& sum : inputs_sum_of_values) { // find largest by sum
+            int64_t nTemp = sum.value;
+            if (nTemp > nMax || (nTemp == nMax && nMax > 0 && lowerAddress(sum, *largest))) {
+                largest = &sum;
+                PARSER_TRACE(state, exo, "looking for The Sender: vin %d , nMax=%lu, nTemp=%d\n", sum.vin, nMax, nTemp);
                 nMax = nTemp;
             }
         }
+        if (largest) {
+            buffers.senderVin = largest->vin;
+            senderDest = largest->dest;
+            state.EncodeAddress(coins[largest->vin].out.scriptPubKey, strSender);
+        }
     } else {
         // NEW LOGIC - the sender is chosen based on the first vin
 
         // determine the sender, but invalidate transaction, if the input is not accepted
         {
             unsigned int vin_n = 0; // the first input
-            if (msc_debug_vin) PrintToLog("vin=%d:%s\n", vin_n, ScriptToAsmStr(wtx.vin[vin_n].scriptSig));
+            PARSER_TRACE(state, vin, "vin=%d:%s\n", vin_n, ScriptToAsmStr(wtx.vin[vin_n].scriptSig));
 
-            const CTxIn& txIn = wtx.vin[vin_n];
-            const Coin& coin = view.AccessCoin(txIn.prevout);
-            const CTxOut& txOut = coin.out;
+            const CTxOut& txOut = coins[vin_n].out;
 
             assert(!txOut.IsNull());
 
@@ -168,120 +302,132 @@ static int parseTx(bool bRPConly, CCoinsViewCache& view, const CTransaction& wtx
             if (!GetOutputType(txOut.scriptPubKey, whichType)) {
                 return -108;
             }
-            if (!IsAllowedInputType(whichType, nBlock)) {
+            if (!state.IsAllowedInputType(whichType, nBlock)) {
                 return -109;
             }
-            CTxDestination source;
-            if (ExtractDestination(txOut.scriptPubKey, source)) {
-                strSender = EncodeDestination(source);
-            } else
+            if (!ExtractDestination(txOut.scriptPubKey, senderDest) || !state.EncodeAddress(txOut.scriptPubKey, strSender)) {
                 return -110;
+            }
+            buffers.senderVin = vin_n;
         }
     }
 
-    inAll = view.GetValueIn(wtx);
-
     int64_t outAll = wtx.GetValueOut();
     int64_t txFee = inAll - outAll; // miner fee
 
     if (!strSender.empty()) {
-        if (msc_debug_verbose) PrintToLog("The Sender: %s : fee= %s\n", strSender, FormatDivisibleMP(txFee));
+        PARSER_TRACE(state, verbose, "The Sender: %s : fee= %s\n", strSender, FormatDivisibleMP(txFee));
     } else {
         PrintToLog("The sender is still EMPTY !!! txid: %s\n", wtx.GetHash().GetHex());
         return -5;
     }
+    timer.Lap(STAGE_SENDER);
 
-    // ### DATA POPULATION ### - save output addresses, values and scripts
+    // ### DATA POPULATION ### - save output destinations, values and scripts
     std::string strReference;
-    unsigned char single_pkt[MAX_PACKETS * PACKET_SIZE];
-    unsigned int packet_size = 0;
-    std::vector<std::string> script_data;
-    std::vector<std::string> address_data;
-    std::vector<int64_t> value_data;
+    std::vector<Span<const unsigned char>>& script_data = buffers.scriptData;
+    std::vector<CTxDestination>& dest_data = buffers.destData;
+    std::vector<unsigned int>& output_data = buffers.outputData;
+    std::vector<int64_t>& value_data = buffers.valueData;
+    script_data.clear();
+    dest_data.clear();
+    output_data.clear();
+    value_data.clear();
+    const CTxDestination& exodusDest = state.ExodusDestination();
+
+    // address of the k-th saved output, for the traces
+    auto outputAddress = [&](size_t k) {
+        std::string address;
+        state.EncodeAddress(wtx.vout[output_data[k]].scriptPubKey, address);
+        return address;
+    };
 
     for (size_t n = 0; n < wtx.vout.size(); ++n) {
         TxoutType whichType;
         if (!GetOutputType(wtx.vout[n].scriptPubKey, whichType)) {
             continue;
         }
-        if (!IsAllowedOutputType(whichType, nBlock)) {
+        if (!state.IsAllowedOutputType(whichType, nBlock)) {
             continue;
         }
         CTxDestination dest;
-        if (ExtractDestination(wtx.vout[n].scriptPubKey, dest)) {
-            if (!(dest == ExodusAddress())) {
-                // saving for Class A processing or reference
-                GetScriptPushes(wtx.vout[n].scriptPubKey, script_data);
-                std::string address = EncodeDestination(dest);
-                address_data.push_back(address);
-                mp_tx.addValidStmAddress(n, address);
-                value_data.push_back(wtx.vout[n].nValue);
-                if (msc_debug_parser_data) PrintToLog("saving address_data #%d: %s:%s\n", n, EncodeDestination(dest), ScriptToAsmStr(wtx.vout[n].scriptPubKey));
-            }
+        if (wtx.vout[n].scriptPubKey != state.ExodusScript() && ExtractDestination(wtx.vout[n].scriptPubKey, dest)) {
+            // saving for Class A processing or reference
+            GetScriptPushSpans(wtx.vout[n].scriptPubKey, script_data);
+            dest_data.push_back(dest);
+            output_data.push_back(n);
+            value_data.push_back(wtx.vout[n].nValue);
+            PARSER_TRACE(state, parser_data, "saving address_data #%d: %s:%s\n", n, outputAddress(dest_data.size() - 1), ScriptToAsmStr(wtx.vout[n].scriptPubKey));
         }
     }
-    if (msc_debug_parser_data) PrintToLog(" address_data.size=%lu\n script_data.size=%lu\n value_data.size=%lu\n", address_data.size(), script_data.size(), value_data.size());
+    PARSER_TRACE(state, parser_data, " address_data.size=%lu\n script_data.size=%lu\n value_data.size=%lu\n", dest_data.size(), script_data.size(), value_data.size());
+
+    // the reference is an index into the saved outputs until it is final
+    int reference = -1;
+    auto setReference = [&]() {
+        if (reference < 0) return;
+        buffers.referenceVout = output_data[reference];
+    };
+    // address of the reference for the traces, strReference is only encoded once the tx passed the watch stage
+    auto referenceAddress = [&]() {
+        std::string address;
+        if (buffers.referenceVout >= 0) state.EncodeAddress(wtx.vout[buffers.referenceVout].scriptPubKey, address);
+        return address;
+    };
 
     // ### CLASS A PARSING ###
     if (omniClass == OMNI_CLASS_A) {
-        std::string strScriptData;
-        std::string strDataAddress;
-        std::string strRefAddress;
+        // outputs with more than one push shift script_data against the other lists, the old code did that too
+        size_t outputs = std::min(script_data.size(), dest_data.size());
+        Span<const unsigned char> scriptData;
+        int dataAddress = -1;
         unsigned char dataAddressSeq = 0xFF;
         unsigned char seq = 0xFF;
         int64_t dataAddressValue = 0;
-        for (unsigned k = 0; k < script_data.size(); ++k) {                                // Step 1, locate the data packet
-            std::string strSub = script_data[k].substr(2, 16);                             // retrieve bytes 1-9 of packet for peek & decode comparison
-            seq = (ParseHex(script_data[k].substr(0, 2)))[0];                              // retrieve sequence number
-            if ("0000000000000001" == strSub || "0000000000000002" == strSub) {            // peek & decode comparison
-                if (strScriptData.empty()) {                                               // confirm we have not already located a data address
-                    strScriptData = script_data[k].substr(2 * 1, 2 * PACKET_SIZE_CLASS_A); // populate data packet
-                    strDataAddress = address_data[k];                                      // record data address
-                    dataAddressSeq = seq;                                                  // record data address seq num for reference matching
-                    dataAddressValue = value_data[k];                                      // record data address amount for reference matching
-                    if (msc_debug_parser_data) PrintToLog("Data Address located - data[%d]:%s: %s (%s)\n", k, script_data[k], address_data[k], FormatDivisibleMP(value_data[k]));
-                } else {                    // invalidate - Class A cannot be more than one data packet - possible collision, treat as default (BTC payment)
-                    strDataAddress.clear(); // empty strScriptData to block further parsing
-                    if (msc_debug_parser_data) PrintToLog("Multiple Data Addresses found (collision?) Class A invalidated, defaulting to BTC payment\n");
+        for (unsigned k = 0; k < outputs; ++k) {                                                 // Step 1, locate the data packet
+            if (IsClassADataPacket(script_data[k])) {                                            // peek & decode comparison of bytes 1-8
+                if (scriptData.empty()) {                                                        // confirm we have not already located a data address
+                    scriptData = script_data[k].subspan(1, std::min<size_t>(PACKET_SIZE_CLASS_A, script_data[k].size() - 1)); // populate data packet
+                    dataAddress = k;                                                             // record data address
+                    dataAddressSeq = script_data[k][0];                                          // record data address seq num for reference matching
+                    dataAddressValue = value_data[k];                                            // record data address amount for reference matching
+                    PARSER_TRACE(state, parser_data, "Data Address located - data[%d]:%s: %s (%s)\n", k, HexStr(script_data[k]), outputAddress(k), FormatDivisibleMP(value_data[k]));
+                } else {               // invalidate - Class A cannot be more than one data packet - possible collision, treat as default (BTC payment)
+                    dataAddress = -1;  // forget the data address to block further parsing
+                    PARSER_TRACE(state, parser_data, "Multiple Data Addresses found (collision?) Class A invalidated, defaulting to BTC payment\n");
                     break;
                 }
             }
         }
-        if (!strDataAddress.empty()) { // Step 2, try to locate address with seqnum = DataAddressSeq+1 (also verify Step 1, we should now have a valid data packet)
+        if (dataAddress >= 0) { // Step 2, try to locate address with seqnum = DataAddressSeq+1 (also verify Step 1, we should now have a valid data packet)
+            const CTxDestination& dataDest = dest_data[dataAddress];
             unsigned char expectedRefAddressSeq = dataAddressSeq + 1;
-            for (unsigned k = 0; k < script_data.size(); ++k) {                                                                     // loop through outputs
-                seq = (ParseHex(script_data[k].substr(0, 2)))[0];                                                                   // retrieve sequence number
-                if ((address_data[k] != strDataAddress) && (address_data[k] != exodus_address) && (expectedRefAddressSeq == seq)) { // found reference address with matching sequence number
-                    if (strRefAddress.empty()) {                                                                                    // confirm we have not already located a reference address
-                        strRefAddress = address_data[k];                                                                            // set ref address
-                        if (msc_debug_parser_data) PrintToLog("Reference Address located via seqnum - data[%d]:%s: %s (%s)\n", k, script_data[k], address_data[k], FormatDivisibleMP(value_data[k]));
-                    } else {                   // can't trust sequence numbers to provide reference address, there is a collision with >1 address with expected seqnum
-                        strRefAddress.clear(); // blank ref address
-                        if (msc_debug_parser_data) PrintToLog("Reference Address sequence number collision, will fall back to evaluating matching output amounts\n");
+            for (unsigned k = 0; k < outputs; ++k) {                                                                  // loop through outputs
+                if (script_data[k].empty()) continue;                                                                 // no sequence number
+                seq = script_data[k][0];                                                                              // retrieve sequence number
+                if (!(dest_data[k] == dataDest) && !(dest_data[k] == exodusDest) && (expectedRefAddressSeq == seq)) { // found reference address with matching sequence number
+                    if (reference < 0) {                                                                              // confirm we have not already located a reference address
+                        reference = k;                                                                                // set ref address
+                        PARSER_TRACE(state, parser_data, "Reference Address located via seqnum - data[%d]:%s: %s (%s)\n", k, HexStr(script_data[k]), outputAddress(k), FormatDivisibleMP(value_data[k]));
+                    } else {            // can't trust sequence numbers to provide reference address, there is a collision with >1 address with expected seqnum
+                        reference = -1; // blank ref address
+                        PARSER_TRACE(state, parser_data, "Reference Address sequence number collision, will fall back to evaluating matching output amounts\n");
                         break;
                     }
                 }
             }
-            std::vector<int64_t> ExodusValues;
-            for (unsigned int n = 0; n < wtx.vout.size(); ++n) {
-                CTxDestination dest;
-                if (ExtractDestination(wtx.vout[n].scriptPubKey, dest)) {
-                    if (dest == ExodusAddress()) {
-                        ExodusValues.push_back(wtx.vout[n].nValue);
-                    }
-                }
-            }
-            if (strRefAddress.empty()) {                                                                                                     // Step 3, if we still don't have a reference address, see if we can locate an address with matching output amounts
-                for (unsigned k = 0; k < script_data.size(); ++k) {                                                                          // loop through outputs
-                    if ((address_data[k] != strDataAddress) && (address_data[k] != exodus_address) && (dataAddressValue == value_data[k])) { // this output matches data output, check if matches exodus output
-                        for (unsigned int exodus_idx = 0; exodus_idx < ExodusValues.size(); exodus_idx++) {
-                            if (value_data[k] == ExodusValues[exodus_idx]) { // this output matches data address value and exodus address value, choose as ref
-                                if (strRefAddress.empty()) {
-                                    strRefAddress = address_data[k];
-                                    if (msc_debug_parser_data) PrintToLog("Reference Address located via matching amounts - data[%d]:%s: %s (%s)\n", k, script_data[k], address_data[k], FormatDivisibleMP(value_data[k]));
+            if (reference < 0) {                                                                                           // Step 3, if we still don't have a reference address, see if we can locate an address with matching output amounts
+                for (unsigned k = 0; k < outputs; ++k) {                                                                   // loop through outputs
+                    if (!(dest_data[k] == dataDest) && !(dest_data[k] == exodusDest) && (dataAddressValue == value_data[k])) { // this output matches data output, check if matches exodus output
+                        for (const CTxOut& exodusOut : wtx.vout) {
+                            if (exodusOut.scriptPubKey != state.ExodusScript()) continue;
+                            if (value_data[k] == exodusOut.nValue) { // this output matches data address value and exodus address value, choose as ref
+                                if (reference < 0) {
+                                    reference = k;
+                                    PARSER_TRACE(state, parser_data, "Reference Address located via matching amounts - data[%d]:%s: %s (%s)\n", k, HexStr(script_data[k]), outputAddress(k), FormatDivisibleMP(value_data[k]));
                                 } else {
-                                    strRefAddress.clear();
-                                    if (msc_debug_parser_data) PrintToLog("Reference Address collision, multiple potential candidates. Class A invalidated, defaulting to BTC payment\n");
+                                    reference = -1;
+                                    PARSER_TRACE(state, parser_data, "Reference Address collision, multiple potential candidates. Class A invalidated, defaulting to BTC payment\n");
                                     break;
                                 }
                             }
@@ -289,87 +435,79 @@ static int parseTx(bool bRPConly, CCoinsViewCache& view, const CTransaction& wtx
                     }
                 }
             }
-        } // end if (!strDataAddress.empty())
-        if (!strRefAddress.empty()) {
-            strReference = strRefAddress; // populate expected var strReference with chosen address (if not empty)
-        }
-        if (strRefAddress.empty()) {
-            strDataAddress.clear(); // last validation step, if strRefAddress is empty, blank strDataAddress so we default to BTC payment
+        } // end if (dataAddress >= 0)
+        setReference(); // populate the reference with the chosen output (if any)
+        if (reference < 0) {
+            dataAddress = -1; // last validation step, if there is no reference, forget the data address so we default to BTC payment
         }
-        if (!strDataAddress.empty()) { // valid Class A packet almost ready
-            if (msc_debug_parser_data) PrintToLog("valid Class A:from=%s:to=%s:data=%s\n", strSender, strReference, strScriptData);
+        if (dataAddress >= 0) { // valid Class A packet almost ready
+            PARSER_TRACE(state, parser_data, "valid Class A:from=%s:to=%s:data=%s\n", strSender, referenceAddress(), HexStr(scriptData));
             packet_size = PACKET_SIZE_CLASS_A;
-            memcpy(single_pkt, &ParseHex(strScriptData)[0], packet_size);
+            memcpy(single_pkt, scriptData.data(), scriptData.size());
+            memset(single_pkt + scriptData.size(), 0, packet_size - scriptData.size());
         } else {
-            if ((!bRPConly || msc_debug_parser_readonly) && msc_debug_parser_dex) {
-                PrintToLog("!! sender: %s , receiver: %s\n", strSender, strReference);
-                PrintToLog("!! this may be the BTC payment for an offer !!\n");
-            }
+            PARSER_TRACE(state, parser_dex, "!! sender: %s , receiver: %s\n", strSender, referenceAddress());
+            PARSER_TRACE(state, parser_dex, "!! this may be the BTC payment for an offer !!\n");
         }
+        timer.Lap(STAGE_REFERENCE);
     }
     // ### CLASS B / CLASS C PARSING ###
     if ((omniClass == OMNI_CLASS_B) || (omniClass == OMNI_CLASS_C)) {
-        if (msc_debug_parser_data) PrintToLog("Beginning reference identification\n");
-        bool referenceFound = false;                         // bool to hold whether we've found the reference yet
-        bool changeRemoved = false;                          // bool to hold whether we've ignored the first output to sender as change
-        unsigned int potentialReferenceOutputs = 0;          // int to hold number of potential reference outputs
-        for (unsigned k = 0; k < address_data.size(); ++k) { // how many potential reference outputs do we have, if just one select it right here
-            const std::string& addr = address_data[k];
-            if (msc_debug_parser_data) PrintToLog("ref? data[%d]:%s: %s (%s)\n", k, script_data[k], addr, FormatIndivisibleMP(value_data[k]));
-            if (addr != exodus_address) {
+        PARSER_TRACE(state, parser_data, "Beginning reference identification\n");
+        bool referenceFound = false;                      // bool to hold whether we've found the reference yet
+        bool changeRemoved = false;                       // bool to hold whether we've ignored the first output to sender as change
+        unsigned int potentialReferenceOutputs = 0;       // int to hold number of potential reference outputs
+        for (unsigned k = 0; k < dest_data.size(); ++k) { // how many potential reference outputs do we have, if just one select it right here
+            PARSER_TRACE(state, parser_data, "ref? data[%d]:%s: %s (%s)\n", k, k < script_data.size() ? HexStr(script_data[k]) : "", outputAddress(k), FormatIndivisibleMP(value_data[k]));
+            if (!(dest_data[k] == exodusDest)) {
                 ++potentialReferenceOutputs;
                 if (1 == potentialReferenceOutputs) {
-                    strReference = addr;
+                    reference = k;
                     referenceFound = true;
-                    if (msc_debug_parser_data) PrintToLog("Single reference potentially id'd as follows: %s \n", strReference);
-                } else {                  // as soon as potentialReferenceOutputs > 1 we need to go fishing
-                    strReference.clear(); // avoid leaving strReference populated for sanity
+                    PARSER_TRACE(state, parser_data, "Single reference potentially id'd as follows: %s \n", outputAddress(k));
+                } else {            // as soon as potentialReferenceOutputs > 1 we need to go fishing
+                    reference = -1; // avoid leaving the reference populated for sanity
                     referenceFound = false;
-                    if (msc_debug_parser_data) PrintToLog("More than one potential reference candidate, blanking strReference, need to go fishing\n");
+                    PARSER_TRACE(state, parser_data, "More than one potential reference candidate, blanking strReference, need to go fishing\n");
                 }
             }
         }
         if (!referenceFound) { // do we have a reference now? or do we need to dig deeper
-            if (msc_debug_parser_data) PrintToLog("Reference has not been found yet, going fishing\n");
-            for (unsigned k = 0; k < address_data.size(); ++k) {
-                const std::string& addr = address_data[k];
-                if (addr != exodus_address) { // removed strSender restriction, not to spec
-                    if (addr == strSender && !changeRemoved) {
+            PARSER_TRACE(state, parser_data, "Reference has not been found yet, going fishing\n");
+            for (unsigned k = 0; k < dest_data.size(); ++k) {
+                if (!(dest_data[k] == exodusDest)) { // removed strSender restriction, not to spec
+                    if (dest_data[k] == senderDest && !changeRemoved) {
                         changeRemoved = true; // per spec ignore first output to sender as change if multiple possible ref addresses
-                        if (msc_debug_parser_data) PrintToLog("Removed change\n");
+                        PARSER_TRACE(state, parser_data, "Removed change\n");
                     } else {
-                        strReference = addr; // this may be set several times, but last time will be highest vout
-                        if (msc_debug_parser_data) PrintToLog("Resetting strReference as follows: %s \n ", strReference);
+                        reference = k; // this may be set several times, but last time will be highest vout
+                        PARSER_TRACE(state, parser_data, "Resetting strReference as follows: %s \n ", outputAddress(k));
                     }
                 }
             }
         }
-        if (msc_debug_parser_data) PrintToLog("Ending reference identification\nFinal decision on reference identification is: %s\n", strReference);
+        setReference();
+        PARSER_TRACE(state, parser_data, "Ending reference identification\nFinal decision on reference identification is: %s\n", referenceAddress());
+        timer.Lap(STAGE_REFERENCE);
 
         // ### CLASS B SPECIFIC PARSING ###
         if (omniClass == OMNI_CLASS_B) {
-            std::vector<std::string> multisig_script_data;
+            std::vector<Span<const unsigned char>> multisig_script_data;
 
             // ### POPULATE MULTISIG SCRIPT DATA ###
             for (unsigned int i = 0; i < wtx.vout.size(); ++i) {
                 TxoutType whichType;
                 std::vector<CTxDestination> vDest;
                 int nRequired;
-                if (msc_debug_script) PrintToLog("scriptPubKey: %s\n", HexStr(wtx.vout[i].scriptPubKey));
+                PARSER_TRACE(state, script, "scriptPubKey: %s\n", HexStr(wtx.vout[i].scriptPubKey));
                 if (!ExtractDestinations(wtx.vout[i].scriptPubKey, whichType, vDest, nRequired)) {
                     continue;
                 }
                 if (whichType == TxoutType::MULTISIG) {
-                    if (msc_debug_script) {
-                        PrintToLog(" >> multisig: ");
-                        for (const CTxDestination& dest : vDest) {
-                            PrintToLog("%s ; ", EncodeDestination(dest));
-                        }
-                        PrintToLog("\n");
-                    }
+                    PARSER_TRACE(state, script, " >> multisig: %s\n", formatDestinations(state, vDest));
                     // ignore first public key, as it should belong to the sender
                     // and it be used to avoid the creation of unspendable dust
-                    GetScriptPushes(wtx.vout[i].scriptPubKey, multisig_script_data, true);
+                    GetScriptPushSpans(wtx.vout[i].scriptPubKey, multisig_script_data, true);
                 }
             }
 
@@ -386,118 +524,57 @@ static int parseTx(bool bRPConly, CCoinsViewCache& view, const CTransaction& wtx
                 PrintToLog("limiting number of packets to %d [extracted=%d]\n", nPackets, multisig_script_data.size());
             }
 
-            // ### PREPARE A FEW VARS ###
-            std::string strObfuscatedHashes[1 + MAX_SHA256_OBFUSCATION_TIMES];
-            PrepareObfuscatedHashes(strSender, 1 + nPackets, strObfuscatedHashes);
-            unsigned char packets[MAX_PACKETS][32];
-            unsigned int mdata_count = 0; // multisig data count
-
             // ### DEOBFUSCATE MULTISIG PACKETS ###
-            for (unsigned int k = 0; k < nPackets; ++k) {
-                assert(mdata_count < MAX_PACKETS);
-                assert(mdata_count < MAX_SHA256_OBFUSCATION_TIMES);
+            unsigned char packets[MAX_PACKETS][PACKET_SIZE];
+            unsigned int mdata_count = nPackets; // multisig data count
+            DeobfuscateClassB(strSender, Span<const Span<const unsigned char>>(multisig_script_data.data(), nPackets), &packets[0][0]);
 
-                std::vector<unsigned char> hash = ParseHex(strObfuscatedHashes[mdata_count + 1]);
-                std::vector<unsigned char> packet = ParseHex(multisig_script_data[k].substr(2 * 1, 2 * PACKET_SIZE));
-                for (unsigned int i = 0; i < packet.size(); i++) { // this is a data packet, must deobfuscate now
-                    packet[i] ^= hash[i];
-                }
-                memcpy(&packets[mdata_count], &packet[0], PACKET_SIZE);
-                ++mdata_count;
-
-                if (msc_debug_parser_data) {
-                    CPubKey key(ParseHex(multisig_script_data[k]));
-                    std::string strAddress = EncodeDestination(PKHash(key));
-                    PrintToLog("multisig_data[%d]:%s: %s\n", k, multisig_script_data[k], strAddress);
-                }
-                if (msc_debug_parser) {
-                    if (!packet.empty()) {
-                        std::string strPacket = HexStr(packet.begin(), packet.end());
-                        PrintToLog("packet #%d: %s\n", mdata_count, strPacket);
-                    }
-                }
+            for (unsigned int k = 0; k < nPackets; ++k) {
+                PARSER_TRACE(state, parser_data, "multisig_data[%d]:%s: %s\n", k, HexStr(multisig_script_data[k]), state.EncodeDestination(PKHash(CPubKey(multisig_script_data[k].begin(), multisig_script_data[k].end()))));
+                PARSER_TRACE(state, parser, "packet #%d: %s\n", k + 1, HexStr(Span<const unsigned char>(packets[k], PACKET_SIZE)));
             }
             packet_size = mdata_count * (PACKET_SIZE - 1);
-            assert(packet_size <= sizeof(single_pkt));
+            assert(packet_size <= buffers.packet.size());
 
             // ### FINALIZE CLASS B ###
             for (unsigned int m = 0; m < mdata_count; ++m) { // now decode mastercoin packets
-                if (msc_debug_parser) PrintToLog("m=%d: %s\n", m, HexStr(packets[m], PACKET_SIZE + packets[m]));
+                PARSER_TRACE(state, parser, "m=%d: %s\n", m, HexStr(packets[m], PACKET_SIZE + packets[m]));
 
                 // check to ensure the sequence numbers are sequential and begin with 01 !
                 if (1 + m != packets[m][0]) {
-                    if (msc_debug_spec) PrintToLog("Error: non-sequential seqnum ! expected=%d, got=%d\n", 1 + m, packets[m][0]);
+                    PARSER_TRACE(state, spec, "Error: non-sequential seqnum ! expected=%d, got=%d\n", 1 + m, packets[m][0]);
                 }
 
                 memcpy(m * (PACKET_SIZE - 1) + single_pkt, 1 + packets[m], PACKET_SIZE - 1); // now ignoring sequence numbers for Class B packets
             }
+            timer.Lap(STAGE_DEOBFUSCATE);
         }
 
-        // ### CLASS C SPECIFIC PARSING ###
-        if (omniClass == OMNI_CLASS_C) {
-            std::vector<std::string> op_return_script_data;
+    }
 
-            // ### POPULATE OP RETURN SCRIPT DATA ###
-            for (unsigned int n = 0; n < wtx.vout.size(); ++n) {
-                TxoutType whichType;
-                if (!GetOutputType(wtx.vout[n].scriptPubKey, whichType)) {
-                    continue;
-                }
-                if (!IsAllowedOutputType(whichType, nBlock)) {
-                    continue;
-                }
-                if (whichType == TxoutType::NULL_DATA) {
-                    // only consider outputs, which are explicitly tagged
-                    std::vector<std::string> vstrPushes;
-                    if (!GetScriptPushes(wtx.vout[n].scriptPubKey, vstrPushes)) {
-                        continue;
-                    }
-                    // TODO: maybe encapsulate the following sort of messy code
-                    if (!vstrPushes.empty()) {
-                        std::vector<unsigned char> vchMarker = GetOmMarker();
-                        std::vector<unsigned char> vchPushed = ParseHex(vstrPushes[0]);
-                        if (vchPushed.size() < vchMarker.size()) {
-                            continue;
-                        }
-                        if (std::equal(vchMarker.begin(), vchMarker.end(), vchPushed.begin())) {
-                            size_t sizeHex = vchMarker.size() * 2;
-                            // strip out the marker at the very beginning
-                            vstrPushes[0] = vstrPushes[0].substr(sizeHex);
-                            // add the data to the rest
-                            op_return_script_data.insert(op_return_script_data.end(), vstrPushes.begin(), vstrPushes.end());
-
-                            if (msc_debug_parser_data) {
-                                PrintToLog("Class C transaction detected: %s parsed to %s at vout %d\n", wtx.GetHash().GetHex(), vstrPushes[0], n);
-                            }
-                        }
-                    }
-                }
-            }
-            // ### EXTRACT PAYLOAD FOR CLASS C ###
-            for (unsigned int n = 0; n < op_return_script_data.size(); ++n) {
-                if (!op_return_script_data[n].empty()) {
-                    assert(IsHex(op_return_script_data[n])); // via GetScriptPushes()
-                    std::vector<unsigned char> vch = ParseHex(op_return_script_data[n]);
-                    unsigned int payload_size = vch.size();
-                    if (packet_size + payload_size > MAX_PACKETS * PACKET_SIZE) {
-                        payload_size = MAX_PACKETS * PACKET_SIZE - packet_size;
-                        PrintToLog("limiting payload size to %d byte\n", packet_size + payload_size);
-                    }
-                    if (payload_size > 0) {
-                        memcpy(single_pkt + packet_size, &vch[0], payload_size);
-                        packet_size += payload_size;
-                    }
-                    if (MAX_PACKETS * PACKET_SIZE == packet_size) {
-                        break;
-                    }
-                }
-            }
+    // ### WATCH STAGE ### - with sender, reference and payload known, only watched txs go on to be interpreted
+    if (!watch.Empty()) {
+        bool watched = watch.HasPayloadProperty(Span<const unsigned char>(single_pkt, packet_size)) ||
+                       watch.HasScript(coins[buffers.senderVin].out.scriptPubKey) ||
+                       (buffers.referenceVout >= 0 && watch.HasScript(wtx.vout[buffers.referenceVout].scriptPubKey));
+        if (!watched) return PARSE_FILTERED;
+    }
+    if (buffers.referenceVout >= 0) {
+        state.EncodeAddress(wtx.vout[buffers.referenceVout].scriptPubKey, strReference);
+    }
+
+    // only send-to-many reads the addresses of the outputs, they are encoded for it alone
+    if (packet_size >= 4 && (single_pkt[2] << 8 | single_pkt[3]) == MSC_TYPE_SEND_TO_MANY) {
+        std::string address;
+        for (unsigned int n : output_data) {
+            state.EncodeAddress(wtx.vout[n].scriptPubKey, address);
+            mp_tx.addValidStmAddress(n, address);
         }
     }
 
     // ### SET MP TX INFO ###
-    if (msc_debug_verbose) PrintToLog("single_pkt: %s\n", HexStr(single_pkt, packet_size + single_pkt));
-    mp_tx.Set(strSender, strReference, 0, wtx.GetHash(), nBlock, idx, (unsigned char*)&single_pkt, packet_size, omniClass, (inAll - outAll));
+    PARSER_TRACE(state, verbose, "single_pkt: %s\n", HexStr(single_pkt, packet_size + single_pkt));
+    mp_tx.Set(strSender, strReference, 0, wtx.GetHash(), nBlock, idx, single_pkt, packet_size, omniClass, (inAll - outAll));
 
     // TODO: the following is a bit awful
     // Provide a hint for DEx payments
@@ -511,49 +588,1053 @@ static int parseTx(bool bRPConly, CCoinsViewCache& view, const CTransaction& wtx
 // chain: main, test, signet, regtest
 void Init(std::string chain, bool debug)
 {
-    if (debug) {
-        gArgs.ForceSetArgs("-omnidebug", std::vector<std::string>{"vin", "parser_data", "parser", "script", "exo", "parser_dex", "spec", "verbose", "parser_readonly"});
-        gArgs.SoftSetBoolArg("-printtoconsole", true);
-        InitDebugLogLevels();
+    // once per process: Params() is process wide and the default context may be parsing already
+    static std::once_flag once;
+    static std::string initChain;
+    bool first = false;
+    std::call_once(once, [&] {
+        first = true;
+        initChain = chain;
+        if (debug) enableOmniDebugLog();
+        // still selected for the omnicore code that reads Params(), the parser itself goes by its context
+        SelectParams(chain);
+        // use the SHA-NI/AVX2/SSE4 transforms for the Class B hash chains
+        SHA256AutoDetect();
+        default_context = std::make_unique<ParserContext>(chain, debug);
+    });
+    if (!first && chain != initChain) {
+        PrintToLog("Init(%s) ignored, the process runs on %s; use a ParserContext for other chains\n", chain, initChain);
     }
-    SelectParams(chain);
 }
 
-std::unique_ptr<OmniTx> ParseTx(const RawTx& rawTx)
+ParserContext::ParserContext(std::string chain, bool debug, bool traceRing) : m_state(std::make_unique<ParserState>(chain, debug, traceRing))
 {
-    auto hexTx = rawTx.hex;
+}
 
-    CMutableTransaction tx;
-    if (!DecodeHexTx(tx, hexTx)) {
-        if (msc_debug_verbose) PrintToLog("decode hexTx failed: %s", hexTx);
-        return nullptr;
+ParserContext::~ParserContext() = default;
+
+bool IsOmniCandidate(Span<const unsigned char> txBytes)
+{
+    return default_context->IsOmniCandidate(txBytes);
+}
+
+bool IsOmniCandidateHex(const std::string& hexTx)
+{
+    return default_context->IsOmniCandidateHex(hexTx);
+}
+
+bool ParserContext::IsOmniCandidate(Span<const unsigned char> txBytes) const
+{
+    return m_state->Prefilter().Check(txBytes);
+}
+
+bool ParserContext::IsOmniCandidateHex(const std::string& hexTx) const
+{
+    return m_state->Prefilter().CheckHex(hexTx);
+}
+
+static void setOmniAddress(OmniAddress& address, const CScript& scriptPubKey)
+{
+    // the standard script of the address, as DecodeDestination of the encoded address would give
+    CTxDestination dest;
+    if (!ExtractDestination(scriptPubKey, dest)) return;
+    CScript script = GetScriptForDestination(dest);
+
+    std::vector<std::vector<unsigned char>> solutions;
+    address.type = static_cast<uint8_t>(Solver(script, solutions));
+    address.size = std::min(script.size(), sizeof(address.script));
+    memcpy(address.script, script.data(), address.size);
+}
+
+//! Copies str into a NUL terminated string field, cut to PAYLOAD_STRING_SIZE - 1 characters
+static void setPayloadString(uint8_t (&field)[PAYLOAD_STRING_SIZE], const std::string& str)
+{
+    size_t size = std::min(str.size(), PAYLOAD_STRING_SIZE - 1);
+    memcpy(field, str.data(), size);
+    field[size] = 0;
+}
+
+// fills the member of payload for the type of the interpreted mp_obj, pkt is the payload parseTx handed it
+static void fillOmniPayload(const ParserState& state, const CMPTransaction& mp_obj, Span<const unsigned char> pkt, OmniPayload& payload)
+{
+    payload.type = mp_obj.getType();
+    payload.version = mp_obj.getVersion();
+
+    // the few fields CMPTransaction has no getter for are read where interpret_Transaction read them
+    auto readBE64 = [&](size_t offset) { return pkt.size() >= offset + 8 ? ReadBE64(pkt.data() + offset) : 0; };
+
+    switch (payload.type) {
+    case MSC_TYPE_SIMPLE_SEND:
+    case MSC_TYPE_SEND_TO_OWNERS:
+    case MSC_TYPE_ACCEPT_OFFER_BTC:
+    case MSC_TYPE_CLOSE_CROWDSALE:
+    case MSC_TYPE_GRANT_PROPERTY_TOKENS:
+    case MSC_TYPE_REVOKE_PROPERTY_TOKENS:
+    case MSC_TYPE_CHANGE_ISSUER_ADDRESS:
+    case MSC_TYPE_ENABLE_FREEZING:
+    case MSC_TYPE_DISABLE_FREEZING:
+    case MSC_TYPE_ADD_DELEGATE:
+    case MSC_TYPE_REMOVE_DELEGATE:
+    case MSC_TYPE_FREEZE_PROPERTY_TOKENS:
+    case MSC_TYPE_UNFREEZE_PROPERTY_TOKENS: {
+        PayloadTokens& tokens = payload.tokens;
+        tokens.property = mp_obj.getProperty();
+        tokens.amount = mp_obj.getAmount();
+        uint32_t properties[2];
+        if (payload.type == MSC_TYPE_SEND_TO_OWNERS && GetPayloadProperties(pkt, properties) == 2) {
+            tokens.distribution_property = properties[1];
+        }
+        if (payload.type == MSC_TYPE_FREEZE_PROPERTY_TOKENS || payload.type == MSC_TYPE_UNFREEZE_PROPERTY_TOKENS) {
+            // the frozen address is part of the payload, not an output; getReceiver() has it
+            // encoded for the network of Init, which needn't be the chain of this context
+            CScript script;
+            if (pkt.size() >= 37 && state.DecodePayloadAddress(pkt.subspan(16, 21), script)) {
+                setOmniAddress(tokens.address, script);
+            }
+        }
+        break;
+    }
+    case MSC_TYPE_SEND_ALL:
+        payload.send_all.ecosystem = mp_obj.getEcosystem();
+        break;
+    case MSC_TYPE_SEND_NONFUNGIBLE:
+    case MSC_TYPE_NONFUNGIBLE_DATA: {
+        // property, first and last token, then for the data the issuer flag and the string
+        PayloadNonFungible& nonfungible = payload.nonfungible;
+        nonfungible.property = mp_obj.getProperty();
+        nonfungible.token_start = readBE64(8);
+        nonfungible.token_end = readBE64(16);
+        if (payload.type == MSC_TYPE_NONFUNGIBLE_DATA && pkt.size() > 24) {
+            nonfungible.issuer_data = pkt[24] != 0;
+            auto begin = pkt.begin() + 25;
+            setPayloadString(nonfungible.data, std::string(begin, std::find(begin, pkt.end(), 0)));
+        }
+        break;
+    }
+    case MSC_TYPE_SEND_TO_MANY: {
+        // property, number of outputs, then vout and amount of each
+        PayloadSendToMany& sendToMany = payload.send_to_many;
+        sendToMany.property = mp_obj.getProperty();
+        unsigned int count = pkt.size() > 8 ? pkt[8] : 0;
+        for (unsigned int i = 0; i < count && pkt.size() >= 9 + 9 * (i + 1); ++i) {
+            sendToMany.vout[i] = pkt[9 + 9 * i];
+            sendToMany.amount[i] = ReadBE64(pkt.data() + 10 + 9 * i);
+            sendToMany.count = i + 1;
+        }
+        break;
+    }
+    case MSC_TYPE_TRADE_OFFER: {
+        CMPOffer offer(mp_obj);
+        PayloadDexOffer& dexOffer = payload.dex_offer;
+        dexOffer.property = mp_obj.getProperty();
+        dexOffer.amount = mp_obj.getAmount();
+        dexOffer.amount_desired = offer.getBTCDesiredOriginal();
+        dexOffer.min_fee = offer.getMinFee();
+        dexOffer.block_time_limit = offer.getBlockTimeLimit();
+        dexOffer.subaction = offer.getSubaction();
+        break;
     }
+    case MSC_TYPE_METADEX_TRADE:
+    case MSC_TYPE_METADEX_CANCEL_PRICE:
+    case MSC_TYPE_METADEX_CANCEL_PAIR: {
+        CMPMetaDEx order(mp_obj);
+        PayloadMetaDex& metadex = payload.metadex;
+        metadex.property = mp_obj.getProperty();
+        metadex.amount = order.getAmountForSale();
+        metadex.property_desired = order.getDesProperty();
+        metadex.amount_desired = order.getAmountDesired();
+        break;
+    }
+    case MSC_TYPE_METADEX_CANCEL_ECOSYSTEM:
+        payload.metadex.ecosystem = mp_obj.getEcosystem();
+        break;
+    case MSC_TYPE_CREATE_PROPERTY_FIXED:
+    case MSC_TYPE_CREATE_PROPERTY_VARIABLE:
+    case MSC_TYPE_CREATE_PROPERTY_MANUAL: {
+        PayloadCreateProperty& create = payload.create_property;
+        create.ecosystem = mp_obj.getEcosystem();
+        create.property_type = mp_obj.getPropertyType();
+        create.previous_property = mp_obj.getPreviousId();
+        setPayloadString(create.category, mp_obj.getSPCategory());
+        setPayloadString(create.subcategory, mp_obj.getSPSubCategory());
+        setPayloadString(create.name, mp_obj.getSPName());
+        setPayloadString(create.url, mp_obj.getSPUrl());
+        setPayloadString(create.data, mp_obj.getSPData());
+        if (payload.type != MSC_TYPE_CREATE_PROPERTY_MANUAL) {
+            create.amount = mp_obj.getAmount();
+        }
+        if (payload.type == MSC_TYPE_CREATE_PROPERTY_VARIABLE) {
+            // the crowdsale keeps the property it accepts in the property of the tx
+            create.property_desired = mp_obj.getProperty();
+            create.deadline = mp_obj.getDeadline();
+            create.early_bird_bonus = mp_obj.getEarlyBirdBonus();
+            create.issuer_percentage = mp_obj.getIssuerBonus();
+        }
+        break;
+    }
+    case MSC_TYPE_ANYDATA: {
+        size_t size = pkt.size() > 4 ? std::min(pkt.size() - 4, PAYLOAD_STRING_SIZE) : 0;
+        if (size) memcpy(payload.any_data.data, pkt.data() + 4, size);
+        payload.any_data.size = size;
+        break;
+    }
+    case OMNICORE_MESSAGE_TYPE_ACTIVATION:
+    case OMNICORE_MESSAGE_TYPE_DEACTIVATION:
+        payload.activation.feature_id = mp_obj.getFeatureId();
+        payload.activation.activation_block = mp_obj.getActivationBlock();
+        payload.activation.min_client_version = mp_obj.getMinClientVersion();
+        break;
+    case OMNICORE_MESSAGE_TYPE_ALERT:
+        payload.alert.alert_type = mp_obj.getAlertType();
+        payload.alert.expiry = mp_obj.getAlertExpiry();
+        setPayloadString(payload.alert.message, mp_obj.getAlertMessage());
+        break;
+    default:
+        break;
+    }
+}
 
-    CCoinsViewCacheOnly view;
+// payload is filled as well unless it is null
+static int parseTxView(const ParserState& state, StageTimer& timer, ParseBuffers& buffers, const CCoinsView& view, const CTransaction& tx, unsigned int height, unsigned int idx, unsigned int time, OmniTxRecord& record, OmniPayload* payload = nullptr)
+{
     CMPTransaction mp_obj;
-    int parseRC = parseTx(true, view, CTransaction(tx), rawTx.height, rawTx.idx, mp_obj, rawTx.time, rawTx.vin);
+    int parseRC = parseTx(state, timer, buffers, true, view, tx, height, idx, mp_obj, time);
     if (parseRC < 0) {
-        if (msc_debug_verbose) PrintToLog("parse Tx failed with code: %d", parseRC);
+        PARSER_TRACE(state, verbose, "parse Tx failed with code: %d", parseRC);
+        return parseRC;
+    }
+
+    timer.Skip();
+    bool interpreted = mp_obj.interpret_Transaction();
+    timer.Lap(STAGE_INTERPRET);
+    if (!interpreted) {
+        PARSER_TRACE(state, verbose, "interpret omniTx failed");
+        return PARSE_ERR_INTERPRET;
+    }
+
+    memcpy(record.txid, mp_obj.getHash().begin(), sizeof(record.txid));
+    record.fee = mp_obj.getFeePaid();
+    record.amount = mp_obj.getNewAmount();
+    record.propertyid = mp_obj.getProperty();
+    record.type_int = mp_obj.getType();
+    record.version = mp_obj.getVersion();
+
+    // parseTx left the input of the sender and the output of the reference in the buffers
+    if (buffers.senderVin >= 0) {
+        setOmniAddress(record.sendingaddress, buffers.coins[buffers.senderVin].out.scriptPubKey);
+    }
+    if (showRefForTx(mp_obj.getType()) && buffers.referenceVout >= 0) {
+        setOmniAddress(record.referenceaddress, tx.vout[buffers.referenceVout].scriptPubKey);
+    }
+    if (payload) {
+        fillOmniPayload(state, mp_obj, Span<const unsigned char>(buffers.packet.data(), buffers.packetSize), *payload);
+    }
+
+    return PARSE_OK;
+}
+
+// the tx has to have passed the pre-filter already, and buffers.prevouts to hold the prevouts of the input
+static int parseCandidateTx(const ParserState& state, StageTimer& timer, ParseBuffers& buffers, Span<const unsigned char> txBytes, unsigned int height, unsigned int idx, unsigned int time, OmniTxRecord& record, OmniPayload* payload = nullptr)
+{
+    timer.Skip();
+    bool decoded = DecodeTxInto(txBytes, buffers.tx);
+    timer.Lap(STAGE_DECODE);
+    if (!decoded) {
+        PARSER_TRACE(state, verbose, "decode tx failed: %s", HexStr(txBytes));
+        return PARSE_ERR_DECODE;
+    }
+
+    // CTransaction owns its inputs and outputs: moved, the next decode allocates them again,
+    // copied, the copy would, so an Omni candidate costs one allocation of each either way
+    return parseTxView(state, timer, buffers, buffers.prevouts, CTransaction(std::move(buffers.tx)), height, idx, time, record, payload);
+}
+
+// runs parse(timer) and counts the outcome in the context's metrics
+template <typename Fn>
+static int measuredParse(const ParserState& state, OmniTxRecord& record, Fn parse)
+{
+    StageTimer timer(state.Metrics());
+    int status = parse(timer);
+    timer.Finish(status, record.type_int);
+    return status;
+}
+
+// runs parse() unless the result cache holds the tx, whose prevouts are in buffers.prevouts, for the rules at height;
+// the cache only holds records, a parse for the payload too always runs
+// the key is the hash of the tx bytes (the wtxid for a segwit tx), never a txid the caller declared
+template <typename Fn>
+static int cachedParse(const ParserState& state, ParseBuffers& buffers, Span<const unsigned char> txBytes, unsigned int height, OmniTxRecord& record, const OmniPayload* payload, Fn parse)
+{
+    ParseCache& cache = state.Results();
+    if (!cache.Enabled() || payload) return parse();
+
+    uint256 txid = Hash(txBytes);
+    ParseCache::Key key{txid, buffers.prevouts.Digest()};
+    int epoch = state.RulesEpoch(height);
+    if (cache.Lookup(key, epoch, record)) {
+        PARSER_TRACE(state, verbose, "cached result %d for %s", record.status, txid.GetHex());
+        return record.status;
+    }
+    int status = parse();
+    if (status != -101) { // missing prevouts may turn up later
+        record.status = status;
+        cache.Insert(key, epoch, record);
+    }
+    return status;
+}
+
+// decodes hexTx into buffers.txBytes and parses it through the result cache
+static int parseCandidateHex(const ParserState& state, StageTimer& timer, ParseBuffers& buffers, std::string_view hexTx, unsigned int height, unsigned int idx, unsigned int time, OmniTxRecord& record, OmniPayload* payload = nullptr)
+{
+    timer.Skip();
+    if (!DecodeHexInto(hexTx, buffers.txBytes)) {
+        timer.Lap(STAGE_DECODE);
+        PARSER_TRACE(state, verbose, "decode hexTx failed: %s", hexTx);
+        return PARSE_ERR_DECODE;
+    }
+    return cachedParse(state, buffers, buffers.txBytes, height, record, payload, [&] {
+        return parseCandidateTx(state, timer, buffers, buffers.txBytes, height, idx, time, record, payload);
+    });
+}
+
+static int parseRawTx(const ParserState& state, ParseBuffers& buffers, const RawTx& rawTx, OmniTxRecord& record)
+{
+    return measuredParse(state, record, [&](StageTimer& timer) {
+        if (!state.Prefilter().CheckHex(rawTx.hex)) {
+            return -1; // same as parseTx: no Exodus/Omni marker
+        }
+
+        buffers.prevouts.Reset(state.CoinsBase());
+        for (const Vin& vin : rawTx.vin) {
+            if (!buffers.prevouts.Add(vin.txid, vin.vout, vin.prevout.value, vin.prevout.height, vin.prevout.scriptPubKey.hex)) {
+                PARSER_TRACE(state, verbose, "invalid prevout %s:%d", vin.txid, vin.vout);
+                return PARSE_ERR_INPUT;
+            }
+        }
+        return parseCandidateHex(state, timer, buffers, rawTx.hex, rawTx.height, rawTx.idx, rawTx.time, record);
+    });
+}
+
+static int parseRawTxJson(const ParserState& state, ParseBuffers& buffers, std::string_view json, OmniTxRecord& record, OmniPayload* payload = nullptr)
+{
+    return measuredParse(state, record, [&](StageTimer& timer) {
+        RawTxView& view = buffers.json;
+        std::string error;
+        if (!ReadRawTx(json, view, error)) {
+            PARSER_TRACE(state, verbose, "read RawTx failed: %s", error);
+            return PARSE_ERR_INPUT;
+        }
+
+        if (!state.Prefilter().CheckHex(view.hex)) {
+            return -1;
+        }
+
+        buffers.prevouts.Reset(state.CoinsBase());
+        for (const VinView& vin : view.vin) {
+            if (!buffers.prevouts.Add(vin.txid, vin.vout, vin.value, vin.height, vin.scriptPubKeyHex)) {
+                PARSER_TRACE(state, verbose, "invalid prevout %s:%d", vin.txid, vin.vout);
+                return PARSE_ERR_INPUT;
+            }
+        }
+        return parseCandidateHex(state, timer, buffers, view.hex, view.height, view.idx, view.time, record, payload);
+    });
+}
+
+static int parseRawTxBin(const ParserState& state, ParseBuffers& buffers, Span<const unsigned char> data, OmniTxRecord& record, OmniPayload* payload = nullptr)
+{
+    return measuredParse(state, record, [&](StageTimer& timer) {
+        RawTxBinView& rawTx = buffers.bin;
+        std::string error;
+        if (!ReadRawTxBin(data, rawTx, error)) {
+            PARSER_TRACE(state, verbose, "read binary RawTx failed: %s", error);
+            return PARSE_ERR_INPUT;
+        }
+
+        if (!state.Prefilter().Check(rawTx.tx)) {
+            return -1;
+        }
+
+        buffers.prevouts.Reset(state.CoinsBase());
+        for (const PrevoutView& prevout : rawTx.prevouts) {
+            buffers.prevouts.Add(prevout.txid, prevout.vout, prevout.value, prevout.height, prevout.scriptPubKey);
+        }
+        return cachedParse(state, buffers, rawTx.tx, rawTx.height, record, payload, [&] {
+            return parseCandidateTx(state, timer, buffers, rawTx.tx, rawTx.height, rawTx.idx, rawTx.time, record, payload);
+        });
+    });
+}
+
+//! Buffers of the calls that don't come with an OmniParser
+static ParseBuffers& threadBuffers()
+{
+    thread_local ParseBuffers buffers;
+    return buffers;
+}
+
+std::string FormatOmniTxid(const OmniTxRecord& record)
+{
+    std::string txid(2 * sizeof(record.txid), '\0');
+    EncodeHashHex(record.txid, txid.data());
+    return txid;
+}
+
+std::string FormatOmniFee(const OmniTxRecord& record)
+{
+    return FormatDivisibleMP(record.fee);
+}
+
+std::string FormatOmniType(const OmniTxRecord& record)
+{
+    return strTransactionType(record.type_int);
+}
+
+// strAddress keeps its capacity, it is left empty for no address
+static void formatOmniAddress(const ParserState& state, const OmniAddress& address, std::string& strAddress)
+{
+    strAddress.clear();
+    Span<const unsigned char> script(address.script, address.size);
+    state.Addresses().Get(state.ChainId(), AddressCache::OMNI, script, strAddress, [&](std::string& encoded) {
+        CTxDestination dest;
+        if (!ExtractDestination(CScript(script.begin(), script.end()), dest)) return false;
+        encoded = TryEncodeOmniAddress(state.EncodeDestination(dest));
+        return true;
+    });
+}
+
+static std::string formatOmniAddress(const ParserState& state, const OmniAddress& address)
+{
+    std::string strAddress;
+    formatOmniAddress(state, address, strAddress);
+    return strAddress;
+}
+
+std::string FormatOmniAddress(const OmniAddress& address)
+{
+    return default_context->FormatOmniAddress(address);
+}
+
+std::string ParserContext::FormatOmniAddress(const OmniAddress& address) const
+{
+    return formatOmniAddress(*m_state, address);
+}
+
+// assigns into the strings of txOmni, so a reused OmniTx only allocates for longer text than before
+static void fillOmniTx(const ParserState& state, const OmniTxRecord& record, OmniTx& txOmni)
+{
+    txOmni.txid.resize(2 * sizeof(record.txid));
+    EncodeHashHex(record.txid, txOmni.txid.data());
+    txOmni.fee.assign(FormatOmniFee(record));
+    formatOmniAddress(state, record.sendingaddress, txOmni.sendingaddress);
+    formatOmniAddress(state, record.referenceaddress, txOmni.referenceaddress);
+    txOmni.version = record.version;
+    txOmni.type_int = record.type_int;
+    txOmni.type.assign(FormatOmniType(record));
+    txOmni.amount = record.amount;
+    txOmni.propertyid = record.propertyid;
+
+    PARSER_TRACE(state, verbose, "parse Tx success: %s", txOmni.dumps());
+}
+
+// formats all text fields at once, the record stays the cheap representation
+static std::unique_ptr<OmniTx> toOmniTx(const ParserState& state, int status, const OmniTxRecord& record)
+{
+    if (status != PARSE_OK) return nullptr;
+
+    auto txOmni = std::make_unique<OmniTx>();
+    fillOmniTx(state, record, *txOmni);
+    return txOmni;
+}
+
+std::unique_ptr<OmniTx> ParserContext::ParseTx(const RawTx& rawTx) const
+{
+    OmniTxRecord record{};
+    int status = parseRawTx(*m_state, threadBuffers(), rawTx, record);
+    return toOmniTx(*m_state, status, record);
+}
+
+std::unique_ptr<OmniTx> ParserContext::ParseTxJson(const char* json, size_t len) const
+{
+    OmniTxRecord record{};
+    int status = parseRawTxJson(*m_state, threadBuffers(), std::string_view(json, len), record);
+    return toOmniTx(*m_state, status, record);
+}
+
+std::unique_ptr<OmniTx> ParserContext::ParseTxBin(const unsigned char* data, size_t len) const
+{
+    OmniTxRecord record{};
+    int status = parseRawTxBin(*m_state, threadBuffers(), Span<const unsigned char>(data, len), record);
+    return toOmniTx(*m_state, status, record);
+}
+
+int ParserContext::ParseTxRecord(const char* json, size_t len, OmniTxRecord* record) const
+{
+    *record = OmniTxRecord{};
+    record->status = parseRawTxJson(*m_state, threadBuffers(), std::string_view(json, len), *record);
+    return record->status;
+}
+
+int ParserContext::ParseTxBinRecord(const unsigned char* data, size_t len, OmniTxRecord* record) const
+{
+    *record = OmniTxRecord{};
+    record->status = parseRawTxBin(*m_state, threadBuffers(), Span<const unsigned char>(data, len), *record);
+    return record->status;
+}
+
+int ParserContext::ParseTxPayload(const char* json, size_t len, OmniTxRecord* record, OmniPayload* payload) const
+{
+    *record = OmniTxRecord{};
+    *payload = OmniPayload{};
+    record->status = parseRawTxJson(*m_state, threadBuffers(), std::string_view(json, len), *record, payload);
+    return record->status;
+}
+
+int ParserContext::ParseTxBinPayload(const unsigned char* data, size_t len, OmniTxRecord* record, OmniPayload* payload) const
+{
+    *record = OmniTxRecord{};
+    *payload = OmniPayload{};
+    record->status = parseRawTxBin(*m_state, threadBuffers(), Span<const unsigned char>(data, len), *record, payload);
+    return record->status;
+}
+
+std::unique_ptr<OmniTx> ParseTx(const RawTx& rawTx)
+{
+    return default_context->ParseTx(rawTx);
+}
+
+std::unique_ptr<OmniTx> ParseTx(Span<const unsigned char> rawTxBin)
+{
+    return default_context->ParseTxBin(rawTxBin.data(), rawTxBin.size());
+}
+
+std::unique_ptr<OmniTx> ParseTxBin(const unsigned char* data, size_t len)
+{
+    return default_context->ParseTxBin(data, len);
+}
+
+std::unique_ptr<OmniTx> ParseTxJson(const char* json, size_t len)
+{
+    return default_context->ParseTxJson(json, len);
+}
+
+int ParseTxRecord(const char* json, size_t len, OmniTxRecord* record)
+{
+    return default_context->ParseTxRecord(json, len, record);
+}
+
+int ParseTxBinRecord(const unsigned char* data, size_t len, OmniTxRecord* record)
+{
+    return default_context->ParseTxBinRecord(data, len, record);
+}
+
+int ParseTxPayload(const char* json, size_t len, OmniTxRecord* record, OmniPayload* payload)
+{
+    return default_context->ParseTxPayload(json, len, record, payload);
+}
+
+int ParseTxBinPayload(const unsigned char* data, size_t len, OmniTxRecord* record, OmniPayload* payload)
+{
+    return default_context->ParseTxBinPayload(data, len, record, payload);
+}
+
+OmniParser::OmniParser(const ParserContext& context) : m_state(*context.m_state), m_buffers(std::make_unique<ParseBuffers>()) {}
+
+OmniParser::OmniParser() : OmniParser(*default_context) {}
+
+OmniParser::~OmniParser() = default;
+
+int OmniParser::Parse(const char* json, size_t len, OmniTxRecord* record)
+{
+    *record = OmniTxRecord{};
+    record->status = parseRawTxJson(m_state, *m_buffers, std::string_view(json, len), *record);
+    return record->status;
+}
+
+int OmniParser::ParseBin(const unsigned char* data, size_t len, OmniTxRecord* record)
+{
+    *record = OmniTxRecord{};
+    record->status = parseRawTxBin(m_state, *m_buffers, Span<const unsigned char>(data, len), *record);
+    return record->status;
+}
+
+int OmniParser::ParsePayload(const char* json, size_t len, OmniTxRecord* record, OmniPayload* payload)
+{
+    *record = OmniTxRecord{};
+    *payload = OmniPayload{};
+    record->status = parseRawTxJson(m_state, *m_buffers, std::string_view(json, len), *record, payload);
+    return record->status;
+}
+
+int OmniParser::ParseTx(const char* json, size_t len, OmniTx& tx)
+{
+    OmniTxRecord record;
+    int status = Parse(json, len, &record);
+    if (status == PARSE_OK) fillOmniTx(m_state, record, tx);
+    return status;
+}
+
+void ParserContext::SetAddressCacheSize(size_t entries) const
+{
+    m_state->Addresses().SetCapacity(entries);
+}
+
+AddressCacheStats ParserContext::GetAddressCacheStats() const
+{
+    AddressCache::Stats stats = m_state->Addresses().GetStats();
+    return AddressCacheStats{stats.hits, stats.misses, stats.evictions, stats.size};
+}
+
+void ParserContext::SetParseCacheSize(size_t entries) const
+{
+    m_state->Results().SetCapacity(entries);
+}
+
+ParseCacheStats ParserContext::GetParseCacheStats() const
+{
+    return m_state->Results().GetStats();
+}
+
+void SetParseCacheSize(size_t entries)
+{
+    default_context->SetParseCacheSize(entries);
+}
+
+ParseCacheStats GetParseCacheStats()
+{
+    return default_context->GetParseCacheStats();
+}
+
+void SetAddressCacheSize(size_t entries)
+{
+    default_context->SetAddressCacheSize(entries);
+}
+
+AddressCacheStats GetAddressCacheStats()
+{
+    return default_context->GetAddressCacheStats();
+}
+
+ParserMetrics ParserContext::GetMetrics() const
+{
+    ParserMetrics metrics;
+    m_state->Metrics().Snapshot(metrics);
+    return metrics;
+}
+
+ParserMetrics GetParserMetrics()
+{
+    return default_context->GetMetrics();
+}
+
+void SetParseThreads(unsigned int threads)
+{
+    std::lock_guard<std::mutex> lock(parse_pool_mutex);
+    if (threads == parse_pool_threads) return;
+    parse_pool.reset();
+    parse_pool_threads = threads;
+}
+
+// the calling thread works along, so the pool holds one thread less than requested
+static std::shared_ptr<WorkerPool> getParsePool()
+{
+    std::lock_guard<std::mutex> lock(parse_pool_mutex);
+    if (!parse_pool) {
+        unsigned int threads = parse_pool_threads;
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        parse_pool = std::make_shared<WorkerPool>(threads - 1);
+    }
+    return parse_pool;
+}
+
+std::vector<ParsedTx> ParserContext::ParseTxs(Span<const RawTx> rawTxs) const
+{
+    std::vector<ParsedTx> results(rawTxs.size());
+    ParallelFor(*getParsePool(), rawTxs.size(), [&](size_t i) {
+        OmniTxRecord record{};
+        results[i].status = parseRawTx(*m_state, threadBuffers(), rawTxs[i], record);
+        results[i].tx = toOmniTx(*m_state, results[i].status, record);
+    });
+    return results;
+}
+
+std::unique_ptr<ParsedTxBatch> ParserContext::ParseTxBatch(const RawTxBatch& batch) const
+{
+    auto parsed = std::make_unique<ParsedTxBatch>();
+    parsed->results.resize(batch.items.size());
+    ParallelFor(*getParsePool(), batch.items.size(), [&](size_t i) {
+        OmniTxRecord record{};
+        ParsedTx& result = parsed->results[i];
+        result.status = parseRawTxJson(*m_state, threadBuffers(), batch.items[i], record);
+        result.tx = toOmniTx(*m_state, result.status, record);
+    });
+    return parsed;
+}
+
+void ParserContext::ParseTxRecords(const RawTxBatch& batch, OmniTxRecord* records) const
+{
+    ParallelFor(*getParsePool(), batch.items.size(), [&](size_t i) {
+        records[i] = OmniTxRecord{};
+        records[i].status = parseRawTxJson(*m_state, threadBuffers(), batch.items[i], records[i]);
+    });
+}
+
+// applies the Omni txs of a block to the balance engine, their addresses formatted through the cache
+static void applyBalances(const ParserState& state, BalanceEngine& balances, int height, int64_t time, const std::vector<OmniTxRecord>& records, const std::vector<OmniPayload>& payloads)
+{
+    std::vector<BalanceTx> txs(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        txs[i].payload = &payloads[i];
+        formatOmniAddress(state, records[i].sendingaddress, txs[i].sender);
+        formatOmniAddress(state, records[i].referenceaddress, txs[i].receiver);
+    }
+    balances.ApplyBlock(height, time, txs);
+}
+
+std::unique_ptr<ParsedTxBatch> ParserContext::ParseBlock(const RawBlock& rawBlock) const
+{
+    if (!rawBlock.error.empty()) {
+        PARSER_TRACE(*m_state, verbose, "%s", rawBlock.error);
+        return nullptr;
+    }
+    CBlock block;
+    std::vector<unsigned char> blockBytes;
+    if (!DecodeHexInto(rawBlock.hex, blockBytes) || !DecodeBlockInto(blockBytes, block)) {
+        PARSER_TRACE(*m_state, verbose, "decode hexBlock failed at height %d", rawBlock.height);
         return nullptr;
     }
 
-    if (!mp_obj.interpret_Transaction()) {
-        if (msc_debug_verbose) PrintToLog("interpret omniTx failed");
+    // one view for the whole block, so txs spending earlier outputs of the block find their inputs
+    CCoinsViewCache view(&m_state->CoinsBase());
+    if (!fillTxInputCache(view, rawBlock.vin)) {
+        PARSER_TRACE(*m_state, verbose, "invalid prevouts of the block at height %d", rawBlock.height);
         return nullptr;
     }
 
-    auto txOmni = new OmniTx();
-    txOmni->txid = mp_obj.getHash().GetHex();
-    txOmni->fee = FormatDivisibleMP(mp_obj.getFeePaid());
-    txOmni->sendingaddress = TryEncodeOmniAddress(mp_obj.getSender());
-    txOmni->version = mp_obj.getVersion();
-    txOmni->type_int = mp_obj.getType();
-    txOmni->type = mp_obj.getTypeString();
-    txOmni->amount = mp_obj.getNewAmount();
-    txOmni->propertyid = mp_obj.getProperty();
-    if (showRefForTx(mp_obj.getType()))
-        txOmni->referenceaddress = TryEncodeOmniAddress(mp_obj.getReceiver());
-
-    if (msc_debug_verbose) PrintToLog("parse Tx success: %s", txOmni->dumps());
-    return std::unique_ptr<OmniTx>(txOmni);
+    // with balances, the records and payloads of the Omni txs are kept for them
+    BalanceEngine* balances = m_state->Balances();
+    std::vector<OmniTxRecord> records;
+    std::vector<OmniPayload> payloads;
+
+    auto parsed = std::make_unique<ParsedTxBatch>();
+    for (unsigned int idx = 0; idx < block.vtx.size(); ++idx) {
+        const CTransaction& tx = *block.vtx[idx];
+        if (!tx.IsCoinBase()) {
+            // the block is decoded as a whole, its txs have no decode stage
+            OmniTxRecord record{};
+            OmniPayload* payload = balances ? &payloads.emplace_back() : nullptr;
+            int status = measuredParse(*m_state, record, [&](StageTimer& timer) {
+                return parseTxView(*m_state, timer, threadBuffers(), view, tx, rawBlock.height, idx, block.nTime, record, payload);
+            });
+            if (status == PARSE_OK) {
+                parsed->results.push_back({PARSE_OK, toOmniTx(*m_state, PARSE_OK, record)});
+                if (balances) records.push_back(record);
+            } else if (balances) {
+                payloads.pop_back();
+            }
+        }
+        addTxOutputs(view, tx, rawBlock.height);
+    }
+    if (PrevoutStore* prevouts = m_state->Prevouts()) {
+        prevouts->ConnectBlock(block, rawBlock.height);
+    }
+    if (balances) {
+        applyBalances(*m_state, *balances, rawBlock.height, block.nTime, records, payloads);
+    }
+    return parsed;
+}
+
+//! A tx the pre-filter let through in the block files
+struct BlockCandidate {
+    unsigned int idx;
+    TxLayout layout;
+};
+
+//! Txids the candidates spend from, with where the tx is: height << 32 | offset in the block, 0 until found
+using BlockTxIndex = std::unordered_map<uint256, std::atomic<uint64_t>, SaltedTxidHasher>;
+
+// adds the output if its tx is in the files, otherwise the context's prevout store may have it
+static void addFilePrevout(const BlockFiles& files, const BlockTxIndex& index, const COutPoint& outpoint, TxPrevouts& prevouts)
+{
+    auto found = index.find(outpoint.hash);
+    if (found == index.end()) return;
+    uint64_t pos = found->second.load(std::memory_order_relaxed);
+    if (!pos) return;
+
+    uint32_t height = pos >> 32;
+    size_t offset = pos & 0xffffffff;
+    Span<const unsigned char> block = files.Block(files.Chain()[height]);
+    TxLayout layout;
+    CAmount value;
+    Span<const unsigned char> script;
+    if (ScanTx(block, offset, layout) && GetTxOut(block, layout, outpoint.n, value, script)) {
+        prevouts.Add(outpoint.hash, outpoint.n, value, height, script);
+    }
+}
+
+bool ParserContext::ParseBlockFiles(const std::string& blocksDir, int fromHeight, int toHeight, const BlockRecordsFn& emit, std::string& error) const
+{
+    BlockFiles files;
+    if (!files.Open(fs::PathFromString(blocksDir), m_state->Params(), error)) return false;
+    const std::vector<BlockPos>& chain = files.Chain();
+    int tip = chain.size() - 1;
+    if (toHeight < 0 || toHeight > tip) toHeight = tip;
+    fromHeight = std::max(fromHeight, 0);
+    if (fromHeight > toHeight) return true;
+
+    std::shared_ptr<WorkerPool> pool = getParsePool();
+    std::atomic<int> badHeight{-1};
+    // calls fn(layout, idx) for every tx of the block, false if the block is cut short
+    auto forEachTx = [&](int height, Span<const unsigned char> block, auto fn) {
+        size_t pos;
+        uint64_t count;
+        TxLayout layout;
+        bool complete = BlockTxs(block, pos, count);
+        for (uint64_t idx = 0; complete && idx < count; ++idx) {
+            complete = ScanTx(block, pos, layout);
+            if (complete) fn(layout, idx);
+        }
+        if (!complete) badHeight = height;
+    };
+    auto cutShort = [&] {
+        if (badHeight < 0) return false;
+        error = strprintf("block %d in the block files is cut short", badHeight.load());
+        return true;
+    };
+
+    // the pre-filter runs on the tx bytes in the mapping, only candidates go on
+    size_t blocks = toHeight - fromHeight + 1;
+    std::vector<std::vector<BlockCandidate>> candidates(blocks);
+    ParallelFor(*pool, blocks, [&](size_t i) {
+        Span<const unsigned char> block = files.Block(chain[fromHeight + i]);
+        forEachTx(fromHeight + i, block, [&](const TxLayout& layout, uint64_t idx) {
+            if (idx > 0 && m_state->Prefilter().Check(layout.Bytes(block))) {
+                candidates[i].push_back({static_cast<unsigned int>(idx), layout});
+            }
+        });
+    });
+    if (cutShort()) return false;
+
+    // one hashing pass over the chain up to the last candidate finds the txs they spend from
+    BlockTxIndex index;
+    std::vector<COutPoint> outpoints;
+    int lastHeight = -1;
+    for (size_t i = 0; i < blocks; ++i) {
+        Span<const unsigned char> block = files.Block(chain[fromHeight + i]);
+        for (const BlockCandidate& candidate : candidates[i]) {
+            outpoints.clear();
+            GetTxPrevouts(block, candidate.layout, outpoints);
+            for (const COutPoint& outpoint : outpoints) {
+                index.try_emplace(outpoint.hash, 0);
+            }
+            lastHeight = fromHeight + i;
+        }
+    }
+    ParallelFor(*pool, lastHeight + 1, [&](size_t height) {
+        Span<const unsigned char> block = files.Block(chain[height]);
+        forEachTx(height, block, [&](const TxLayout& layout, uint64_t) {
+            auto found = index.find(layout.Txid(block));
+            if (found != index.end()) found->second.store(static_cast<uint64_t>(height) << 32 | layout.begin, std::memory_order_relaxed);
+        });
+    });
+    if (cutShort()) return false;
+
+    // parse window by window, each emitted in order before the next
+    constexpr size_t WINDOW = 1024;
+    std::vector<std::vector<OmniTxRecord>> results(std::min(WINDOW, blocks));
+    // with balances, the payloads of the records too, for every block to be applied in order
+    BalanceEngine* balances = m_state->Balances();
+    std::vector<std::vector<OmniPayload>> payloads(balances ? results.size() : 0);
+    for (size_t first = 0; first < blocks; first += WINDOW) {
+        size_t count = std::min(WINDOW, blocks - first);
+        ParallelFor(*pool, count, [&](size_t i) {
+            std::vector<OmniTxRecord>& records = results[i];
+            records.clear();
+            if (balances) payloads[i].clear();
+            int height = fromHeight + first + i;
+            Span<const unsigned char> block = files.Block(chain[height]);
+            ParseBuffers& buffers = threadBuffers();
+            std::vector<COutPoint> spent;
+            for (const BlockCandidate& candidate : candidates[first + i]) {
+                buffers.prevouts.Reset(m_state->CoinsBase());
+                spent.clear();
+                GetTxPrevouts(block, candidate.layout, spent);
+                for (const COutPoint& outpoint : spent) {
+                    addFilePrevout(files, index, outpoint, buffers.prevouts);
+                }
+                OmniTxRecord record{};
+                OmniPayload* payload = balances ? &payloads[i].emplace_back() : nullptr;
+                int status = measuredParse(*m_state, record, [&](StageTimer& timer) {
+                    return parseCandidateTx(*m_state, timer, buffers, candidate.layout.Bytes(block), height, candidate.idx, BlockTime(block), record, payload);
+                });
+                if (status == PARSE_OK) {
+                    records.push_back(record);
+                } else if (balances) {
+                    payloads[i].pop_back();
+                }
+            }
+        });
+        for (size_t i = 0; i < count; ++i) {
+            int height = fromHeight + first + i;
+            if (balances) applyBalances(*m_state, *balances, height, BlockTime(files.Block(chain[height])), results[i], payloads[i]);
+            if (!results[i].empty()) emit(height, results[i]);
+        }
+    }
+    return true;
+}
+
+bool ParserContext::OpenPrevoutStore(const std::string& path, size_t cacheBytes)
+{
+    try {
+        m_state->SetPrevoutStore(std::make_unique<PrevoutStore>(fs::PathFromString(path), cacheBytes));
+    } catch (const std::exception& e) {
+        PrintToLog("%s() ERROR: can't open prevout store %s: %s\n", __func__, path, e.what());
+        return false;
+    }
+    return true;
+}
+
+int ParserContext::GetPrevoutStoreHeight() const
+{
+    PrevoutStore* prevouts = m_state->Prevouts();
+    return prevouts ? prevouts->Height() : -1;
+}
+
+bool ParserContext::OpenBalances(const std::string& checkpointPath, int checkpointInterval)
+{
+    if (!m_state->Watched().Empty()) {
+        PrintToLog("%s() ERROR: can't open balances: a watchlist filters Omni txs the balances need\n", __func__);
+        return false;
+    }
+    auto balances = std::make_unique<BalanceEngine>(*m_state, fs::PathFromString(checkpointPath), checkpointInterval);
+    std::string error;
+    if (!balances->Load(error)) {
+        PrintToLog("%s() ERROR: can't open balances: %s\n", __func__, error);
+        return false;
+    }
+    m_state->SetBalances(std::move(balances));
+    return true;
+}
+
+int ParserContext::GetBalancesHeight() const
+{
+    BalanceEngine* balances = m_state->Balances();
+    return balances ? balances->Height() : -1;
+}
+
+int64_t ParserContext::GetBalance(const std::string& address, uint32_t property) const
+{
+    BalanceEngine* balances = m_state->Balances();
+    return balances ? balances->GetBalance(address, property) : 0;
+}
+
+bool ParserContext::IsBalanceExact(uint32_t property) const
+{
+    BalanceEngine* balances = m_state->Balances();
+    return balances && balances->IsExact(property);
+}
+
+bool ParserContext::WriteBalancesCheckpoint() const
+{
+    BalanceEngine* balances = m_state->Balances();
+    std::string error;
+    if (!balances || !balances->Checkpoint(error)) {
+        PrintToLog("%s() ERROR: can't write the balance checkpoint: %s\n", __func__, balances ? error : "no balances");
+        return false;
+    }
+    return true;
+}
+
+bool ParseBlockFiles(const std::string& blocksDir, int fromHeight, int toHeight, const BlockRecordsFn& emit, std::string& error)
+{
+    return default_context->ParseBlockFiles(blocksDir, fromHeight, toHeight, emit, error);
+}
+
+bool ParserContext::WatchProperty(uint32_t property)
+{
+    // the balances have to see the txs a watchlist filters
+    if (m_state->Balances()) return false;
+    m_state->EditWatchlist().AddProperty(property);
+    return true;
+}
+
+bool ParserContext::WatchAddress(const std::string& address)
+{
+    CScript scriptPubKey;
+    if (m_state->Balances() || !m_state->DecodeAddress(address, scriptPubKey)) return false;
+    m_state->EditWatchlist().AddScript(scriptPubKey);
+    return true;
+}
+
+void ParserContext::ClearWatchlist()
+{
+    m_state->EditWatchlist().Clear();
+}
+
+bool WatchProperty(uint32_t property)
+{
+    return default_context->WatchProperty(property);
+}
+
+bool WatchAddress(const std::string& address)
+{
+    return default_context->WatchAddress(address);
+}
+
+void ClearWatchlist()
+{
+    default_context->ClearWatchlist();
+}
+
+bool OpenPrevoutStore(const std::string& path, size_t cacheBytes)
+{
+    return default_context->OpenPrevoutStore(path, cacheBytes);
+}
+
+int GetPrevoutStoreHeight()
+{
+    return default_context->GetPrevoutStoreHeight();
+}
+
+bool OpenBalances(const std::string& checkpointPath, int checkpointInterval)
+{
+    return default_context->OpenBalances(checkpointPath, checkpointInterval);
+}
+
+int GetBalancesHeight()
+{
+    return default_context->GetBalancesHeight();
+}
+
+int64_t GetBalance(const std::string& address, uint32_t property)
+{
+    return default_context->GetBalance(address, property);
+}
+
+bool IsBalanceExact(uint32_t property)
+{
+    return default_context->IsBalanceExact(property);
+}
+
+bool WriteBalancesCheckpoint()
+{
+    return default_context->WriteBalancesCheckpoint();
+}
+
+std::vector<ParsedTx> ParseTxs(Span<const RawTx> rawTxs)
+{
+    return default_context->ParseTxs(rawTxs);
+}
+
+std::unique_ptr<ParsedTxBatch> ParseTxBatch(const RawTxBatch& batch)
+{
+    return default_context->ParseTxBatch(batch);
+}
+
+void ParseTxRecords(const RawTxBatch& batch, OmniTxRecord* records)
+{
+    default_context->ParseTxRecords(batch, records);
+}
+
+std::unique_ptr<ParsedTxBatch> ParseBlock(const RawBlock& rawBlock)
+{
+    return default_context->ParseBlock(rawBlock);
 }
@@ -1,9 +1,14 @@
 #pragma once
 
 #include "chainparamsbase.h"
+#include "rawtx_json.h"
+#include "span.h"
 #include "univalue.h"
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 struct Vin {
     std::string txid;
@@ -26,28 +31,9 @@ struct RawTx {
     unsigned int time;
     unsigned int idx;
 
-    RawTx(std::string rawStr)
-    {
-        UniValue value(UniValue::VOBJ);
-        value.read(rawStr);
-
-        this->txid = value["txid"].get_str();
-        this->hex = value["hex"].get_str();
-        this->height = value["height"].getInt<unsigned int>();
-        this->time = value["time"].getInt<unsigned int>();
-        this->idx = value["idx"].getInt<unsigned int>();
-
-        for (auto v : value["vin"].getValues()) {
-            Vin vin;
-            vin.txid = v["txid"].get_str();
-            vin.vout = v["vout"].getInt<unsigned int>();
-            vin.prevout.value = v["prevout"]["value"].getInt<uint64_t>();
-            vin.prevout.height = v["prevout"]["height"].getInt<unsigned int>();
-            vin.prevout.scriptPubKey.hex = v["prevout"]["scriptPubKey"]["hex"].get_str();
-
-            this->vin.push_back(vin);
-        }
-    }
+    //! Reads the json with ReadRawTx, throws std::runtime_error if it is malformed
+    RawTx(const std::string& rawStr);
+    RawTx(const RawTxView& view);
 
     std::string dumps()
     {
@@ -82,6 +68,18 @@ struct RawTx {
     }
 };
 
+//! A serialized block and the prevouts its transactions spend from outside of the block
+struct RawBlock {
+    std::string hex;
+    // may be left out for prevouts the context's prevout store holds
+    std::vector<Vin> vin;
+    unsigned int height{0};
+    //! Why the json couldn't be read, empty if it could; ParseBlock refuses a block with an error
+    std::string error;
+
+    //! Reads the json with ReadRawBlock; doesn't throw, as it runs as a constructor of the bindings
+    RawBlock(const std::string& rawStr);
+};
 
 struct OmniTx {
     std::string txid;
@@ -148,5 +146,513 @@ struct OmniTx {
     }
 };
 
+//! Address of a sender or reference: the TxoutType and the standard scriptPubKey, hash or witness program included
+struct OmniAddress {
+    uint8_t type; // TxoutType, NONSTANDARD (0) with size 0 for no address
+    uint8_t size;
+    uint8_t script[42];
+};
+
+//! Parse result as plain data; text is only formatted when asked for, with the FormatOmni* functions
+struct OmniTxRecord {
+    uint8_t txid[32]; // serialization order, FormatOmniTxid gives the display hex
+    int64_t fee;      // satoshis
+    uint64_t amount;
+    uint32_t propertyid;
+    uint32_t type_int;
+    uint16_t version;
+    int32_t status; // parse status, the other fields are only set for PARSE_OK
+    OmniAddress sendingaddress;
+    OmniAddress referenceaddress;
+};
+
+//! Size of the string fields of OmniPayload, SP_STRING_FIELD_LEN of omnicore: 255 characters and the NUL
+static constexpr size_t PAYLOAD_STRING_SIZE = 256;
+//! Outputs of a send-to-many, its count is a single byte
+static constexpr size_t PAYLOAD_MAX_OUTPUTS = 255;
+
+//! OmniPayload of simple sends, send to owners, DEx accepts, crowdsale closes, grants, revokes, issuer changes, delegates and freezing
+struct PayloadTokens {
+    uint32_t property;
+    uint64_t amount;                // 0 for the types without amount
+    uint32_t distribution_property; // send to owners from version 1, the property paid out
+    OmniAddress address;            // freeze and unfreeze, the frozen address
+};
+
+//! OmniPayload of send all
+struct PayloadSendAll {
+    uint8_t ecosystem;
+};
+
+//! OmniPayload of sends of non-fungible tokens and of setting their data
+struct PayloadNonFungible {
+    uint32_t property;
+    uint64_t token_start;
+    uint64_t token_end;
+    uint8_t issuer_data; // data: 1 for the issuer's field, 0 for the holder's
+    uint8_t data[PAYLOAD_STRING_SIZE];
+};
+
+//! OmniPayload of send to many: amounts of property to outputs of the tx
+struct PayloadSendToMany {
+    uint32_t property;
+    uint32_t count;
+    uint8_t vout[PAYLOAD_MAX_OUTPUTS];
+    uint64_t amount[PAYLOAD_MAX_OUTPUTS];
+};
+
+//! OmniPayload of DEx sell offers of tokens for bitcoin
+struct PayloadDexOffer {
+    uint32_t property;
+    uint64_t amount;         // for sale
+    uint64_t amount_desired; // bitcoin
+    int64_t min_fee;         // bitcoin, of the accept
+    uint8_t block_time_limit;
+    uint8_t subaction; // new, update, cancel
+};
+
+//! OmniPayload of MetaDEx trades and the three cancels
+struct PayloadMetaDex {
+    uint32_t property; // for sale
+    uint64_t amount;
+    uint32_t property_desired;
+    uint64_t amount_desired;
+    uint8_t ecosystem; // cancel by ecosystem
+};
+
+//! OmniPayload of fixed, crowdsale (variable) and managed property creation
+struct PayloadCreateProperty {
+    uint8_t ecosystem;
+    uint16_t property_type; // indivisible 1, divisible 2, non-fungible 5; or'ed with 64 or 128 to replace or append
+    uint32_t previous_property;
+    uint8_t category[PAYLOAD_STRING_SIZE];
+    uint8_t subcategory[PAYLOAD_STRING_SIZE];
+    uint8_t name[PAYLOAD_STRING_SIZE];
+    uint8_t url[PAYLOAD_STRING_SIZE];
+    uint8_t data[PAYLOAD_STRING_SIZE];
+    uint64_t amount; // fixed: the tokens issued; crowdsale: tokens per unit invested
+    // crowdsale only
+    uint32_t property_desired;
+    int64_t deadline;
+    uint8_t early_bird_bonus;
+    uint8_t issuer_percentage;
+};
+
+//! OmniPayload of any data: the first PAYLOAD_STRING_SIZE bytes after the type
+struct PayloadAnyData {
+    uint32_t size;
+    uint8_t data[PAYLOAD_STRING_SIZE];
+};
+
+//! OmniPayload of feature activations and deactivations
+struct PayloadActivation {
+    uint16_t feature_id;
+    uint32_t activation_block;
+    uint32_t min_client_version;
+};
+
+//! OmniPayload of alerts
+struct PayloadAlert {
+    uint16_t alert_type;
+    uint32_t expiry;
+    uint8_t message[PAYLOAD_STRING_SIZE];
+};
+
+/**
+ * Typed payload of an interpreted Omni tx, filled from the CMPTransaction in the same pass as
+ * its record, so nothing has to decode the payload a second time.
+ *
+ * A tagged union: type is the tag and only the member for it is set, all others stay zero. It
+ * is laid out as a struct of the members, not as a union, so it crosses to Rust as plain data.
+ * Strings are NUL terminated, amounts in the smallest unit (satoshis for the bitcoin of DEx).
+ */
+struct OmniPayload {
+    uint16_t type; // tx type, MSC_TYPE_* of omnicore, the tag
+    uint16_t version;
+    PayloadTokens tokens;
+    PayloadSendAll send_all;
+    PayloadNonFungible nonfungible;
+    PayloadSendToMany send_to_many;
+    PayloadDexOffer dex_offer;
+    PayloadMetaDex metadex;
+    PayloadCreateProperty create_property;
+    PayloadAnyData any_data;
+    PayloadActivation activation;
+    PayloadAlert alert;
+};
+
+//! Status codes reported next to the negative return codes of parseTx (-1, -5, -101...-110)
+static constexpr int PARSE_OK = 0;
+static constexpr int PARSE_ERR_DECODE = -201;    //! hex is not a valid transaction
+static constexpr int PARSE_ERR_INTERPRET = -202; //! payload could not be interpreted
+static constexpr int PARSE_ERR_INPUT = -203;     //! RawTx json could not be read
+static constexpr int PARSE_FILTERED = -204;      //! Omni tx that touches nothing on the context's watchlist
+
+struct ParsedTx {
+    int status;
+    std::unique_ptr<OmniTx> tx; // null unless status is PARSE_OK
+};
+
+//! Batch input for ParseTxBatch, holding RawTx json strings that are decoded by the workers
+struct RawTxBatch {
+    std::vector<std::string> items;
+
+    void push(std::string rawStr)
+    {
+        items.push_back(std::move(rawStr));
+    }
+    size_t size() const
+    {
+        return items.size();
+    }
+};
+
+//! Batch output of ParseTxBatch, in input order
+struct ParsedTxBatch {
+    std::vector<ParsedTx> results;
+
+    size_t size() const
+    {
+        return results.size();
+    }
+    int status(size_t i) const
+    {
+        return results[i].status;
+    }
+    std::unique_ptr<OmniTx> take(size_t i)
+    {
+        return std::move(results[i].tx);
+    }
+};
+
+//! Counters of the scriptPubKey to address cache
+struct AddressCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t size;
+};
+
+static constexpr size_t DEFAULT_ADDRESS_CACHE_SIZE = 1 << 18;
+
+//! Counters of the parse result cache, see ParserContext::SetParseCacheSize
+struct ParseCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t size;
+};
+
+//! The parse result cache is off until it is given a size
+static constexpr size_t DEFAULT_PARSE_CACHE_SIZE = 0;
+
+//! Parse stages timed by the parser metrics
+enum ParseStage : uint8_t {
+    STAGE_DECODE = 0,  //! DecodeHexTx, or deserializing the tx of a binary RawTx
+    STAGE_CLASSIFY,    //! GetEncodingClass
+    STAGE_SENDER,      //! sender identification and fee
+    STAGE_REFERENCE,   //! output collection and reference identification, for Class A the data address too
+    STAGE_DEOBFUSCATE, //! Class B packet extraction and deobfuscation, Class C payload extraction
+    STAGE_INTERPRET,   //! interpret_Transaction
+    STAGE_TOTAL,       //! a whole parse, pre-filter included
+};
+
+static constexpr size_t PARSE_STAGES = 7;
+//! Latency buckets per stage, bucket i counts durations below 2^(i+8) ns and the last one the rest
+static constexpr size_t METRICS_BUCKETS = 24;
+//! Final parse statuses counted, see ParseStatusIndex
+static constexpr size_t METRICS_STATUSES = 17;
+//! Tx types counted, types from 256 on share the last slot
+static constexpr size_t METRICS_TYPES = 257;
+
+//! Snapshot of the counters of a context, all monotonic since the context was created
+struct ParserMetrics {
+    uint64_t stage_count[PARSE_STAGES];
+    uint64_t stage_ns[PARSE_STAGES];                        // total time per stage
+    uint64_t stage_buckets[PARSE_STAGES * METRICS_BUCKETS]; // stage * METRICS_BUCKETS + bucket, not cumulative
+    uint64_t status[METRICS_STATUSES];                      // parses by final status
+    uint64_t classes[4];                                    // classified txs by encoding class: none, A, B, C
+    uint64_t types[METRICS_TYPES];                          // parsed Omni txs by type
+};
+
+//! Slot of a status in ParserMetrics::status: 0, -1, -5, -101...-110, -201...-204; -1 for any other value
+int ParseStatusIndex(int status);
+//! Prometheus text exposition of metrics, labels (e.g. chain="main") are added to every sample
+std::string FormatPrometheusMetrics(const ParserMetrics& metrics, const std::string& labels);
+
+class ParserState;
+
+//! Receives the Omni txs of one block of ParseBlockFiles
+using BlockRecordsFn = std::function<void(int height, const std::vector<OmniTxRecord>& records)>;
+
+/**
+ * Everything a parse depends on: the chain params, the Exodus scripts and activation heights
+ * of the chain, the log configuration and the address cache.
+ *
+ * Contexts don't read the network selected by SelectParams, so one process can parse several
+ * chains at once with a context each. omnicore's interpret_Transaction still does: it encodes
+ * the frozen address of a freeze with the network of Init, so OmniPayload takes that address
+ * from the payload bytes with the context's chain. All methods are const and may be called
+ * concurrently from any number of threads on the same context. A parse reads the context and
+ * takes only short locks: the shard of the address cache and the parse cache around a lookup
+ * or insert, and the batch calls the process wide thread pool they share, see SetParseThreads.
+ * Log output goes to the process wide omnicore log set up by Init.
+ */
+class ParserContext
+{
+public:
+    /**
+     * chain: main, test, signet, regtest; debug traces every parse, to the omnicore log or with
+     * traceRing to lock free per thread rings that DrainTrace empties
+     */
+    ParserContext(std::string chain, bool debug = false, bool traceRing = false);
+    ~ParserContext();
+
+    std::unique_ptr<OmniTx> ParseTx(const RawTx& rawTx) const;
+    std::unique_ptr<OmniTx> ParseTxJson(const char* json, size_t len) const;
+    std::unique_ptr<OmniTx> ParseTxBin(const unsigned char* data, size_t len) const;
+    int ParseTxRecord(const char* json, size_t len, OmniTxRecord* record) const;
+    int ParseTxBinRecord(const unsigned char* data, size_t len, OmniTxRecord* record) const;
+    /**
+     * Same as ParseTxRecord, and for PARSE_OK the typed payload of the tx as well. A parse for
+     * the payload always runs, the parse result cache only holds records.
+     */
+    int ParseTxPayload(const char* json, size_t len, OmniTxRecord* record, OmniPayload* payload) const;
+    int ParseTxBinPayload(const unsigned char* data, size_t len, OmniTxRecord* record, OmniPayload* payload) const;
+
+    std::vector<ParsedTx> ParseTxs(Span<const RawTx> rawTxs) const;
+    std::unique_ptr<ParsedTxBatch> ParseTxBatch(const RawTxBatch& batch) const;
+    void ParseTxRecords(const RawTxBatch& batch, OmniTxRecord* records) const;
+    //! Omni txs of the block, resolving spends of its own outputs in the block; null if its json, hex or prevouts are invalid
+    std::unique_ptr<ParsedTxBatch> ParseBlock(const RawBlock& rawBlock) const;
+    /**
+     * Backfill from the blk*.dat files in blocksDir of a Bitcoin Core node that is stopped,
+     * without RPC or prevouts from outside. The files are memory-mapped and the blocks of the
+     * longest chain in them read in place, see BlockFiles; the txs the pre-filter lets through
+     * in the blocks fromHeight to toHeight (-1: the tip) are parsed on the batch threads, with
+     * their prevouts resolved through an index of the txs they spend, which a parallel pass
+     * over the chain up to toHeight fills. emit gets the Omni txs of every block that has any,
+     * in chain order, on the calling thread. With balances open, every block is applied to
+     * them before it is emitted. The prevout store isn't updated. Returns false and sets error
+     * if the files hold no chain or a block of it can't be read.
+     */
+    bool ParseBlockFiles(const std::string& blocksDir, int fromHeight, int toHeight, const BlockRecordsFn& emit, std::string& error) const;
+
+    bool IsOmniCandidate(Span<const unsigned char> txBytes) const;
+    bool IsOmniCandidateHex(const std::string& hexTx) const;
+    std::string FormatOmniAddress(const OmniAddress& address) const;
+
+    void SetAddressCacheSize(size_t entries) const;
+    AddressCacheStats GetAddressCacheStats() const;
+    /**
+     * Bound of the parse result cache, 0 turns it off and empties it. With a cache, a tx parsed
+     * again from a RawTx with the same tx and prevouts, say on confirmation after the mempool,
+     * gets its earlier result without being decoded or interpreted again, unless its new height
+     * changes the rules that apply. Results of txs with missing prevouts are not cached.
+     */
+    void SetParseCacheSize(size_t entries) const;
+    ParseCacheStats GetParseCacheStats() const;
+    ParserMetrics GetMetrics() const;
+
+    /**
+     * Opens or creates the LevelDB prevout store at path, with cacheBytes of cache. ParseBlock
+     * adds the outputs of every block to it and every parse looks up the prevouts its input
+     * leaves out there, so a RawTx only needs to carry the vin the store doesn't know about.
+     * Spent outputs are kept for PrevoutStore::SPENT_WINDOW blocks, so a tx parsed again after
+     * its block, on confirmation or after a shallower reorg, still resolves. Returns false if the
+     * database can't be opened. Not thread safe: no parse may be running.
+     */
+    bool OpenPrevoutStore(const std::string& path, size_t cacheBytes);
+    //! Height of the last block added to the prevout store, -1 for none or no store
+    int GetPrevoutStoreHeight() const;
+
+    /**
+     * Opens the in-memory balance engine (see balances.h), which ParseBlock and ParseBlockFiles
+     * then apply every block they parse to. It resumes from the snapshot at checkpointPath if
+     * there is one and writes a new snapshot there every checkpointInterval blocks, 0 for only
+     * on WriteBalancesCheckpoint. The engine has to see every Omni tx, so balances and a
+     * watchlist exclude each other. Returns false if a property or address is watched, or if the
+     * snapshot can't be read or is of another chain. Not thread safe: no parse may be running.
+     */
+    bool OpenBalances(const std::string& checkpointPath, int checkpointInterval);
+    //! Last block applied to the balances, -1 for none or no balances
+    int GetBalancesHeight() const;
+    //! Available balance of address in property, 0 without balances
+    int64_t GetBalance(const std::string& address, uint32_t property) const;
+    //! false if a tx type the engine doesn't apply touched property, or without balances
+    bool IsBalanceExact(uint32_t property) const;
+    bool WriteBalancesCheckpoint() const;
+
+    /**
+     * Once a property or an address is watched, only the Omni txs whose payload names a watched
+     * property or whose sender or reference is a watched address are interpreted. The others
+     * end as PARSE_FILTERED, counted in the metrics without a result, most of them before their
+     * sender and reference are even looked for. Not thread safe: no parse may be running.
+     * Changing the watchlist empties the parse result cache. Returns false with balances open,
+     * which would miss the filtered txs, see OpenBalances.
+     */
+    bool WatchProperty(uint32_t property);
+    //! false if address isn't a P2PKH or P2SH address of the context's chain, or with balances open
+    bool WatchAddress(const std::string& address);
+    //! Back to parsing every Omni tx
+    void ClearWatchlist();
+
+private:
+    friend class OmniParser;
+
+    std::unique_ptr<ParserState> m_state;
+};
+
+struct ParseBuffers;
+
+/**
+ * Parser for one thread that keeps its working memory from one parse to the next: the decoded
+ * RawTx, tx bytes, prevouts and the per output data of parseTx. Once the buffers have grown to
+ * the largest tx seen, a tx rejected by the pre-filter costs no heap allocation. An Omni
+ * candidate still allocates its inputs and outputs once, for the CTransaction that parseTx
+ * takes, besides the CMPTransaction and its addresses. Not thread safe; use one parser per
+ * thread, each over the same context. The context has to outlive the parser.
+ */
+class OmniParser
+{
+public:
+    explicit OmniParser(const ParserContext& context);
+    //! Over the default context created by Init
+    OmniParser();
+    ~OmniParser();
+    OmniParser(const OmniParser&) = delete;
+    OmniParser& operator=(const OmniParser&) = delete;
+
+    //! Same as ParseTxRecord
+    int Parse(const char* json, size_t len, OmniTxRecord* record);
+    int ParseBin(const unsigned char* data, size_t len, OmniTxRecord* record);
+    //! Same as ParserContext::ParseTxPayload
+    int ParsePayload(const char* json, size_t len, OmniTxRecord* record, OmniPayload* payload);
+    //! Fills tx for PARSE_OK, assigning into its strings so a reused OmniTx keeps their capacity
+    int ParseTx(const char* json, size_t len, OmniTx& tx);
+
+private:
+    const ParserState& m_state;
+    std::unique_ptr<ParseBuffers> m_buffers;
+};
+
+class ParseQueueImpl;
+
+/**
+ * Asynchronous parse: raw txs in json go into a bounded lock free submission ring, which a
+ * fixed set of worker threads, each with its own OmniParser, empties in batches; the records
+ * go into a lock free completion ring, tagged with the caller's tag, for Complete to collect.
+ * Submit and Complete take many txs per call, so a binding can coalesce the requests of many
+ * callers into few crossings. At most capacity txs are in flight, from Submit until Complete
+ * returns them; Submit accepts no more beyond that, which is the backpressure. All methods are
+ * thread safe. The context has to outlive the queue.
+ */
+class ParseQueue
+{
+public:
+    //! threads: workers, 0 for the number of cores
+    ParseQueue(const ParserContext& context, unsigned int threads, size_t capacity);
+    ~ParseQueue();
+    ParseQueue(const ParseQueue&) = delete;
+    ParseQueue& operator=(const ParseQueue&) = delete;
+
+    /**
+     * Submits count txs, the json of tx i from data + ends[i - 1] (0 for the first) to
+     * data + ends[i], with tags[i]. Returns how many of the first txs were accepted, fewer than
+     * count when the queue is full and 0 once it is closed.
+     */
+    size_t Submit(const char* data, const size_t* ends, const uint64_t* tags, size_t count) const;
+    /**
+     * Waits up to timeoutMs for a parsed tx, then moves up to max of them into records and their
+     * tags into tags, in completion order. Returns how many, 0 on timeout or once closed.
+     */
+    size_t Complete(OmniTxRecord* records, uint64_t* tags, size_t max, int timeoutMs) const;
+    //! Txs submitted and not yet returned by Complete
+    size_t InFlight() const;
+    //! Refuses further submissions and wakes the callers waiting in Complete
+    void Close() const;
+
+private:
+    std::unique_ptr<ParseQueueImpl> m_impl;
+};
+
+/**
+ * Pending trace lines of the contexts created with traceRing, one json object per line, at
+ * most max (0: all) of them. Call it from a thread of its own, concurrently with the parsers.
+ */
+std::string DrainTrace(size_t max = 0);
+//! Trace lines lost because the ring of their thread was full
+uint64_t GetTraceDropped();
+
+/**
+ * Selects the process wide network for omnicore and creates the default context of the free
+ * functions below; debug turns on omnicore's parser log categories, without the ArgsManager or
+ * any other log setup. Only the first call has an effect, later ones return at once whatever
+ * their arguments, so it is safe to call from any thread at any time; a process needing another
+ * chain as well creates a ParserContext for it.
+ */
 void Init(std::string chain = CBaseChainParams::MAIN, bool debug = true);
-std::unique_ptr<OmniTx> ParseTx(const RawTx& rawTx);
\ No newline at end of file
+
+// The free functions run on the default context created by Init.
+
+std::unique_ptr<OmniTx> ParseTx(const RawTx& rawTx);
+//! Parse a RawTx json from the caller's buffer, nothing is copied unless the tx passes the pre-filter
+std::unique_ptr<OmniTx> ParseTxJson(const char* json, size_t len);
+//! Parse a binary RawTx (see rawtx_bin.h) from the caller's buffer, skipping json and hex entirely
+std::unique_ptr<OmniTx> ParseTx(Span<const unsigned char> rawTxBin);
+std::unique_ptr<OmniTx> ParseTxBin(const unsigned char* data, size_t len);
+
+//! Cheap scan of a serialized tx, false means it is definitely not an Omni transaction; ParseTx runs it first
+bool IsOmniCandidate(Span<const unsigned char> txBytes);
+bool IsOmniCandidateHex(const std::string& hexTx);
+
+//! Fill one record per tx, without allocating a result; returns record->status
+int ParseTxRecord(const char* json, size_t len, OmniTxRecord* record);
+int ParseTxBinRecord(const unsigned char* data, size_t len, OmniTxRecord* record);
+//! Record and typed payload of one tx, see ParserContext::ParseTxPayload
+int ParseTxPayload(const char* json, size_t len, OmniTxRecord* record, OmniPayload* payload);
+int ParseTxBinPayload(const unsigned char* data, size_t len, OmniTxRecord* record, OmniPayload* payload);
+
+std::string FormatOmniTxid(const OmniTxRecord& record);
+std::string FormatOmniFee(const OmniTxRecord& record);
+std::string FormatOmniType(const OmniTxRecord& record);
+std::string FormatOmniAddress(const OmniAddress& address);
+
+//! Bound of the address cache shared by the sender, reference and output paths
+void SetAddressCacheSize(size_t entries);
+AddressCacheStats GetAddressCacheStats();
+
+//! Parse result cache of the default context, see ParserContext::SetParseCacheSize
+void SetParseCacheSize(size_t entries);
+ParseCacheStats GetParseCacheStats();
+
+//! Per stage latency histograms and status, class and type counters of the default context
+ParserMetrics GetParserMetrics();
+
+//! Prevout store of the default context, see ParserContext::OpenPrevoutStore
+bool OpenPrevoutStore(const std::string& path, size_t cacheBytes);
+int GetPrevoutStoreHeight();
+
+//! Balances of the default context, see ParserContext::OpenBalances
+bool OpenBalances(const std::string& checkpointPath, int checkpointInterval);
+int GetBalancesHeight();
+int64_t GetBalance(const std::string& address, uint32_t property);
+bool IsBalanceExact(uint32_t property);
+bool WriteBalancesCheckpoint();
+
+//! Watchlist of the default context, see ParserContext::WatchProperty
+bool WatchProperty(uint32_t property);
+bool WatchAddress(const std::string& address);
+void ClearWatchlist();
+
+//! Number of worker threads used by the batch API of all contexts, 0 selects the number of cores
+void SetParseThreads(unsigned int threads);
+std::vector<ParsedTx> ParseTxs(Span<const RawTx> rawTxs);
+std::unique_ptr<ParsedTxBatch> ParseTxBatch(const RawTxBatch& batch);
+//! records has to hold batch.size() entries, filled in input order
+void ParseTxRecords(const RawTxBatch& batch, OmniTxRecord* records);
+
+//! Parse every tx of a block against one shared coins view, returns the Omni txs in block order or null if the block can't be decoded
+std::unique_ptr<ParsedTxBatch> ParseBlock(const RawBlock& rawBlock);
+//! Backfill from blk*.dat files on the default context, see ParserContext::ParseBlockFiles
+bool ParseBlockFiles(const std::string& blocksDir, int fromHeight, int toHeight, const BlockRecordsFn& emit, std::string& error);
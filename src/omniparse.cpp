@@ -0,0 +1,367 @@
+#include "omni.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tinyformat.h>
+#include <vector>
+
+/**
+ * Parses RawTx json lines into OmniTx json lines, in input order.
+ *
+ *   omniparse [-chain=main] [-threads=<cores>] [-drop] [-status] [-metrics] [file]
+ *   omniparse [-chain=main] [-threads=<cores>] [-metrics] -blocks=<datadir>/blocks [-from=<height>] [-to=<height>] [-balances=<file>]
+ *
+ * Reads the file, or stdin, in chunks of whole lines on a reader thread, parses the chunks on
+ * the parser threads and writes them back in order from the main thread; at most a few chunks
+ * per thread are in flight, whatever the size of the input. An Omni tx is written as
+ * OmniTx::dumps(), any other line as null, as {"line":<n>,"status":<code>} with -status or not
+ * at all with -drop. Empty lines are skipped. -metrics prints the parser metrics to stderr in
+ * the Prometheus text format at the end.
+ *
+ * With -blocks, the Omni txs from -from (default 0) to -to (default: the tip) are read straight
+ * from the blk*.dat files of a stopped Bitcoin Core node instead, see ParseBlockFiles, and
+ * written in chain order. -balances keeps Omni balances along (see OpenBalances), checkpointed
+ * to the file every BALANCE_CHECKPOINT_INTERVAL blocks and at the end; a run with the same file
+ * starts past its checkpoint, whatever -from says.
+ */
+
+namespace {
+
+//! Read granularity, a chunk grows past it only to hold a longer line
+constexpr size_t CHUNK_SIZE = 1 << 20;
+//! Blocks between two balance checkpoints of -balances
+constexpr int BALANCE_CHECKPOINT_INTERVAL = 10000;
+
+struct Chunk {
+    uint64_t seq;
+    uint64_t firstLine; // 1-based number of the first line
+    std::string data;   // whole lines
+    std::string out;
+};
+
+struct Options {
+    std::string chain = "main";
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool drop = false;
+    bool status = false;
+    bool metrics = false;
+    std::string path;
+    std::string blocks;
+    int from = 0;
+    int to = -1;
+    std::string balances;
+};
+
+template <typename T>
+class Queue
+{
+public:
+    void Push(T item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_items.push_back(std::move(item));
+        }
+        m_cond.notify_one();
+    }
+    //! false once the queue is closed and empty
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this] { return !m_items.empty() || m_closed; });
+        if (m_items.empty()) return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        return true;
+    }
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_cond.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<T> m_items;
+    bool m_closed{false};
+};
+
+//! Parsed chunks waiting for their turn, with the bound on chunks between reader and writer
+class Reorder
+{
+public:
+    explicit Reorder(size_t maxInFlight) : m_maxInFlight(maxInFlight) {}
+
+    //! Reader: blocks while the maximum of chunks is in flight
+    void Acquire()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this] { return m_inFlight < m_maxInFlight; });
+        ++m_inFlight;
+    }
+    //! Reader: no more chunks after total
+    void Finish(uint64_t total)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_total = total;
+        }
+        m_cond.notify_all();
+    }
+    //! Parsers
+    void Done(std::unique_ptr<Chunk> chunk)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done.emplace(chunk->seq, std::move(chunk));
+        }
+        m_cond.notify_all();
+    }
+    //! Writer: the next chunk in input order, null after the last one
+    std::unique_ptr<Chunk> Next()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this] { return m_done.count(m_next) || m_next == m_total; });
+        if (m_next == m_total) return nullptr;
+        auto found = m_done.find(m_next);
+        std::unique_ptr<Chunk> chunk = std::move(found->second);
+        m_done.erase(found);
+        ++m_next;
+        return chunk;
+    }
+    //! Writer: the chunk is written
+    void Release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_inFlight;
+        }
+        m_cond.notify_all();
+    }
+
+private:
+    const size_t m_maxInFlight;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::map<uint64_t, std::unique_ptr<Chunk>> m_done;
+    size_t m_inFlight{0};
+    uint64_t m_next{0};
+    uint64_t m_total{UINT64_MAX};
+};
+
+void readChunks(FILE* in, Reorder& reorder, Queue<std::unique_ptr<Chunk>>& parse)
+{
+    uint64_t seq = 0;
+    uint64_t line = 1;
+    std::string carry; // partial line of the previous read
+    bool eof = false;
+    while (!eof) {
+        reorder.Acquire();
+        auto chunk = std::make_unique<Chunk>();
+        chunk->seq = seq++;
+        chunk->firstLine = line;
+        chunk->data.swap(carry);
+
+        // read until the chunk holds at least one whole line
+        size_t end = std::string::npos;
+        while (end == std::string::npos && !eof) {
+            size_t size = chunk->data.size();
+            chunk->data.resize(size + CHUNK_SIZE);
+            size_t read = fread(&chunk->data[size], 1, CHUNK_SIZE, in);
+            chunk->data.resize(size + read);
+            eof = read < CHUNK_SIZE;
+            end = chunk->data.rfind('\n');
+        }
+        if (!eof && end + 1 < chunk->data.size()) {
+            carry.assign(chunk->data, end + 1, std::string::npos);
+            chunk->data.resize(end + 1);
+        }
+
+        line += std::count(chunk->data.begin(), chunk->data.end(), '\n');
+        parse.Push(std::move(chunk));
+    }
+    reorder.Finish(seq);
+    parse.Close();
+}
+
+std::string dumpRecord(const OmniTxRecord& record)
+{
+    OmniTx tx;
+    tx.txid = FormatOmniTxid(record);
+    tx.fee = FormatOmniFee(record);
+    tx.sendingaddress = FormatOmniAddress(record.sendingaddress);
+    tx.referenceaddress = FormatOmniAddress(record.referenceaddress);
+    tx.version = record.version;
+    tx.type_int = record.type_int;
+    tx.type = FormatOmniType(record);
+    tx.amount = record.amount;
+    tx.propertyid = record.propertyid;
+    return tx.dumps();
+}
+
+void parseChunk(const Options& options, OmniParser& parser, Chunk& chunk)
+{
+    const char* data = chunk.data.data();
+    const char* end = data + chunk.data.size();
+    uint64_t line = chunk.firstLine;
+    for (const char* begin = data; begin < end; ++line) {
+        const char* eol = static_cast<const char*>(memchr(begin, '\n', end - begin));
+        if (!eol) eol = end;
+        size_t len = eol - begin;
+        if (len && begin[len - 1] == '\r') --len;
+
+        if (len) {
+            OmniTxRecord record;
+            if (parser.Parse(begin, len, &record) == PARSE_OK) {
+                chunk.out += dumpRecord(record);
+                chunk.out += '\n';
+            } else if (options.status) {
+                chunk.out += strprintf("{\"line\":%u,\"status\":%d}\n", line, record.status);
+            } else if (!options.drop) {
+                chunk.out += "null\n";
+            }
+        }
+        begin = eol + 1;
+    }
+    // the input is not needed anymore, only the output stays in flight
+    std::string().swap(chunk.data);
+}
+
+bool parseArgs(int argc, char const* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("-chain=", 0) == 0) {
+            options.chain = arg.substr(7);
+        } else if (arg.rfind("-threads=", 0) == 0) {
+            options.threads = std::max(1, std::stoi(arg.substr(9)));
+        } else if (arg == "-drop") {
+            options.drop = true;
+        } else if (arg == "-status") {
+            options.status = true;
+        } else if (arg == "-metrics") {
+            options.metrics = true;
+        } else if (arg.rfind("-blocks=", 0) == 0) {
+            options.blocks = arg.substr(8);
+        } else if (arg.rfind("-from=", 0) == 0) {
+            options.from = std::stoi(arg.substr(6));
+        } else if (arg.rfind("-to=", 0) == 0) {
+            options.to = std::stoi(arg.substr(4));
+        } else if (arg.rfind("-balances=", 0) == 0) {
+            options.balances = arg.substr(10);
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            return false;
+        } else {
+            options.path = arg;
+        }
+    }
+    return true;
+}
+
+int parseBlockFiles(const Options& options)
+{
+    SetParseThreads(options.threads);
+    int from = options.from;
+    if (!options.balances.empty()) {
+        if (!OpenBalances(options.balances, BALANCE_CHECKPOINT_INTERVAL)) {
+            std::cerr << "can't open balances " << options.balances << std::endl;
+            return 1;
+        }
+        from = std::max(from, GetBalancesHeight() + 1);
+    }
+
+    std::string out;
+    std::string error;
+    bool parsed = ParseBlockFiles(options.blocks, from, options.to, [&](int, const std::vector<OmniTxRecord>& records) {
+        out.clear();
+        for (const OmniTxRecord& record : records) {
+            out += dumpRecord(record);
+            out += '\n';
+        }
+        fwrite(out.data(), 1, out.size(), stdout);
+    }, error);
+    fflush(stdout);
+    if (!options.balances.empty() && !WriteBalancesCheckpoint()) {
+        std::cerr << "can't write the balance checkpoint " << options.balances << std::endl;
+        return 1;
+    }
+    if (!parsed) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char const* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::cerr << "usage: omniparse [-chain=main] [-threads=<cores>] [-drop] [-status] [-metrics] [file]" << std::endl;
+        std::cerr << "       omniparse [-chain=main] [-threads=<cores>] [-metrics] -blocks=<datadir>/blocks [-from=<height>] [-to=<height>] [-balances=<file>]" << std::endl;
+        return 1;
+    }
+
+    if (!options.blocks.empty()) {
+        Init(options.chain, false);
+        int ret = parseBlockFiles(options);
+        if (options.metrics) {
+            std::cerr << FormatPrometheusMetrics(GetParserMetrics(), strprintf("chain=\"%s\"", options.chain));
+        }
+        return ret;
+    }
+
+    FILE* in = options.path.empty() ? stdin : fopen(options.path.c_str(), "rb");
+    if (!in) {
+        std::cerr << "can't open " << options.path << std::endl;
+        return 1;
+    }
+
+    Init(options.chain, false);
+
+    Queue<std::unique_ptr<Chunk>> parse;
+    Reorder reorder(4 * options.threads);
+
+    std::thread reader([&] { readChunks(in, reorder, parse); });
+    std::vector<std::thread> parsers;
+    for (unsigned int i = 0; i < options.threads; ++i) {
+        parsers.emplace_back([&] {
+            OmniParser parser;
+            std::unique_ptr<Chunk> chunk;
+            while (parse.Pop(chunk)) {
+                parseChunk(options, parser, *chunk);
+                reorder.Done(std::move(chunk));
+            }
+        });
+    }
+
+    while (auto chunk = reorder.Next()) {
+        fwrite(chunk->out.data(), 1, chunk->out.size(), stdout);
+        reorder.Release();
+    }
+    fflush(stdout);
+
+    reader.join();
+    for (auto& parser : parsers) {
+        parser.join();
+    }
+    if (in != stdin) fclose(in);
+
+    if (options.metrics) {
+        std::cerr << FormatPrometheusMetrics(GetParserMetrics(), strprintf("chain=\"%s\"", options.chain));
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "parsebuffers.h"
+#include "hex.h"
+#include <algorithm>
+#include <hash.h>
+#include <streams.h>
+#include <version.h>
+
+bool DecodeHexInto(std::string_view hex, std::vector<unsigned char>& out)
+{
+    if (hex.size() % 2) return false;
+    out.resize(hex.size() / 2);
+    return DecodeHex(hex, out.data());
+}
+
+bool DecodeTxidInto(std::string_view hex, uint256& txid)
+{
+    // display hex is the reversed serialization
+    if (hex.size() != 2 * uint256::size() || !DecodeHex(hex, txid.begin())) return false;
+    std::reverse(txid.begin(), txid.end());
+    return true;
+}
+
+bool DecodeTxInto(Span<const unsigned char> bytes, CMutableTransaction& tx)
+{
+    try {
+        SpanReader reader(SER_NETWORK, PROTOCOL_VERSION, bytes);
+        reader >> tx;
+        return reader.empty();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool DecodeBlockInto(Span<const unsigned char> bytes, CBlock& block)
+{
+    try {
+        SpanReader reader(SER_NETWORK, PROTOCOL_VERSION, bytes);
+        reader >> block;
+        return reader.empty();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+std::pair<COutPoint, Coin>& TxPrevouts::next()
+{
+    if (m_size == m_coins.size()) m_coins.emplace_back();
+    return m_coins[m_size++];
+}
+
+bool TxPrevouts::Add(std::string_view txidHex, uint32_t vout, CAmount value, uint32_t height, std::string_view scriptHex)
+{
+    if (scriptHex.size() % 2) return false;
+
+    auto& [outpoint, coin] = next();
+    if (!DecodeTxidInto(txidHex, outpoint.hash)) return false;
+    outpoint.n = vout;
+
+    CScript& script = coin.out.scriptPubKey;
+    script.resize(scriptHex.size() / 2);
+    if (!DecodeHex(scriptHex, script.data())) return false;
+    coin.out.nValue = value;
+    coin.nHeight = height;
+    coin.fCoinBase = false;
+    return true;
+}
+
+void TxPrevouts::Add(const uint256& txid, uint32_t vout, CAmount value, uint32_t height, Span<const unsigned char> script)
+{
+    auto& [outpoint, coin] = next();
+    outpoint.hash = txid;
+    outpoint.n = vout;
+    coin.out.scriptPubKey.assign(script.begin(), script.end());
+    coin.out.nValue = value;
+    coin.nHeight = height;
+    coin.fCoinBase = false;
+}
+
+uint256 TxPrevouts::Digest() const
+{
+    CHashWriter hasher(SER_GETHASH, 0);
+    for (size_t i = 0; i < m_size; ++i) {
+        hasher << m_coins[i].first << m_coins[i].second.out;
+    }
+    return hasher.GetHash();
+}
+
+bool TxPrevouts::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    // a handful of inputs, a scan beats any map; the last added entry wins, as with AddCoin
+    for (size_t i = m_size; i-- > 0;) {
+        if (m_coins[i].first == outpoint) {
+            coin = m_coins[i].second;
+            return true;
+        }
+    }
+    return m_base && m_base->GetCoin(outpoint, coin);
+}
+
+bool TxPrevouts::HaveCoin(const COutPoint& outpoint) const
+{
+    for (size_t i = 0; i < m_size; ++i) {
+        if (m_coins[i].first == outpoint) return true;
+    }
+    return m_base && m_base->HaveCoin(outpoint);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "rawtx_bin.h"
+#include "rawtx_json.h"
+#include <coins.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <script/standard.h>
+#include <span.h>
+#include <string>
+#include <string_view>
+#include <uint256.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Coins of the prevouts a RawTx carries, over the context's base view for the ones it leaves
+ * out. Entries are overwritten in place from one tx to the next, so once the buffers have
+ * grown to the largest tx seen, filling them allocates nothing.
+ */
+class TxPrevouts : public CCoinsView
+{
+public:
+    void Reset(CCoinsView& base)
+    {
+        m_base = &base;
+        m_size = 0;
+    }
+
+    //! Prevout of a RawTx json, txid as display hex; false if txid or script isn't hex
+    bool Add(std::string_view txidHex, uint32_t vout, CAmount value, uint32_t height, std::string_view scriptHex);
+    void Add(const uint256& txid, uint32_t vout, CAmount value, uint32_t height, Span<const unsigned char> script);
+
+    //! Hash of the outpoints, values and scripts added, in order; ParseCache keys on it
+    uint256 Digest() const;
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override;
+    bool HaveCoin(const COutPoint& outpoint) const override;
+
+private:
+    std::pair<COutPoint, Coin>& next();
+
+    std::vector<std::pair<COutPoint, Coin>> m_coins;
+    size_t m_size{0};
+    CCoinsView* m_base{nullptr};
+};
+
+/**
+ * Working memory of a parse that is kept from one parse to the next: the decoded RawTx, the
+ * tx bytes, the prevouts and what parseTx collects about the inputs and outputs.
+ *
+ * Every parse resets the buffers without giving back their capacity. In the steady state a tx
+ * the pre-filter rejects costs no allocation at all. An Omni candidate allocates its inputs and
+ * outputs once, as the CTransaction handed to parseTx owns them, and the few of CMPTransaction
+ * and the addresses of its sender and reference.
+ */
+struct ParseBuffers {
+    RawTxView json;
+    RawTxBinView bin;
+    std::vector<unsigned char> txBytes;
+    CMutableTransaction tx;
+    TxPrevouts prevouts;
+
+    // parseTx
+    struct InputSum {
+        CTxDestination dest;
+        int64_t value;
+        unsigned int vin; // first input of dest
+    };
+    std::vector<Coin> coins; // spent by the tx, in vin order
+    std::vector<InputSum> inputSums;
+    std::vector<Span<const unsigned char>> scriptData; // pushes of the outputs, into the tx
+    std::vector<Span<const unsigned char>> classCPushes;
+    std::vector<CTxDestination> destData;
+    std::vector<unsigned int> outputData; // vout of each destData entry
+    std::vector<int64_t> valueData;
+    // parseTx results: input of the sender and output of the reference, -1 for none, and the
+    // payload, packetSize bytes of packet
+    int senderVin{-1};
+    int referenceVout{-1};
+    std::vector<unsigned char> packet;
+    unsigned int packetSize{0};
+};
+
+//! Display hex of a txid, false unless it is 64 hex digits
+bool DecodeTxidInto(std::string_view hex, uint256& txid);
+//! Decodes hex into out, which keeps its capacity; false for odd length or a non hex digit
+bool DecodeHexInto(std::string_view hex, std::vector<unsigned char>& out);
+//! Decodes a tx as DecodeHexTx does after the hex, with witness, the whole span has to be consumed
+bool DecodeTxInto(Span<const unsigned char> bytes, CMutableTransaction& tx);
+//! Decodes a block as DecodeHexBlk does after the hex, the whole span has to be consumed
+bool DecodeBlockInto(Span<const unsigned char> bytes, CBlock& block);
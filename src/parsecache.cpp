@@ -0,0 +1,76 @@
+#include "parsecache.h"
+
+ParseCache::ParseCache(size_t capacity)
+{
+    SetCapacity(capacity);
+}
+
+void ParseCache::SetCapacity(size_t capacity)
+{
+    // rounded up, so a small capacity still caches
+    m_shardCapacity = (capacity + SHARDS - 1) / SHARDS;
+    if (!capacity) Clear();
+}
+
+void ParseCache::Clear()
+{
+    for (Shard& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.map.clear();
+    }
+}
+
+ParseCacheStats ParseCache::GetStats() const
+{
+    ParseCacheStats stats{};
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    stats.misses = m_misses.load(std::memory_order_relaxed);
+    stats.evictions = m_evictions.load(std::memory_order_relaxed);
+    for (const Shard& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.size += shard.map.size();
+    }
+    return stats;
+}
+
+ParseCache::Shard& ParseCache::shardOf(const Key& key)
+{
+    // the low bits pick the bucket inside the shard's map, use the high ones here
+    return m_shards[(KeyHasher()(key) >> 56) % SHARDS];
+}
+
+bool ParseCache::Lookup(const Key& key, int epoch, OmniTxRecord& record)
+{
+    Shard& shard = shardOf(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it != shard.map.end() && it->second.epoch == epoch) {
+            record = it->second.record;
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void ParseCache::Insert(const Key& key, int epoch, const OmniTxRecord& record)
+{
+    Shard& shard = shardOf(key);
+    size_t capacity = m_shardCapacity.load(std::memory_order_relaxed);
+    if (!capacity) return;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+        // parsed again at a height of another epoch, the newer one is likelier to come back
+        it->second = Entry{epoch, record};
+        return;
+    }
+    while (!shard.map.empty() && shard.map.size() >= capacity) {
+        shard.map.erase(shard.map.begin());
+        m_evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.map.emplace(key, Entry{epoch, record});
+}
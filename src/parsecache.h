@@ -0,0 +1,80 @@
+#pragma once
+
+#include "omni.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <uint256.h>
+#include <unordered_map>
+
+/**
+ * Bounded, thread-safe cache of parse results, Omni txs and rejections alike, keyed by the
+ * hash of the tx bytes and a digest of the prevouts the RawTx carried. The txid a json RawTx
+ * declares plays no part, a wrong one can't get another tx's result.
+ *
+ * A tx is parsed when it enters the mempool, again when it confirms and once more after a
+ * reorg, each time with only height, time and idx changed. A record doesn't hold the block
+ * position, only the height dependent rules of the parser (allowed input and output types,
+ * the crowdsale address) can change it, and interpret_Transaction only decodes the payload;
+ * so an entry keeps the rules epoch of the height it was parsed at and serves every height of
+ * the same epoch. Split into shards with a lock each like AddressCache, a full shard evicts
+ * an arbitrary entry. Capacity 0 turns the cache off.
+ */
+class ParseCache
+{
+public:
+    struct Key {
+        uint256 txid;     // hash of the tx bytes, the wtxid for a segwit tx
+        uint256 prevouts; // TxPrevouts::Digest
+
+        bool operator==(const Key& other) const
+        {
+            return txid == other.txid && prevouts == other.prevouts;
+        }
+    };
+
+    explicit ParseCache(size_t capacity);
+
+    //! Upper bound of entries, applied as entries are added
+    void SetCapacity(size_t capacity);
+    //! Drops every entry, keeping the capacity
+    void Clear();
+    bool Enabled() const
+    {
+        return m_shardCapacity.load(std::memory_order_relaxed) > 0;
+    }
+    ParseCacheStats GetStats() const;
+
+    //! Copies the cached record, status included, if there is one for key parsed at a height of epoch
+    bool Lookup(const Key& key, int epoch, OmniTxRecord& record);
+    void Insert(const Key& key, int epoch, const OmniTxRecord& record);
+
+private:
+    static constexpr size_t SHARDS = 16;
+
+    struct KeyHasher {
+        size_t operator()(const Key& key) const
+        {
+            // both are hashes already
+            return key.txid.GetCheapHash() ^ key.prevouts.GetCheapHash();
+        }
+    };
+
+    struct Entry {
+        int epoch;
+        OmniTxRecord record;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<Key, Entry, KeyHasher> map;
+    };
+
+    Shard& shardOf(const Key& key);
+
+    Shard m_shards[SHARDS];
+    std::atomic<size_t> m_shardCapacity;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_evictions{0};
+};
@@ -0,0 +1,123 @@
+#include "parsequeue.h"
+#include <algorithm>
+#include <assert.h>
+
+ParseQueueImpl::ParseQueueImpl(const ParserContext& context, unsigned int threads, size_t capacity)
+    : m_context(context), m_capacity(std::max<size_t>(capacity, 1)), m_requests(m_capacity), m_completions(m_capacity)
+{
+    if (!threads) threads = std::max(std::thread::hardware_concurrency(), 1u);
+    m_workers.reserve(threads);
+    for (unsigned int i = 0; i < threads; ++i) {
+        m_workers.emplace_back([this] { work(); });
+    }
+}
+
+ParseQueueImpl::~ParseQueueImpl()
+{
+    Close();
+    m_stop = true;
+    m_submitted.Notify(true);
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+size_t ParseQueueImpl::Submit(const char* data, const size_t* ends, const uint64_t* tags, size_t count)
+{
+    if (m_closed.load(std::memory_order_acquire)) return 0;
+
+    // reserve the slots first, so neither ring can overflow
+    size_t inFlight = m_inFlight.load(std::memory_order_relaxed);
+    size_t accepted;
+    do {
+        accepted = std::min(count, m_capacity - std::min(inFlight, m_capacity));
+        if (!accepted) return 0;
+    } while (!m_inFlight.compare_exchange_weak(inFlight, inFlight + accepted, std::memory_order_relaxed));
+
+    size_t begin = 0;
+    for (size_t i = 0; i < accepted; ++i) {
+        bool pushed = m_requests.Push(Request{tags[i], std::string(data + begin, ends[i] - begin)});
+        assert(pushed);
+        (void)pushed;
+        begin = ends[i];
+    }
+    m_submitted.Notify(accepted > 1);
+    return accepted;
+}
+
+size_t ParseQueueImpl::Complete(OmniTxRecord* records, uint64_t* tags, size_t max, int timeoutMs)
+{
+    if (!max) return 0;
+    m_completed.Wait([this] { return m_closed.load(std::memory_order_acquire) || !m_completions.Empty(); },
+                     std::chrono::milliseconds(std::max(timeoutMs, 0)));
+
+    size_t count = 0;
+    Completion completion;
+    while (count < max && m_completions.Pop(completion)) {
+        records[count] = completion.record;
+        tags[count] = completion.tag;
+        ++count;
+    }
+    m_inFlight.fetch_sub(count, std::memory_order_relaxed);
+    return count;
+}
+
+void ParseQueueImpl::Close()
+{
+    m_closed = true;
+    m_completed.Notify(true);
+}
+
+void ParseQueueImpl::work()
+{
+    OmniParser parser(m_context);
+    Request batch[WORKER_BATCH];
+
+    while (true) {
+        size_t count = 0;
+        while (count < WORKER_BATCH && m_requests.Pop(batch[count])) {
+            ++count;
+        }
+        if (!count) {
+            if (m_stop.load(std::memory_order_acquire)) return;
+            m_submitted.Wait([this] { return m_stop.load(std::memory_order_acquire) || !m_requests.Empty(); },
+                             std::chrono::seconds(1));
+            continue;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            Completion completion{batch[i].tag, {}};
+            parser.Parse(batch[i].json.data(), batch[i].json.size(), &completion.record);
+            bool pushed = m_completions.Push(std::move(completion));
+            assert(pushed);
+            (void)pushed;
+        }
+        // one wakeup per batch, the collector takes all of it at once
+        m_completed.Notify();
+    }
+}
+
+ParseQueue::ParseQueue(const ParserContext& context, unsigned int threads, size_t capacity)
+    : m_impl(std::make_unique<ParseQueueImpl>(context, threads, capacity)) {}
+
+ParseQueue::~ParseQueue() = default;
+
+size_t ParseQueue::Submit(const char* data, const size_t* ends, const uint64_t* tags, size_t count) const
+{
+    return m_impl->Submit(data, ends, tags, count);
+}
+
+size_t ParseQueue::Complete(OmniTxRecord* records, uint64_t* tags, size_t max, int timeoutMs) const
+{
+    return m_impl->Complete(records, tags, max, timeoutMs);
+}
+
+size_t ParseQueue::InFlight() const
+{
+    return m_impl->InFlight();
+}
+
+void ParseQueue::Close() const
+{
+    m_impl->Close();
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "omni.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Bounded lock free queue of any number of producers and consumers (Vyukov's array queue).
+ *
+ * Every slot carries a sequence number that tells whether it is free for the push or filled
+ * for the pop at a given position; producers and consumers claim positions with a CAS on
+ * their own counter and then hand the slot over with a release store of its sequence, so a
+ * push and a pop never touch the same cache line unless they race for the same slot. Push
+ * fails when the queue is full, pop when it is empty, neither waits.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    //! capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        m_mask = size - 1;
+        m_slots = std::make_unique<Slot[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    size_t Capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    bool Push(T&& value)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = m_slots[pos & m_mask];
+            intptr_t diff = intptr_t(slot.sequence.load(std::memory_order_acquire)) - intptr_t(pos);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool Pop(T& value)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = m_slots[pos & m_mask];
+            intptr_t diff = intptr_t(slot.sequence.load(std::memory_order_acquire)) - intptr_t(pos + 1);
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(slot.value);
+                    slot.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    //! Whether a pop would find nothing, a snapshot that concurrent pushes may outdate at once
+    bool Empty() const
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        return m_slots[pos & m_mask].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    size_t m_mask;
+    std::unique_ptr<Slot[]> m_slots;
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+/**
+ * Parking for the threads that found a BoundedQueue empty. Notify only takes the mutex when a
+ * thread waits, so the producers of a busy queue stay lock free; a waiter registers before it
+ * checks the condition a last time, and a notifier checks for waiters after it published, so
+ * one of the two always sees the other.
+ */
+class Wakeup
+{
+public:
+    //! Waits until ready() or timeout has passed, returns ready()
+    template <typename Ready>
+    bool Wait(Ready ready, std::chrono::milliseconds timeout)
+    {
+        if (ready()) return true;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_waiters.fetch_add(1, std::memory_order_acq_rel);
+        bool result = m_cond.wait_for(lock, timeout, ready);
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    void Notify(bool all = false)
+    {
+        // a read-modify-write rather than a load: it either reads a waiter's registration or
+        // releases the published item to the registration that reads from it
+        if (m_waiters.fetch_add(0, std::memory_order_acq_rel) == 0) return;
+        {
+            // a waiter between its registration and the wait holds the mutex
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        if (all) {
+            m_cond.notify_all();
+        } else {
+            m_cond.notify_one();
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::atomic<unsigned int> m_waiters{0};
+};
+
+//! The state of a ParseQueue (omni.h)
+class ParseQueueImpl
+{
+public:
+    //! Requests a worker takes off the submission ring at once
+    static constexpr size_t WORKER_BATCH = 32;
+
+    ParseQueueImpl(const ParserContext& context, unsigned int threads, size_t capacity);
+    ~ParseQueueImpl();
+
+    size_t Submit(const char* data, const size_t* ends, const uint64_t* tags, size_t count);
+    size_t Complete(OmniTxRecord* records, uint64_t* tags, size_t max, int timeoutMs);
+    size_t InFlight() const
+    {
+        return m_inFlight.load(std::memory_order_relaxed);
+    }
+    void Close();
+
+private:
+    struct Request {
+        uint64_t tag;
+        std::string json;
+    };
+
+    struct Completion {
+        uint64_t tag;
+        OmniTxRecord record;
+    };
+
+    void work();
+
+    const ParserContext& m_context;
+    const size_t m_capacity;
+    std::atomic<size_t> m_inFlight{0};
+    std::atomic<bool> m_closed{false};
+    std::atomic<bool> m_stop{false};
+
+    // many submitters and the workers
+    BoundedQueue<Request> m_requests;
+    Wakeup m_submitted;
+    // the workers and, as a rule, one collector
+    BoundedQueue<Completion> m_completions;
+    Wakeup m_completed;
+
+    std::vector<std::thread> m_workers;
+};
@@ -0,0 +1,294 @@
+#include "parserstate.h"
+#include "omni.h"
+#include "payload.h"
+#include <algorithm>
+#include <assert.h>
+#include <base58.h>
+#include <bech32.h>
+#include <chainparams.h>
+#include <iterator>
+#include <limits>
+#include <omnicore/omnicore.h>
+#include <omnicore/rules.h>
+#include <omnicore/script.h>
+#include <omnicore/sp.h>
+#include <primitives/transaction.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+
+using namespace mastercore;
+
+//! Exodus and crowdsale addresses, the same strings omnicore decodes in ExodusAddress()/ExodusCrowdsaleAddress()
+static const std::string EXODUS_MAINNET = "1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P";
+static const std::string EXODUS_TESTNET = "mpexoDuSkGGqvqrkrjiFng38QPkJQVFyqv";
+static const std::string MONEYMAN = "moneyqMan7uh8FqdCA2BV5yZ8qVrc9ikLP";
+
+// the version byte only selects the network, the hash is what ends up in the script
+static CScript scriptForPKHashAddress(const std::string& address)
+{
+    std::vector<unsigned char> data;
+    bool decoded = DecodeBase58Check(address, data, 21);
+    assert(decoded && data.size() == 21);
+    return GetScriptForDestination(PKHash(uint160(Span<const unsigned char>(data).subspan(1))));
+}
+
+namespace {
+
+//! key_io's DestinationEncoder, bound to the given params instead of Params()
+class DestinationEncoder
+{
+public:
+    explicit DestinationEncoder(const CChainParams& params) : m_params(params) {}
+
+    std::string operator()(const PKHash& id) const
+    {
+        std::vector<unsigned char> data = m_params.Base58Prefix(CChainParams::PUBKEY_ADDRESS);
+        data.insert(data.end(), id.begin(), id.end());
+        return EncodeBase58Check(data);
+    }
+
+    std::string operator()(const ScriptHash& id) const
+    {
+        std::vector<unsigned char> data = m_params.Base58Prefix(CChainParams::SCRIPT_ADDRESS);
+        data.insert(data.end(), id.begin(), id.end());
+        return EncodeBase58Check(data);
+    }
+
+    std::string operator()(const WitnessV0KeyHash& id) const
+    {
+        return witness(bech32::Encoding::BECH32, 0, id.begin(), id.end());
+    }
+
+    std::string operator()(const WitnessV0ScriptHash& id) const
+    {
+        return witness(bech32::Encoding::BECH32, 0, id.begin(), id.end());
+    }
+
+    std::string operator()(const WitnessV1Taproot& tap) const
+    {
+        return witness(bech32::Encoding::BECH32M, 1, tap.begin(), tap.end());
+    }
+
+    std::string operator()(const WitnessUnknown& id) const
+    {
+        if (id.version < 1 || id.version > 16 || id.length < 2 || id.length > 40) {
+            return {};
+        }
+        return witness(bech32::Encoding::BECH32M, id.version, id.program, id.program + id.length);
+    }
+
+    std::string operator()(const CNoDestination& no) const
+    {
+        return {};
+    }
+
+private:
+    template <typename It>
+    std::string witness(bech32::Encoding encoding, unsigned int version, It begin, It end) const
+    {
+        std::vector<unsigned char> data = {static_cast<unsigned char>(version)};
+        data.reserve(1 + ((end - begin) * 8 + 4) / 5);
+        ConvertBits<8, 5, true>([&](unsigned char c) { data.push_back(c); }, begin, end);
+        return bech32::Encode(encoding, m_params.Bech32HRP(), data);
+    }
+
+    const CChainParams& m_params;
+};
+
+} // namespace
+
+ParserState::ParserState(const std::string& chain, bool debug, bool traceRing)
+    : m_params(CreateChainParams(gArgs, chain)),
+      m_consensus(&ConsensusParams(m_params->NetworkIDString())),
+      m_addressCache(DEFAULT_ADDRESS_CACHE_SIZE),
+      m_results(DEFAULT_PARSE_CACHE_SIZE)
+{
+    const std::string& network = m_params->NetworkIDString();
+    m_chainId = network == CBaseChainParams::MAIN ? 0 : network == CBaseChainParams::TESTNET ? 1 : network == CBaseChainParams::SIGNET ? 2 : 3;
+
+    if (debug) {
+        m_log.vin = m_log.parser_data = m_log.parser = m_log.script = m_log.exo = true;
+        m_log.parser_dex = m_log.spec = m_log.verbose = m_log.parser_readonly = true;
+    }
+    m_log.ring = traceRing;
+
+    // the crowdsale address replaces the Exodus address for the money man on test networks, see ExodusCrowdsaleAddress
+    if (network == CBaseChainParams::MAIN) {
+        m_exodusScript = scriptForPKHashAddress(EXODUS_MAINNET);
+        m_crowdsaleScript = m_exodusScript;
+        m_crowdsaleHeight = std::numeric_limits<int>::max();
+    } else {
+        m_exodusScript = scriptForPKHashAddress(EXODUS_TESTNET);
+        m_crowdsaleScript = scriptForPKHashAddress(MONEYMAN);
+        m_crowdsaleHeight = network == CBaseChainParams::REGTEST ? MONEYMAN_REGTEST_BLOCK : MONEYMAN_TESTNET_BLOCK;
+    }
+    ExtractDestination(m_exodusScript, m_exodusDest);
+
+    std::vector<CScript> patterns{m_exodusScript};
+    if (m_crowdsaleScript != m_exodusScript) patterns.push_back(m_crowdsaleScript);
+    m_prefilter = std::make_unique<const OmniPrefilter>(patterns);
+}
+
+ParserState::~ParserState() = default;
+
+bool ParserState::IsAllowedInputType(TxoutType type, int nBlock) const
+{
+    switch (type) {
+    case TxoutType::PUBKEYHASH:
+        return m_consensus->PUBKEYHASH_BLOCK <= nBlock;
+    case TxoutType::SCRIPTHASH:
+        return m_consensus->SCRIPTHASH_BLOCK <= nBlock;
+    default:
+        return false;
+    }
+}
+
+bool ParserState::IsAllowedOutputType(TxoutType type, int nBlock) const
+{
+    switch (type) {
+    case TxoutType::PUBKEYHASH:
+        return m_consensus->PUBKEYHASH_BLOCK <= nBlock;
+    case TxoutType::SCRIPTHASH:
+        return m_consensus->SCRIPTHASH_BLOCK <= nBlock;
+    case TxoutType::MULTISIG:
+        return m_consensus->MULTISIG_BLOCK <= nBlock;
+    case TxoutType::NULL_DATA:
+        return m_consensus->NULLDATA_BLOCK <= nBlock;
+    default:
+        return false;
+    }
+}
+
+int ParserState::RulesEpoch(int nBlock) const
+{
+    // the heights at which one of them changes its answer, the number passed tells which ones
+    const int heights[] = {m_consensus->PUBKEYHASH_BLOCK, m_consensus->SCRIPTHASH_BLOCK, m_consensus->MULTISIG_BLOCK, m_consensus->NULLDATA_BLOCK, m_crowdsaleHeight};
+    int epoch = 0;
+    for (int height : heights) {
+        if (height <= nBlock) ++epoch;
+    }
+    return epoch;
+}
+
+bool ParserState::IsTransactionTypeAllowed(int nBlock, uint32_t property, uint16_t type, uint16_t version) const
+{
+    for (const TransactionRestriction& entry : m_consensus->GetRestrictions()) {
+        if (entry.txType != type || entry.txVersion != version) continue;
+        // a property identifier of 0 (= BTC) may be used as wildcard
+        if (OMNI_PROPERTY_BTC == property && !entry.allowWildcard) continue;
+        // transactions are not restricted in the test ecosystem
+        if (isTestEcosystemProperty(property)) return true;
+        if (nBlock >= entry.activationBlock) return true;
+    }
+    return false;
+}
+
+bool ParserState::IsFeatureActivated(uint16_t feature, int nBlock) const
+{
+    // the heights of the params, an activation tx of a later feature isn't applied to them
+    switch (feature) {
+    case FEATURE_SPCROWDCROSSOVER:
+        return nBlock >= m_consensus->SPCROWDCROSSOVER_FEATURE_BLOCK;
+    case FEATURE_NONFUNGIBLE:
+        return nBlock >= m_consensus->MSC_NONFUNGIBLE_BLOCK;
+    default:
+        return false;
+    }
+}
+
+int ParserState::GetEncodingClass(const CTransaction& tx, int nBlock) const
+{
+    bool hasExodus = false;
+    bool hasMultisig = false;
+    bool hasOpReturn = false;
+    bool hasMoney = false;
+
+    const CScript& crowdsale = ExodusCrowdsaleScript(nBlock);
+    for (const CTxOut& output : tx.vout) {
+        TxoutType outType;
+        if (!GetOutputType(output.scriptPubKey, outType)) {
+            continue;
+        }
+        if (!IsAllowedOutputType(outType, nBlock)) {
+            continue;
+        }
+
+        if (outType == TxoutType::PUBKEYHASH) {
+            if (output.scriptPubKey == m_exodusScript) hasExodus = true;
+            if (output.scriptPubKey == crowdsale) hasMoney = true;
+        }
+        if (outType == TxoutType::MULTISIG) {
+            hasMultisig = true;
+        }
+        if (outType == TxoutType::NULL_DATA) {
+            // ensure there is a payload, and the first pushed element equals, or starts with the "omni" marker
+            // the pushes are read in place, not hex encoded and decoded again
+            std::vector<Span<const unsigned char>> scriptPushes;
+            if (!GetScriptPushSpans(output.scriptPubKey, scriptPushes) || scriptPushes.empty()) {
+                continue;
+            }
+            Span<const unsigned char> pushed = scriptPushes[0];
+            if (pushed.size() < sizeof(OMNI_MARKER)) {
+                continue;
+            }
+            if (std::equal(std::begin(OMNI_MARKER), std::end(OMNI_MARKER), pushed.begin())) {
+                hasOpReturn = true;
+            }
+        }
+    }
+
+    if (hasOpReturn) return OMNI_CLASS_C;
+    if (hasExodus && hasMultisig) return OMNI_CLASS_B;
+    if (hasExodus || hasMoney) return OMNI_CLASS_A;
+    return NO_MARKER;
+}
+
+std::string ParserState::EncodeDestination(const CTxDestination& dest) const
+{
+    return std::visit(DestinationEncoder(*m_params), dest);
+}
+
+bool ParserState::DecodeAddress(const std::string& address, CScript& scriptPubKey) const
+{
+    std::vector<unsigned char> data;
+    if (!DecodeBase58Check(address, data, 21)) return false;
+    const std::vector<unsigned char>& pubkeyPrefix = m_params->Base58Prefix(CChainParams::PUBKEY_ADDRESS);
+    const std::vector<unsigned char>& scriptPrefix = m_params->Base58Prefix(CChainParams::SCRIPT_ADDRESS);
+    auto hash = [&](const std::vector<unsigned char>& prefix) {
+        return uint160(Span<const unsigned char>(data).subspan(prefix.size()));
+    };
+    if (data.size() == 20 + pubkeyPrefix.size() && std::equal(pubkeyPrefix.begin(), pubkeyPrefix.end(), data.begin())) {
+        scriptPubKey = GetScriptForDestination(PKHash(hash(pubkeyPrefix)));
+        return true;
+    }
+    if (data.size() == 20 + scriptPrefix.size() && std::equal(scriptPrefix.begin(), scriptPrefix.end(), data.begin())) {
+        scriptPubKey = GetScriptForDestination(ScriptHash(hash(scriptPrefix)));
+        return true;
+    }
+    return false;
+}
+
+bool ParserState::DecodePayloadAddress(Span<const unsigned char> bytes, CScript& scriptPubKey) const
+{
+    if (bytes.size() != 21) return false;
+    uint160 hash(bytes.subspan(1));
+    if (bytes[0] == m_params->Base58Prefix(CChainParams::PUBKEY_ADDRESS)[0]) {
+        scriptPubKey = GetScriptForDestination(PKHash(hash));
+        return true;
+    }
+    if (bytes[0] == m_params->Base58Prefix(CChainParams::SCRIPT_ADDRESS)[0]) {
+        scriptPubKey = GetScriptForDestination(ScriptHash(hash));
+        return true;
+    }
+    return false;
+}
+
+bool ParserState::EncodeAddress(const CScript& scriptPubKey, std::string& address) const
+{
+    return m_addressCache.Get(m_chainId, AddressCache::BITCOIN, scriptPubKey, address, [&](std::string& encoded) {
+        CTxDestination dest;
+        if (!ExtractDestination(scriptPubKey, dest)) return false;
+        encoded = EncodeDestination(dest);
+        return true;
+    });
+}
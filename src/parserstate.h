@@ -0,0 +1,187 @@
+#pragma once
+
+#include "addresscache.h"
+#include "balances.h"
+#include "metrics.h"
+#include "parsecache.h"
+#include "prefilter.h"
+#include "prevoutstore.h"
+#include "trace.h"
+#include "watchlist.h"
+#include <memory>
+#include <omnicore/log.h>
+#include <script/script.h>
+#include <script/standard.h>
+#include <string>
+
+class CChainParams;
+class CTransaction;
+namespace mastercore {
+class CConsensusParams;
+}
+
+//! Parser traces written to the omnicore log, the per context counterpart of the msc_debug_* flags
+struct ParserLog {
+    bool vin = false;
+    bool parser_data = false;
+    bool parser = false;
+    bool script = false;
+    bool exo = false;
+    bool parser_dex = false;
+    bool spec = false;
+    bool verbose = false;
+    bool parser_readonly = false;
+    //! trace to the calling thread's TraceRing instead of the omnicore log
+    bool ring = false;
+};
+
+/**
+ * Everything a parse reads that depends on the chain or on the configuration, behind a
+ * ParserContext.
+ *
+ * The network dependent pieces of omnicore that the parser used (Params(), ExodusAddress(),
+ * GetEncodingClass, IsAllowedInputType/OutputType, EncodeDestination) all read the process
+ * wide network selected by SelectParams; this class holds its own copies built from its own
+ * CChainParams. It is immutable after construction, except for the address cache, the metrics,
+ * the result cache, the prevout store and the balance engine, which synchronize themselves, and
+ * for setting the prevout store, the balance engine and the watchlist.
+ */
+class ParserState
+{
+public:
+    //! chain: main, test, signet, regtest; throws std::runtime_error for an unknown chain
+    ParserState(const std::string& chain, bool debug, bool traceRing);
+    ~ParserState();
+
+    const CChainParams& Params() const
+    {
+        return *m_params;
+    }
+    const ParserLog& Log() const
+    {
+        return m_log;
+    }
+    const OmniPrefilter& Prefilter() const
+    {
+        return *m_prefilter;
+    }
+    AddressCache& Addresses() const
+    {
+        return m_addressCache;
+    }
+    ParseMetrics& Metrics() const
+    {
+        return m_metrics;
+    }
+    ParseCache& Results() const
+    {
+        return m_results;
+    }
+    //! Prevout store, null if none was opened
+    PrevoutStore* Prevouts() const
+    {
+        return m_prevouts.get();
+    }
+    //! Base of the coins view of a parse, resolving the prevouts the input doesn't carry
+    CCoinsView& CoinsBase() const
+    {
+        return m_prevouts ? *m_prevouts : m_noCoins;
+    }
+    //! Not thread safe, the context can't be parsing
+    void SetPrevoutStore(std::unique_ptr<PrevoutStore> prevouts)
+    {
+        m_prevouts = std::move(prevouts);
+    }
+    //! Balance engine that ParseBlock and ParseBlockFiles apply blocks to, null if none was opened
+    BalanceEngine* Balances() const
+    {
+        return m_balances.get();
+    }
+    //! Not thread safe, the context can't be parsing
+    void SetBalances(std::unique_ptr<BalanceEngine> balances)
+    {
+        m_balances = std::move(balances);
+    }
+    //! What the watch stage of parseTx lets through, see Watchlist
+    const Watchlist& Watched() const
+    {
+        return m_watchlist;
+    }
+    //! Not thread safe, the context can't be parsing; cached results go, they were filtered by the old list
+    Watchlist& EditWatchlist()
+    {
+        m_results.Clear();
+        return m_watchlist;
+    }
+    //! Target of PARSER_TRACE
+    template <typename... Args>
+    void Trace(TraceCategory category, const char* fmt, const Args&... args) const
+    {
+        if (m_log.ring) {
+            TraceRing::Local().Write(category, fmt, args...);
+        } else {
+            PrintToLog(fmt, args...);
+        }
+    }
+
+    //! Part of the address cache keys
+    uint8_t ChainId() const
+    {
+        return m_chainId;
+    }
+
+    const CScript& ExodusScript() const
+    {
+        return m_exodusScript;
+    }
+    //! Destination of ExodusScript(), outputs are matched against it without encoding their address
+    const CTxDestination& ExodusDestination() const
+    {
+        return m_exodusDest;
+    }
+    //! ExodusCrowdsaleAddress(nBlock) of this chain, as script
+    const CScript& ExodusCrowdsaleScript(int nBlock) const
+    {
+        return nBlock >= m_crowdsaleHeight ? m_crowdsaleScript : m_exodusScript;
+    }
+
+    //! mastercore::GetEncodingClass with this chain's Exodus addresses and activation heights
+    int GetEncodingClass(const CTransaction& tx, int nBlock) const;
+    bool IsAllowedInputType(TxoutType type, int nBlock) const;
+    bool IsAllowedOutputType(TxoutType type, int nBlock) const;
+    //! Heights of one epoch get the same answers from the three above, see ParseCache
+    int RulesEpoch(int nBlock) const;
+    //! mastercore::IsTransactionTypeAllowed with this chain's restrictions, property 1 or 2 stands for its ecosystem
+    bool IsTransactionTypeAllowed(int nBlock, uint32_t property, uint16_t type, uint16_t version) const;
+    //! mastercore::IsFeatureActivated by this chain's params, for the features the balance engine checks; false for others
+    bool IsFeatureActivated(uint16_t feature, int nBlock) const;
+
+    //! EncodeDestination with this chain's prefixes
+    std::string EncodeDestination(const CTxDestination& dest) const;
+    //! Address of a scriptPubKey through the address cache, false if it has none
+    bool EncodeAddress(const CScript& scriptPubKey, std::string& address) const;
+    //! scriptPubKey of a base58 P2PKH or P2SH address of this chain, the only types Omni senders and references have
+    bool DecodeAddress(const std::string& address, CScript& scriptPubKey) const;
+    //! scriptPubKey of an address a payload carries, the version byte and hash160 of this chain's base58 address
+    bool DecodePayloadAddress(Span<const unsigned char> bytes, CScript& scriptPubKey) const;
+
+private:
+    std::unique_ptr<const CChainParams> m_params;
+    const mastercore::CConsensusParams* m_consensus;
+    uint8_t m_chainId;
+    ParserLog m_log;
+
+    CScript m_exodusScript;
+    CTxDestination m_exodusDest;
+    CScript m_crowdsaleScript;
+    int m_crowdsaleHeight;
+
+    std::unique_ptr<const OmniPrefilter> m_prefilter;
+    mutable AddressCache m_addressCache;
+    mutable ParseMetrics m_metrics;
+    mutable ParseCache m_results;
+    Watchlist m_watchlist;
+    std::unique_ptr<PrevoutStore> m_prevouts;
+    std::unique_ptr<BalanceEngine> m_balances;
+    mutable CCoinsView m_noCoins;
+};
@@ -0,0 +1,177 @@
+#include "payload.h"
+#include "hex.h"
+#include <algorithm>
+#include <assert.h>
+#include <crypto/common.h>
+#include <cstring>
+#include <omnicore/log.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/tx.h>
+#include <script/script.h>
+
+using namespace mastercore;
+
+bool GetScriptPushSpans(const CScript& script, std::vector<Span<const unsigned char>>& vRet, bool fSkipFirst)
+{
+    int count = 0;
+    CScript::const_iterator pc = script.begin();
+
+    while (pc < script.end()) {
+        opcodetype opcode;
+        CScript::const_iterator begin = pc;
+        if (!script.GetOp(pc, opcode)) {
+            return false;
+        }
+        if (0x00 <= opcode && opcode <= OP_PUSHDATA4) {
+            if (count++ || !fSkipFirst) {
+                // the pushed data is the tail of the instruction, after the opcode and length
+                size_t header = 1;
+                if (opcode == OP_PUSHDATA1) header += 1;
+                if (opcode == OP_PUSHDATA2) header += 2;
+                if (opcode == OP_PUSHDATA4) header += 4;
+                vRet.emplace_back(&*begin + header, pc - begin - header);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool IsClassADataPacket(Span<const unsigned char> push)
+{
+    static const unsigned char zeros[7] = {};
+    return push.size() >= 9 && memcmp(push.data() + 1, zeros, sizeof(zeros)) == 0 && (push[8] == 1 || push[8] == 2);
+}
+
+bool GetClassCPushSpans(const CScript& script, std::vector<Span<const unsigned char>>& vRet)
+{
+    size_t first = vRet.size();
+    if (!GetScriptPushSpans(script, vRet) || vRet.size() == first || vRet[first].size() < sizeof(OMNI_MARKER) ||
+        memcmp(vRet[first].data(), OMNI_MARKER, sizeof(OMNI_MARKER)) != 0) {
+        vRet.resize(first);
+        return false;
+    }
+    vRet[first] = vRet[first].subspan(sizeof(OMNI_MARKER));
+    return true;
+}
+
+unsigned int ConcatClassCPayload(Span<const Span<const unsigned char>> pushes, unsigned char* packet)
+{
+    unsigned int size = 0;
+    for (const Span<const unsigned char>& push : pushes) {
+        if (push.empty()) continue;
+        unsigned int copied = push.size();
+        if (size + copied > MAX_PACKETS * PACKET_SIZE) {
+            copied = MAX_PACKETS * PACKET_SIZE - size;
+            PrintToLog("limiting payload size to %d byte\n", size + copied);
+        }
+        if (copied > 0) {
+            memcpy(packet + size, push.data(), copied);
+            size += copied;
+        }
+        if (MAX_PACKETS * PACKET_SIZE == size) {
+            break;
+        }
+    }
+    return size;
+}
+
+void PrepareObfuscatedHashes(const std::string& strSeed, unsigned int hashCount, unsigned char (*hashes)[CSHA256::OUTPUT_SIZE])
+{
+    char hexHash[2 * CSHA256::OUTPUT_SIZE];
+
+    if (hashCount == 0) return;
+    CSHA256().Write(reinterpret_cast<const unsigned char*>(strSeed.data()), strSeed.size()).Finalize(hashes[0]);
+    for (unsigned int j = 1; j < hashCount; ++j) {
+        EncodeHex(hashes[j - 1], hexHash, true);
+        CSHA256().Write(reinterpret_cast<const unsigned char*>(hexHash), sizeof(hexHash)).Finalize(hashes[j]);
+    }
+}
+
+void DeobfuscateClassB(const std::string& strSender, Span<const Span<const unsigned char>> pubkeys, unsigned char* packets)
+{
+    assert(pubkeys.size() <= MAX_PACKETS);
+    assert(pubkeys.size() <= MAX_SHA256_OBFUSCATION_TIMES);
+
+    unsigned char hashes[MAX_PACKETS][CSHA256::OUTPUT_SIZE];
+    PrepareObfuscatedHashes(strSender, pubkeys.size(), hashes);
+
+    // gather data and masks into flat buffers, so the xor runs as one vectorizable loop over all packets
+    unsigned char masks[MAX_PACKETS * PACKET_SIZE];
+    for (size_t k = 0; k < pubkeys.size(); ++k) {
+        const Span<const unsigned char>& pubkey = pubkeys[k];
+        size_t size = pubkey.size() > 1 ? std::min<size_t>(PACKET_SIZE, pubkey.size() - 1) : 0;
+        if (size) memcpy(packets + k * PACKET_SIZE, pubkey.data() + 1, size);
+        memset(packets + k * PACKET_SIZE + size, 0, PACKET_SIZE - size);
+        memcpy(masks + k * PACKET_SIZE, hashes[k], PACKET_SIZE);
+    }
+
+    size_t total = pubkeys.size() * PACKET_SIZE;
+    for (size_t i = 0; i < total; ++i) {
+        packets[i] ^= masks[i];
+    }
+}
+
+unsigned int GetPayloadProperties(Span<const unsigned char> payload, uint32_t properties[2])
+{
+    // version and type, then the property for all of the types below
+    if (payload.size() < 8) return 0;
+    unsigned int version = payload[0] << 8 | payload[1];
+    unsigned int type = payload[2] << 8 | payload[3];
+    auto second = [&](size_t offset) {
+        if (payload.size() < offset + 4) return 1u;
+        properties[1] = ReadBE32(payload.data() + offset);
+        return 2u;
+    };
+
+    properties[0] = ReadBE32(payload.data() + 4);
+    switch (type) {
+    case MSC_TYPE_SIMPLE_SEND:
+    case MSC_TYPE_RESTRICTED_SEND:
+    case MSC_TYPE_SEND_NONFUNGIBLE:
+    case MSC_TYPE_SEND_TO_MANY:
+    case MSC_TYPE_TRADE_OFFER:
+    case MSC_TYPE_ACCEPT_OFFER_BTC:
+    case MSC_TYPE_CLOSE_CROWDSALE:
+    case MSC_TYPE_GRANT_PROPERTY_TOKENS:
+    case MSC_TYPE_REVOKE_PROPERTY_TOKENS:
+    case MSC_TYPE_CHANGE_ISSUER_ADDRESS:
+    case MSC_TYPE_ENABLE_FREEZING:
+    case MSC_TYPE_DISABLE_FREEZING:
+    case MSC_TYPE_ADD_DELEGATE:
+    case MSC_TYPE_REMOVE_DELEGATE:
+    case MSC_TYPE_FREEZE_PROPERTY_TOKENS:
+    case MSC_TYPE_UNFREEZE_PROPERTY_TOKENS:
+    case MSC_TYPE_NONFUNGIBLE_DATA:
+        return 1;
+    case MSC_TYPE_SEND_TO_OWNERS:
+        // version 1 pays out in a property of its own, after the amount
+        return version >= 1 ? second(16) : 1;
+    case MSC_TYPE_METADEX_TRADE:
+    case MSC_TYPE_METADEX_CANCEL_PRICE:
+        return second(16); // property desired, after the amount for sale
+    case MSC_TYPE_METADEX_CANCEL_PAIR:
+        return second(8);
+    default:
+        return 0;
+    }
+}
+
+uint8_t GetPayloadEcosystem(Span<const unsigned char> payload)
+{
+    // version and type, then the ecosystem
+    if (payload.size() < 5) return 0;
+    unsigned int type = payload[2] << 8 | payload[3];
+    switch (type) {
+    case MSC_TYPE_SEND_ALL:
+    case MSC_TYPE_METADEX_CANCEL_ECOSYSTEM:
+        return payload[4];
+    default:
+        return 0;
+    }
+}
+
+uint8_t GetPropertyEcosystem(uint32_t property)
+{
+    return property == OMNI_PROPERTY_TMSC || property >= TEST_ECO_PROPERTY_1 ? OMNI_PROPERTY_TMSC : OMNI_PROPERTY_MSC;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <crypto/sha256.h>
+#include <cstdint>
+#include <span.h>
+#include <string>
+#include <vector>
+
+class CScript;
+
+/**
+ * Byte level counterparts of the omnicore helpers used to extract Omni payloads.
+ * They produce the same bytes as the hex string based originals, without the
+ * hex round trips.
+ */
+
+//! Like GetScriptPushes, but collecting views of the pushed data; the script has to outlive them
+bool GetScriptPushSpans(const CScript& script, std::vector<Span<const unsigned char>>& vRet, bool fSkipFirst = false);
+
+//! Marker at the start of the first push of a Class C output, the bytes of GetOmMarker()
+static constexpr unsigned char OMNI_MARKER[] = {0x6f, 0x6d, 0x6e, 0x69}; // "omni"
+
+/**
+ * Class A: whether push, the data of an output, is a data packet, with bytes 1...8 being
+ * 00...01 or 00...02; push[0] is the sequence number of every Class A output.
+ */
+bool IsClassADataPacket(Span<const unsigned char> push);
+
+/**
+ * Class C: appends the pushes of an OP_RETURN script tagged with OMNI_MARKER to vRet, the first
+ * one with the marker stripped. Returns false and leaves vRet as it was for other scripts.
+ */
+bool GetClassCPushSpans(const CScript& script, std::vector<Span<const unsigned char>>& vRet);
+
+/**
+ * Class C: concatenates pushes into packet, up to MAX_PACKETS * PACKET_SIZE bytes, and returns
+ * the size of the payload.
+ */
+unsigned int ConcatClassCPayload(Span<const Span<const unsigned char>> pushes, unsigned char* packet);
+
+//! Binary PrepareObfuscatedHashes: hashes[0] is SHA256(seed), hashes[j] is SHA256 of the uppercase hex of hashes[j-1]
+void PrepareObfuscatedHashes(const std::string& strSeed, unsigned int hashCount, unsigned char (*hashes)[CSHA256::OUTPUT_SIZE]);
+
+/**
+ * Deobfuscates Class B packets: packet k is bytes 1...PACKET_SIZE of pubkeys[k] xor'ed with the
+ * k-th hash of the sender's chain. packets has to hold pubkeys.size() * PACKET_SIZE bytes.
+ */
+void DeobfuscateClassB(const std::string& strSender, Span<const Span<const unsigned char>> pubkeys, unsigned char* packets);
+
+/**
+ * Properties named in the first bytes of a payload, before interpret_Transaction: the property
+ * of sends, DEx offers and accepts, grants, revokes, freezes and issuer changes, and both sides
+ * of MetaDEx trades and cancels. Returns how many it put into properties, 0 for other types,
+ * such as property creation or send-all, and for payloads too short to tell.
+ */
+unsigned int GetPayloadProperties(Span<const unsigned char> payload, uint32_t properties[2]);
+
+/**
+ * Ecosystem of a payload that names no property but may move any property of the ecosystem:
+ * send-all and the MetaDEx cancel of an ecosystem. 0 for other types and payloads too short.
+ */
+uint8_t GetPayloadEcosystem(Span<const unsigned char> payload);
+
+//! Ecosystem of a property, 1 (main) or 2 (test), as isTestEcosystemProperty tells them apart
+uint8_t GetPropertyEcosystem(uint32_t property);
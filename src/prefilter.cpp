@@ -0,0 +1,107 @@
+#include "prefilter.h"
+#include <omnicore/omnicore.h>
+#include <omnicore/script.h>
+#include <script/script.h>
+#include <util/strencodings.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+using namespace mastercore;
+
+// hex digits only differ in bit 0x20 between upper and lower case, digits have it set anyway
+static inline unsigned char foldByte(unsigned char c, unsigned char fold)
+{
+    return c | fold;
+}
+
+static inline bool matchAt(const unsigned char* p, const unsigned char* pattern, size_t n, unsigned char fold)
+{
+    for (size_t i = 0; i < n; ++i) {
+        if (foldByte(p[i], fold) != pattern[i]) return false;
+    }
+    return true;
+}
+
+/**
+ * Searches pattern in data, comparing data bytes OR'ed with fold.
+ *
+ * The vector loop compares 16 positions at once against the first and the last byte
+ * of the pattern and only verifies the positions where both match.
+ */
+static bool contains(const unsigned char* data, size_t len, const unsigned char* pattern, size_t n, unsigned char fold)
+{
+    if (n == 0 || len < n) return false;
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[n - 1]);
+    const __m128i mask = _mm_set1_epi8(fold);
+    for (; i + n - 1 + 16 <= len; i += 16) {
+        __m128i blockFirst = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), mask);
+        __m128i blockLast = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + n - 1)), mask);
+        unsigned int bits = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last)));
+        while (bits) {
+            if (matchAt(data + i + __builtin_ctz(bits), pattern, n, fold)) return true;
+            bits &= bits - 1;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t first = vdupq_n_u8(pattern[0]);
+    const uint8x16_t last = vdupq_n_u8(pattern[n - 1]);
+    const uint8x16_t mask = vdupq_n_u8(fold);
+    for (; i + n - 1 + 16 <= len; i += 16) {
+        uint8x16_t blockFirst = vorrq_u8(vld1q_u8(data + i), mask);
+        uint8x16_t blockLast = vorrq_u8(vld1q_u8(data + i + n - 1), mask);
+        uint8x16_t eq = vandq_u8(vceqq_u8(blockFirst, first), vceqq_u8(blockLast, last));
+        // narrow to 4 bits per byte lane
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (bits) {
+            unsigned int lane = __builtin_ctzll(bits) >> 2;
+            if (matchAt(data + i + lane, pattern, n, fold)) return true;
+            bits &= ~(0xFULL << (lane * 4));
+        }
+    }
+#endif
+    for (; i + n <= len; ++i) {
+        if (matchAt(data + i, pattern, n, fold)) return true;
+    }
+    return false;
+}
+
+OmniPrefilter::OmniPrefilter(const std::vector<CScript>& exodusScripts)
+{
+    std::vector<std::vector<unsigned char>> patterns;
+    patterns.push_back(GetOmMarker());
+    for (const CScript& script : exodusScripts) {
+        patterns.emplace_back(script.begin(), script.end());
+    }
+
+    for (const auto& pattern : patterns) {
+        m_hexPatterns.push_back(HexStr(pattern));
+    }
+    m_patterns = std::move(patterns);
+}
+
+bool OmniPrefilter::Check(Span<const unsigned char> txBytes) const
+{
+    for (const auto& pattern : m_patterns) {
+        if (contains(txBytes.data(), txBytes.size(), pattern.data(), pattern.size(), 0)) return true;
+    }
+    return false;
+}
+
+bool OmniPrefilter::CheckHex(Span<const char> hexTx) const
+{
+    // a match at an odd offset is not aligned to a byte, which only costs a false positive
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(hexTx.data());
+    for (const auto& pattern : m_hexPatterns) {
+        const unsigned char* hexPattern = reinterpret_cast<const unsigned char*>(pattern.data());
+        if (contains(data, hexTx.size(), hexPattern, pattern.size(), 0x20)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <span.h>
+#include <string>
+#include <vector>
+
+class CScript;
+
+/**
+ * Rejects transactions that can't be Omni transactions by scanning the serialized
+ * transaction, before it is decoded.
+ *
+ * Every transaction GetEncodingClass accepts carries either an OP_RETURN push starting
+ * with the "omni" marker (class C) or an output to the Exodus (or crowdsale) address
+ * (class A, and class B, which adds bare multisig outputs to it). The serialization of
+ * such a transaction therefore contains the marker or the Exodus script verbatim. A tx
+ * without any of them is definitely not Omni, a tx with one of them is only a candidate.
+ */
+class OmniPrefilter
+{
+public:
+    //! Patterns are the "omni" marker and the given Exodus (and crowdsale) scripts of the chain
+    explicit OmniPrefilter(const std::vector<CScript>& exodusScripts);
+
+    //! Returns false if the serialized tx definitely isn't an Omni transaction
+    bool Check(Span<const unsigned char> txBytes) const;
+    //! Same as Check, for the hex encoded tx (either case)
+    bool CheckHex(Span<const char> hexTx) const;
+
+private:
+    std::vector<std::vector<unsigned char>> m_patterns;
+    std::vector<std::string> m_hexPatterns;
+};
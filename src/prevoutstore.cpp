@@ -0,0 +1,60 @@
+#include "prevoutstore.h"
+#include <primitives/block.h>
+
+static constexpr uint8_t DB_PREVOUT{'p'};
+static constexpr uint8_t DB_HEIGHT{'H'};
+static constexpr uint8_t DB_SPENT{'s'};
+
+PrevoutStore::PrevoutStore(const fs::path& path, size_t cacheBytes, bool memoryOnly)
+    : m_db(path, cacheBytes, memoryOnly)
+{
+}
+
+bool PrevoutStore::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    return m_db.Read(std::make_pair(DB_PREVOUT, outpoint), coin);
+}
+
+bool PrevoutStore::HaveCoin(const COutPoint& outpoint) const
+{
+    return m_db.Exists(std::make_pair(DB_PREVOUT, outpoint));
+}
+
+void PrevoutStore::ConnectBlock(const CBlock& block, int height)
+{
+    // spends of the height, those of an abandoned block at it included, which a reorg leaves
+    std::vector<COutPoint> spent;
+    m_db.Read(std::make_pair(DB_SPENT, height), spent);
+
+    CDBBatch batch(m_db);
+    for (const auto& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txIn : tx->vin) {
+                spent.push_back(txIn.prevout);
+            }
+        }
+        const uint256& txid = tx->GetHash();
+        for (uint32_t n = 0; n < tx->vout.size(); ++n) {
+            if (tx->vout[n].scriptPubKey.IsUnspendable()) continue;
+            batch.Write(std::make_pair(DB_PREVOUT, COutPoint(txid, n)), Coin(tx->vout[n], height, tx->IsCoinBase()));
+        }
+    }
+    batch.Write(std::make_pair(DB_SPENT, height), spent);
+
+    // the spends that have left the window go for good
+    std::vector<COutPoint> expired;
+    if (m_db.Read(std::make_pair(DB_SPENT, height - SPENT_WINDOW), expired)) {
+        for (const COutPoint& outpoint : expired) {
+            batch.Erase(std::make_pair(DB_PREVOUT, outpoint));
+        }
+        batch.Erase(std::make_pair(DB_SPENT, height - SPENT_WINDOW));
+    }
+    batch.Write(DB_HEIGHT, height);
+    m_db.WriteBatch(batch);
+}
+
+int PrevoutStore::Height() const
+{
+    int height;
+    return m_db.Read(DB_HEIGHT, height) ? height : -1;
+}
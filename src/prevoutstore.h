@@ -0,0 +1,38 @@
+#pragma once
+
+#include <coins.h>
+#include <dbwrapper.h>
+#include <fs.h>
+
+class CBlock;
+
+/**
+ * Outputs of the blocks a context parsed, in LevelDB, as the source of the prevouts that a
+ * RawTx leaves out.
+ *
+ * ParseBlock connects every block it parsed: new outputs are added, in one write batch per
+ * block. Outputs a block spends stay for SPENT_WINDOW more blocks before they are erased, so a
+ * tx parsed again once its block was connected, on confirmation or after a reorg of up to that
+ * depth, still finds its prevouts. Blocks have to be connected in chain order; a reorg connects
+ * the new branch from the fork on, which overwrites outputs and adds the spends of the new
+ * blocks to those of the height. Reads and connects may run concurrently, as LevelDB's do.
+ */
+class PrevoutStore : public CCoinsView
+{
+public:
+    //! Blocks the outputs spent by a block are kept for after it
+    static constexpr int SPENT_WINDOW = 100;
+
+    //! path: database directory, created if missing; cacheBytes: LevelDB cache and write buffer
+    PrevoutStore(const fs::path& path, size_t cacheBytes, bool memoryOnly = false);
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override;
+    bool HaveCoin(const COutPoint& outpoint) const override;
+
+    void ConnectBlock(const CBlock& block, int height);
+    //! Height of the last block connected, -1 before the first
+    int Height() const;
+
+private:
+    CDBWrapper m_db;
+};
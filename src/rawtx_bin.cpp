@@ -0,0 +1,140 @@
+#include "rawtx_bin.h"
+#include <crypto/common.h>
+#include <cstring>
+#include <tinyformat.h>
+
+namespace {
+
+//! Bounds checked cursor over a binary RawTx
+class BinReader
+{
+public:
+    explicit BinReader(Span<const unsigned char> data) : m_data(data) {}
+
+    bool Read32(uint32_t& out)
+    {
+        if (!has(4)) return false;
+        out = ReadLE32(m_data.data() + m_pos);
+        m_pos += 4;
+        return true;
+    }
+
+    bool Read64(uint64_t& out)
+    {
+        if (!has(8)) return false;
+        out = ReadLE64(m_data.data() + m_pos);
+        m_pos += 8;
+        return true;
+    }
+
+    bool ReadBytes(size_t size, Span<const unsigned char>& out)
+    {
+        if (!has(size)) return false;
+        out = m_data.subspan(m_pos, size);
+        m_pos += size;
+        return true;
+    }
+
+    //! u32 size followed by that many bytes
+    bool ReadSized(Span<const unsigned char>& out)
+    {
+        uint32_t size;
+        return Read32(size) && ReadBytes(size, out);
+    }
+
+    size_t Pos() const
+    {
+        return m_pos;
+    }
+
+    bool AtEnd() const
+    {
+        return m_pos == m_data.size();
+    }
+
+private:
+    bool has(size_t size) const
+    {
+        return m_data.size() - m_pos >= size;
+    }
+
+    Span<const unsigned char> m_data;
+    size_t m_pos{0};
+};
+
+void write32(std::vector<unsigned char>& data, uint32_t value)
+{
+    size_t pos = data.size();
+    data.resize(pos + 4);
+    WriteLE32(data.data() + pos, value);
+}
+
+void write64(std::vector<unsigned char>& data, uint64_t value)
+{
+    size_t pos = data.size();
+    data.resize(pos + 8);
+    WriteLE64(data.data() + pos, value);
+}
+
+} // namespace
+
+bool ReadRawTxBin(Span<const unsigned char> data, RawTxBinView& rawTx, std::string& error)
+{
+    rawTx.prevouts.clear();
+
+    if (data.empty() || data[0] != RAWTX_BIN_VERSION) {
+        error = "unknown binary RawTx version";
+        return false;
+    }
+
+    BinReader reader(data.subspan(1));
+    uint32_t height, time, idx, count;
+    if (!reader.Read32(height) || !reader.Read32(time) || !reader.Read32(idx) || !reader.ReadSized(rawTx.tx) || !reader.Read32(count)) {
+        error = strprintf("truncated binary RawTx at offset %u", 1 + reader.Pos());
+        return false;
+    }
+    rawTx.height = height;
+    rawTx.time = time;
+    rawTx.idx = idx;
+
+    for (uint32_t n = 0; n < count; ++n) {
+        PrevoutView prevout;
+        Span<const unsigned char> txid;
+        if (!reader.ReadBytes(32, txid) || !reader.Read32(prevout.vout) || !reader.Read64(prevout.value) || !reader.Read32(prevout.height) || !reader.ReadSized(prevout.scriptPubKey)) {
+            error = strprintf("truncated prevout #%u at offset %u", n, 1 + reader.Pos());
+            return false;
+        }
+        std::memcpy(prevout.txid.begin(), txid.data(), 32);
+        rawTx.prevouts.push_back(prevout);
+    }
+
+    if (!reader.AtEnd()) {
+        error = strprintf("trailing bytes at offset %u", 1 + reader.Pos());
+        return false;
+    }
+    return true;
+}
+
+RawTxBinWriter::RawTxBinWriter(Span<const unsigned char> tx, unsigned int height, unsigned int time, unsigned int idx)
+{
+    m_data.reserve(1 + 4 * 5 + tx.size());
+    m_data.push_back(RAWTX_BIN_VERSION);
+    write32(m_data, height);
+    write32(m_data, time);
+    write32(m_data, idx);
+    write32(m_data, tx.size());
+    m_data.insert(m_data.end(), tx.begin(), tx.end());
+    m_countPos = m_data.size();
+    write32(m_data, 0);
+}
+
+void RawTxBinWriter::AddPrevout(const uint256& txid, uint32_t vout, uint64_t value, uint32_t height, Span<const unsigned char> scriptPubKey)
+{
+    m_data.insert(m_data.end(), txid.begin(), txid.end());
+    write32(m_data, vout);
+    write64(m_data, value);
+    write32(m_data, height);
+    write32(m_data, scriptPubKey.size());
+    m_data.insert(m_data.end(), scriptPubKey.begin(), scriptPubKey.end());
+    WriteLE32(m_data.data() + m_countPos, ++m_count);
+}
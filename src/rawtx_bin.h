@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <span.h>
+#include <string>
+#include <uint256.h>
+#include <vector>
+
+/**
+ * Binary RawTx, the same content as the RawTx json without any hex, all integers little endian:
+ *
+ *   u8  format version (RAWTX_BIN_VERSION)
+ *   u32 height, u32 time, u32 idx
+ *   u32 tx size, serialized tx (with witness data, if any)
+ *   u32 prevout count, then for each prevout:
+ *       32 bytes txid in serialization order (the display hex reversed), u32 vout,
+ *       u64 value, u32 height, u32 script size, scriptPubKey
+ */
+static constexpr uint8_t RAWTX_BIN_VERSION = 1;
+
+//! Prevout of a binary RawTx, the script points into the buffer
+struct PrevoutView {
+    uint256 txid;
+    uint32_t vout;
+    uint64_t value;
+    uint32_t height;
+    Span<const unsigned char> scriptPubKey;
+};
+
+//! Binary RawTx read in place, the caller's buffer has to outlive it
+struct RawTxBinView {
+    Span<const unsigned char> tx;
+    std::vector<PrevoutView> prevouts;
+    // block property
+    unsigned int height;
+    unsigned int time;
+    unsigned int idx;
+};
+
+//! Returns false and sets error if data isn't a complete binary RawTx
+bool ReadRawTxBin(Span<const unsigned char> data, RawTxBinView& rawTx, std::string& error);
+
+//! Builds a binary RawTx, prevouts are appended one by one
+class RawTxBinWriter
+{
+public:
+    RawTxBinWriter(Span<const unsigned char> tx, unsigned int height, unsigned int time, unsigned int idx);
+
+    void AddPrevout(const uint256& txid, uint32_t vout, uint64_t value, uint32_t height, Span<const unsigned char> scriptPubKey);
+
+    const std::vector<unsigned char>& Data() const
+    {
+        return m_data;
+    }
+
+private:
+    std::vector<unsigned char> m_data;
+    size_t m_countPos;
+    uint32_t m_count{0};
+};
@@ -0,0 +1,396 @@
+#include "rawtx_json.h"
+#include "omni.h"
+#include <limits>
+#include <stdexcept>
+#include <tinyformat.h>
+
+namespace {
+
+//! Cursor over a json buffer reading just what the RawTx schema needs
+class JsonReader
+{
+public:
+    JsonReader(std::string_view json, std::deque<std::string>& unescaped) : m_json(json), m_unescaped(unescaped) {}
+
+    std::string error;
+
+    bool Fail(const char* what)
+    {
+        if (error.empty()) error = strprintf("%s at offset %u", what, m_pos);
+        return false;
+    }
+
+    void SkipWhitespace()
+    {
+        while (m_pos < m_json.size()) {
+            char c = m_json[m_pos];
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+            ++m_pos;
+        }
+    }
+
+    bool Consume(char c)
+    {
+        SkipWhitespace();
+        if (m_pos < m_json.size() && m_json[m_pos] == c) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool Expect(char c, const char* what)
+    {
+        return Consume(c) || Fail(what);
+    }
+
+    bool AtEnd()
+    {
+        SkipWhitespace();
+        return m_pos == m_json.size();
+    }
+
+    //! Reads a string, as a view into the buffer unless it contains escape sequences
+    bool ReadString(std::string_view& out)
+    {
+        if (!Expect('"', "expected string")) return false;
+        size_t begin = m_pos;
+        while (m_pos < m_json.size()) {
+            char c = m_json[m_pos];
+            if (c == '"') {
+                out = m_json.substr(begin, m_pos - begin);
+                ++m_pos;
+                return true;
+            }
+            if (c == '\\') return readEscapedString(begin, out);
+            if (static_cast<unsigned char>(c) < 0x20) return Fail("control character in string");
+            ++m_pos;
+        }
+        return Fail("unterminated string");
+    }
+
+    template <typename T>
+    bool ReadUInt(T& out)
+    {
+        SkipWhitespace();
+        size_t begin = m_pos;
+        uint64_t value = 0;
+        while (m_pos < m_json.size() && m_json[m_pos] >= '0' && m_json[m_pos] <= '9') {
+            unsigned int digit = m_json[m_pos] - '0';
+            if (value > (std::numeric_limits<T>::max() - digit) / 10) return Fail("integer out of range");
+            value = value * 10 + digit;
+            ++m_pos;
+        }
+        if (m_pos == begin) return Fail("expected unsigned integer");
+        if (m_json[begin] == '0' && m_pos - begin > 1) return Fail("leading zero");
+        if (m_pos < m_json.size() && (m_json[m_pos] == '.' || m_json[m_pos] == 'e' || m_json[m_pos] == 'E')) return Fail("expected integer");
+        out = static_cast<T>(value);
+        return true;
+    }
+
+    //! Calls fn(key) for every member, fn has to read the value
+    template <typename Fn>
+    bool ReadObject(Fn fn)
+    {
+        if (!Expect('{', "expected object")) return false;
+        if (Consume('}')) return true;
+        do {
+            std::string_view key;
+            if (!ReadString(key)) return false;
+            if (!Expect(':', "expected ':'")) return false;
+            if (!fn(key)) return false;
+        } while (Consume(','));
+        return Expect('}', "expected '}'");
+    }
+
+    //! Calls fn() for every element, fn has to read the element
+    template <typename Fn>
+    bool ReadArray(Fn fn)
+    {
+        if (!Expect('[', "expected array")) return false;
+        if (Consume(']')) return true;
+        do {
+            if (!fn()) return false;
+        } while (Consume(','));
+        return Expect(']', "expected ']'");
+    }
+
+    bool SkipValue(unsigned int depth = 0)
+    {
+        if (depth > MAX_DEPTH) return Fail("nesting too deep");
+        SkipWhitespace();
+        if (m_pos == m_json.size()) return Fail("expected value");
+        std::string_view ignored;
+        switch (m_json[m_pos]) {
+        case '"': return ReadString(ignored);
+        case '{': return ReadObject([&](std::string_view) { return SkipValue(depth + 1); });
+        case '[': return ReadArray([&] { return SkipValue(depth + 1); });
+        case 't': return literal("true");
+        case 'f': return literal("false");
+        case 'n': return literal("null");
+        default: return skipNumber();
+        }
+    }
+
+private:
+    static constexpr unsigned int MAX_DEPTH = 512;
+
+    bool literal(std::string_view word)
+    {
+        if (m_json.substr(m_pos, word.size()) != word) return Fail("invalid literal");
+        m_pos += word.size();
+        return true;
+    }
+
+    bool skipNumber()
+    {
+        size_t begin = m_pos;
+        while (m_pos < m_json.size()) {
+            char c = m_json[m_pos];
+            if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')) break;
+            ++m_pos;
+        }
+        return m_pos > begin || Fail("expected value");
+    }
+
+    bool readHex4(unsigned int& out)
+    {
+        if (m_pos + 4 > m_json.size()) return Fail("truncated \\u escape");
+        out = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            char c = m_json[m_pos++];
+            out <<= 4;
+            if (c >= '0' && c <= '9') out |= c - '0';
+            else if (c >= 'a' && c <= 'f') out |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') out |= c - 'A' + 10;
+            else return Fail("invalid \\u escape");
+        }
+        return true;
+    }
+
+    static void appendUtf8(std::string& str, unsigned int cp)
+    {
+        if (cp < 0x80) {
+            str += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            str += static_cast<char>(0xC0 | (cp >> 6));
+            str += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            str += static_cast<char>(0xE0 | (cp >> 12));
+            str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            str += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            str += static_cast<char>(0xF0 | (cp >> 18));
+            str += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            str += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // slow path, the string is copied into m_unescaped
+    bool readEscapedString(size_t begin, std::string_view& out)
+    {
+        std::string str(m_json.substr(begin, m_pos - begin));
+        while (m_pos < m_json.size()) {
+            char c = m_json[m_pos++];
+            if (c == '"') {
+                m_unescaped.push_back(std::move(str));
+                out = m_unescaped.back();
+                return true;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) return Fail("control character in string");
+            if (c != '\\') {
+                str += c;
+                continue;
+            }
+            if (m_pos == m_json.size()) break;
+            switch (m_json[m_pos++]) {
+            case '"': str += '"'; break;
+            case '\\': str += '\\'; break;
+            case '/': str += '/'; break;
+            case 'b': str += '\b'; break;
+            case 'f': str += '\f'; break;
+            case 'n': str += '\n'; break;
+            case 'r': str += '\r'; break;
+            case 't': str += '\t'; break;
+            case 'u': {
+                unsigned int cp;
+                if (!readHex4(cp)) return false;
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    unsigned int low;
+                    if (m_json.substr(m_pos, 2) != "\\u") return Fail("unpaired surrogate");
+                    m_pos += 2;
+                    if (!readHex4(low)) return false;
+                    if (low < 0xDC00 || low >= 0xE000) return Fail("unpaired surrogate");
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xDC00 && cp < 0xE000) {
+                    return Fail("unpaired surrogate");
+                }
+                appendUtf8(str, cp);
+                break;
+            }
+            default: return Fail("invalid escape");
+            }
+        }
+        return Fail("unterminated string");
+    }
+
+    std::string_view m_json;
+    size_t m_pos{0};
+    std::deque<std::string>& m_unescaped;
+};
+
+// bit per member, to require each of them once
+enum : unsigned int {
+    HAS_TXID = 1 << 0,
+    HAS_HEX = 1 << 1,
+    HAS_HEIGHT = 1 << 2,
+    HAS_TIME = 1 << 3,
+    HAS_IDX = 1 << 4,
+    HAS_VIN = 1 << 5,
+    HAS_VOUT = 1 << 6,
+    HAS_PREVOUT = 1 << 7,
+    HAS_VALUE = 1 << 8,
+    HAS_SCRIPTPUBKEY = 1 << 9,
+};
+
+//! Reads the member value if it wasn't seen yet, skips it otherwise
+template <typename Fn>
+bool readMember(JsonReader& reader, unsigned int& seen, unsigned int bit, Fn fn)
+{
+    if (seen & bit) return reader.SkipValue();
+    seen |= bit;
+    return fn();
+}
+
+bool readVin(JsonReader& reader, VinView& vin)
+{
+    unsigned int seen = 0;
+    bool ok = reader.ReadObject([&](std::string_view key) {
+        if (key == "txid") return readMember(reader, seen, HAS_TXID, [&] { return reader.ReadString(vin.txid); });
+        if (key == "vout") return readMember(reader, seen, HAS_VOUT, [&] { return reader.ReadUInt(vin.vout); });
+        if (key != "prevout") return reader.SkipValue();
+        return readMember(reader, seen, HAS_PREVOUT, [&] {
+            return reader.ReadObject([&](std::string_view key) {
+                if (key == "value") return readMember(reader, seen, HAS_VALUE, [&] { return reader.ReadUInt(vin.value); });
+                if (key == "height") return readMember(reader, seen, HAS_HEIGHT, [&] { return reader.ReadUInt(vin.height); });
+                if (key != "scriptPubKey") return reader.SkipValue();
+                return readMember(reader, seen, HAS_SCRIPTPUBKEY, [&] {
+                    unsigned int seenHex = 0;
+                    bool ok = reader.ReadObject([&](std::string_view key) {
+                        if (key == "hex") return readMember(reader, seenHex, HAS_HEX, [&] { return reader.ReadString(vin.scriptPubKeyHex); });
+                        return reader.SkipValue();
+                    });
+                    if (ok && !seenHex) return reader.Fail("missing vin prevout.scriptPubKey.hex");
+                    return ok;
+                });
+            });
+        });
+    });
+    if (!ok) return false;
+    unsigned int required = HAS_TXID | HAS_VOUT | HAS_PREVOUT | HAS_VALUE | HAS_HEIGHT | HAS_SCRIPTPUBKEY;
+    if ((seen & required) != required) return reader.Fail("missing vin member");
+    return true;
+}
+
+bool readVins(JsonReader& reader, std::vector<VinView>& vins)
+{
+    return reader.ReadArray([&] {
+        vins.emplace_back();
+        return readVin(reader, vins.back());
+    });
+}
+
+void copyVins(const std::vector<VinView>& views, std::vector<Vin>& vins)
+{
+    vins.reserve(views.size());
+    for (const VinView& v : views) {
+        Vin& vin = vins.emplace_back();
+        vin.txid = v.txid;
+        vin.vout = v.vout;
+        vin.prevout.value = v.value;
+        vin.prevout.height = v.height;
+        vin.prevout.scriptPubKey.hex = v.scriptPubKeyHex;
+    }
+}
+
+} // namespace
+
+bool ReadRawTx(std::string_view json, RawTxView& rawTx, std::string& error)
+{
+    rawTx.vin.clear();
+    rawTx.unescaped.clear();
+
+    JsonReader reader(json, rawTx.unescaped);
+    unsigned int seen = 0;
+    bool ok = reader.ReadObject([&](std::string_view key) {
+        if (key == "txid") return readMember(reader, seen, HAS_TXID, [&] { return reader.ReadString(rawTx.txid); });
+        if (key == "hex") return readMember(reader, seen, HAS_HEX, [&] { return reader.ReadString(rawTx.hex); });
+        if (key == "height") return readMember(reader, seen, HAS_HEIGHT, [&] { return reader.ReadUInt(rawTx.height); });
+        if (key == "time") return readMember(reader, seen, HAS_TIME, [&] { return reader.ReadUInt(rawTx.time); });
+        if (key == "idx") return readMember(reader, seen, HAS_IDX, [&] { return reader.ReadUInt(rawTx.idx); });
+        if (key != "vin") return reader.SkipValue();
+        return readMember(reader, seen, HAS_VIN, [&] { return readVins(reader, rawTx.vin); });
+    });
+
+    // without vin every prevout comes from the context's prevout store
+    unsigned int required = HAS_TXID | HAS_HEX | HAS_HEIGHT | HAS_TIME | HAS_IDX;
+    if (ok && (seen & required) != required) ok = reader.Fail("missing member");
+    if (ok && !reader.AtEnd()) ok = reader.Fail("trailing characters");
+    if (!ok) error = reader.error;
+    return ok;
+}
+
+bool ReadRawBlock(std::string_view json, RawBlockView& rawBlock, std::string& error)
+{
+    rawBlock.vin.clear();
+    rawBlock.unescaped.clear();
+
+    JsonReader reader(json, rawBlock.unescaped);
+    unsigned int seen = 0;
+    bool ok = reader.ReadObject([&](std::string_view key) {
+        if (key == "hex") return readMember(reader, seen, HAS_HEX, [&] { return reader.ReadString(rawBlock.hex); });
+        if (key == "height") return readMember(reader, seen, HAS_HEIGHT, [&] { return reader.ReadUInt(rawBlock.height); });
+        if (key != "vin") return reader.SkipValue();
+        return readMember(reader, seen, HAS_VIN, [&] { return readVins(reader, rawBlock.vin); });
+    });
+
+    // vin may be left out for prevouts the block or the context's prevout store holds
+    unsigned int required = HAS_HEX | HAS_HEIGHT;
+    if (ok && (seen & required) != required) ok = reader.Fail("missing member");
+    if (ok && !reader.AtEnd()) ok = reader.Fail("trailing characters");
+    if (!ok) error = reader.error;
+    return ok;
+}
+
+RawTx::RawTx(const RawTxView& view)
+    : txid(view.txid), hex(view.hex), height(view.height), time(view.time), idx(view.idx)
+{
+    copyVins(view.vin, vin);
+}
+
+static RawTxView readRawTxOrThrow(std::string_view json)
+{
+    RawTxView view;
+    std::string error;
+    if (!ReadRawTx(json, view, error)) {
+        throw std::runtime_error("invalid RawTx json: " + error);
+    }
+    return view;
+}
+
+RawTx::RawTx(const std::string& rawStr) : RawTx(readRawTxOrThrow(rawStr))
+{
+}
+
+RawBlock::RawBlock(const std::string& rawStr)
+{
+    RawBlockView view;
+    if (!ReadRawBlock(rawStr, view, error)) {
+        error = "invalid RawBlock json: " + error;
+        return;
+    }
+    hex = view.hex;
+    height = view.height;
+    copyVins(view.vin, vin);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! Vin of a RawTx json, strings point into the json buffer
+struct VinView {
+    std::string_view txid;
+    unsigned int vout;
+    unsigned int height;
+    uint64_t value;
+    std::string_view scriptPubKeyHex;
+};
+
+//! RawTx json read in place: strings are views over the caller's buffer, which has to outlive it
+struct RawTxView {
+    std::string_view txid;
+    std::string_view hex;
+    std::vector<VinView> vin;
+    // block property
+    unsigned int height;
+    unsigned int time;
+    unsigned int idx;
+
+    //! backing storage of strings that contained escape sequences
+    std::deque<std::string> unescaped;
+};
+
+//! RawBlock json read in place, see RawTxView
+struct RawBlockView {
+    std::string_view hex;
+    std::vector<VinView> vin;
+    unsigned int height;
+
+    //! backing storage of strings that contained escape sequences
+    std::deque<std::string> unescaped;
+};
+
+//! Reads the RawTx json schema without building a UniValue tree, returns false and sets error on malformed input.
+//! Unknown members are skipped, the first occurrence of a duplicated member wins; vin is optional.
+bool ReadRawTx(std::string_view json, RawTxView& rawTx, std::string& error);
+//! Reads the RawBlock json schema (hex, height and an optional vin) the way ReadRawTx does
+bool ReadRawBlock(std::string_view json, RawBlockView& rawBlock, std::string& error);
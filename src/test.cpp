@@ -1,10 +1,506 @@
 #include "omni.h"
+#include "balances.h"
+#include "hex.h"
+#include "parserstate.h"
+#include "payload.h"
+#include "watchlist.h"
+#include <algorithm>
+#include <chainparams.h>
+#include <consensus/merkle.h>
+#include <core_io.h>
+#include <crypto/common.h>
+#include <cstring>
+#include <fs.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <omnicore/omnicore.h>
+#include <omnicore/rules.h>
+#include <omnicore/script.h>
+#include <random.h>
+#include <primitives/block.h>
+#include <script/script.h>
+#include <script/standard.h>
+#include <streams.h>
 #include <tinyformat.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+
+using namespace mastercore;
+
+// The hex string Class A and C extraction that payload.h replaced, as the reference for it
+
+static bool classADataPacketHex(const std::string& push)
+{
+    if (push.size() < 2) return false; // substr(2) would throw
+    std::string strSub = push.substr(2, 16);
+    return "0000000000000001" == strSub || "0000000000000002" == strSub;
+}
+
+static std::vector<unsigned char> classCPayloadHex(const std::vector<CScript>& scripts)
+{
+    std::vector<std::string> op_return_script_data;
+    for (const CScript& script : scripts) {
+        std::vector<std::string> vstrPushes;
+        if (!GetScriptPushes(script, vstrPushes) || vstrPushes.empty()) continue;
+        std::vector<unsigned char> vchMarker = GetOmMarker();
+        std::vector<unsigned char> vchPushed = ParseHex(vstrPushes[0]);
+        if (vchPushed.size() < vchMarker.size()) continue;
+        if (std::equal(vchMarker.begin(), vchMarker.end(), vchPushed.begin())) {
+            vstrPushes[0] = vstrPushes[0].substr(vchMarker.size() * 2);
+            op_return_script_data.insert(op_return_script_data.end(), vstrPushes.begin(), vstrPushes.end());
+        }
+    }
+    std::vector<unsigned char> payload;
+    for (const std::string& data : op_return_script_data) {
+        std::vector<unsigned char> vch = ParseHex(data);
+        size_t size = std::min<size_t>(vch.size(), MAX_PACKETS * PACKET_SIZE - payload.size());
+        payload.insert(payload.end(), vch.begin(), vch.begin() + size);
+        if (MAX_PACKETS * PACKET_SIZE == payload.size()) break;
+    }
+    return payload;
+}
+
+static std::vector<unsigned char> randomPush(FastRandomContext& rng)
+{
+    // mostly small, now and then a PUSHDATA2 and sometimes nothing at all
+    size_t size = rng.randrange(8) ? rng.randrange(80) : rng.randrange(400);
+    std::vector<unsigned char> data = rng.randbytes(size);
+    if (size >= 4 && rng.randbool()) memcpy(data.data(), GetOmMarker().data(), 4);
+    return data;
+}
+
+static bool checkClassA(FastRandomContext& rng)
+{
+    for (int i = 0; i < 100000; ++i) {
+        std::vector<unsigned char> push = rng.randbytes(rng.randrange(4) ? 20 : rng.randrange(24));
+        // make the zero run and the 01/02 of a data packet likely
+        for (size_t j = 1; j < push.size() && j < 8; ++j) {
+            if (rng.randrange(8)) push[j] = 0;
+        }
+        if (push.size() > 8 && rng.randbool()) push[8] = 1 + rng.randrange(3);
+
+        std::string hex = HexStr(push);
+        if (IsClassADataPacket(push) != classADataPacketHex(hex)) {
+            tfm::format(std::cerr, "Class A data packet mismatch: %s\n", hex);
+            return false;
+        }
+        if (IsClassADataPacket(push)) {
+            Span<const unsigned char> packet = Span<const unsigned char>(push).subspan(1, std::min<size_t>(PACKET_SIZE_CLASS_A, push.size() - 1));
+            if (push[0] != ParseHex(hex.substr(0, 2))[0] || HexStr(packet) != hex.substr(2, 2 * PACKET_SIZE_CLASS_A)) {
+                tfm::format(std::cerr, "Class A packet mismatch: %s\n", hex);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool checkClassC(FastRandomContext& rng)
+{
+    for (int i = 0; i < 20000; ++i) {
+        std::vector<CScript> scripts(1 + rng.randrange(3));
+        for (CScript& script : scripts) {
+            script << OP_RETURN;
+            for (size_t n = rng.randrange(5); n > 0; --n) {
+                script << randomPush(rng);
+                if (!rng.randrange(16)) script << OP_DUP;
+            }
+            if (!rng.randrange(16)) script.push_back(OP_PUSHDATA1); // truncated push
+        }
+
+        std::vector<Span<const unsigned char>> pushes;
+        for (const CScript& script : scripts) {
+            GetClassCPushSpans(script, pushes);
+        }
+        unsigned char packet[MAX_PACKETS * PACKET_SIZE];
+        unsigned int size = ConcatClassCPayload(pushes, packet);
+
+        std::vector<unsigned char> expected = classCPayloadHex(scripts);
+        if (size != expected.size() || memcmp(packet, expected.data(), size) != 0) {
+            tfm::format(std::cerr, "Class C payload mismatch: %s\n", HexStr(scripts[0]));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool checkWatchlist(FastRandomContext& rng)
+{
+    Watchlist watch;
+    std::vector<std::vector<unsigned char>> scripts;
+    for (int i = 0; i < 3000; ++i) {
+        scripts.push_back(rng.randbytes(rng.randbool() ? 23 : 25));
+        watch.AddScript(scripts.back());
+    }
+    for (const auto& script : scripts) {
+        if (!watch.HasScript(script)) {
+            tfm::format(std::cerr, "watchlist misses %s\n", HexStr(script));
+            return false;
+        }
+    }
+    // the Bloom filter lets some through, the exact set none of them
+    for (int i = 0; i < 100000; ++i) {
+        std::vector<unsigned char> script = rng.randbytes(25);
+        if (watch.HasScript(script) && std::find(scripts.begin(), scripts.end(), script) == scripts.end()) {
+            tfm::format(std::cerr, "watchlist has %s\n", HexStr(script));
+            return false;
+        }
+    }
+
+    // MetaDEx trade of 31 for 3, simple send of 1
+    watch.AddProperty(3);
+    std::vector<unsigned char> trade = ParseHex("00000019" "0000001f" "0000000000000064" "00000003" "00000000000000c8");
+    std::vector<unsigned char> send = ParseHex("00000000" "00000001" "0000000000000064");
+    uint32_t properties[2];
+    if (GetPayloadProperties(trade, properties) != 2 || properties[0] != 31 || properties[1] != 3 || !watch.HasPayloadProperty(trade) || watch.HasPayloadProperty(send)) {
+        tfm::format(std::cerr, "watchlist payload properties mismatch\n");
+        return false;
+    }
+    // send-all and MetaDEx cancel of the main ecosystem of 3, send-all of the test ecosystem
+    std::vector<unsigned char> sendAll = ParseHex("00000004" "01");
+    std::vector<unsigned char> cancelAll = ParseHex("0000001c" "01");
+    std::vector<unsigned char> sendAllTest = ParseHex("00000004" "02");
+    if (!watch.HasPayloadProperty(sendAll) || !watch.HasPayloadProperty(cancelAll) || watch.HasPayloadProperty(sendAllTest)) {
+        tfm::format(std::cerr, "watchlist ecosystem payloads mismatch\n");
+        return false;
+    }
+    return true;
+}
+
+// the vector hex codec against HexStr and ParseHex, at every length around the vector blocks
+static bool checkHex(FastRandomContext& rng)
+{
+    for (int i = 0; i < 2000; ++i) {
+        std::vector<unsigned char> bytes = rng.randbytes(i % 300);
+        std::string hex(2 * bytes.size(), '\0');
+        EncodeHex(bytes, hex.data());
+        if (hex != HexStr(bytes)) {
+            tfm::format(std::cerr, "hex encode mismatch: %s\n", HexStr(bytes));
+            return false;
+        }
+        std::string upper(hex);
+        EncodeHex(bytes, upper.data(), true);
+        if (upper != ToUpper(hex)) {
+            tfm::format(std::cerr, "upper case hex encode mismatch: %s\n", HexStr(bytes));
+            return false;
+        }
+
+        // mixed case decodes the same, one character that isn't a digit fails the whole input
+        for (char& c : hex) {
+            if (rng.randbool()) c = ToUpper(c);
+        }
+        std::vector<unsigned char> decoded(bytes.size());
+        if (!DecodeHex(hex, decoded.data()) || decoded != bytes) {
+            tfm::format(std::cerr, "hex decode mismatch: %s\n", hex);
+            return false;
+        }
+        if (hex.empty()) continue;
+        hex[rng.randrange(hex.size())] = "g/:@G`\xff "[rng.randrange(8)];
+        if (DecodeHex(hex, decoded.data())) {
+            tfm::format(std::cerr, "hex decode accepts %s\n", hex);
+            return false;
+        }
+    }
+    return true;
+}
+
+static CBlock makeBlock(const uint256& prev, uint32_t time, std::vector<CMutableTransaction> txs)
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.hashPrevBlock = prev;
+    block.nTime = time;
+    block.nBits = 0x207fffff;
+    for (CMutableTransaction& tx : txs) {
+        block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+static CMutableTransaction makeCoinbase(int height, const CScript& script, CAmount value)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << height << OP_0;
+    tx.vout.emplace_back(value, script);
+    return tx;
+}
+
+static void writeBlock(std::ofstream& file, const CChainParams& params, const CBlock& block)
+{
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << block;
+    unsigned char size[4];
+    WriteLE32(size, stream.size());
+    file.write(reinterpret_cast<const char*>(params.MessageStart()), 4);
+    file.write(reinterpret_cast<const char*>(size), 4);
+    file.write(reinterpret_cast<const char*>(stream.data()), stream.size());
+}
+
+// a regtest blocks dir, blocks out of order and a stale one among them, with the standard tx spending a coinbase of the files
+static bool checkBlockFiles(const std::string& rawTx)
+{
+    ParserContext context(CBaseChainParams::REGTEST);
+    const auto params = CreateChainParams(gArgs, CBaseChainParams::REGTEST);
+    OmniTxRecord expected{};
+    context.ParseTxRecord(rawTx.data(), rawTx.size(), &expected);
+
+    CMutableTransaction omniTx;
+    if (expected.status != PARSE_OK || !DecodeHexTx(omniTx, RawTx(rawTx).hex)) {
+        tfm::format(std::cerr, "block files: regtest parse of the standard tx failed\n");
+        return false;
+    }
+    const CBlock& genesis = params->GenesisBlock();
+    CScript sender = CScript() << OP_DUP << OP_HASH160 << ParseHex("88d924f51033b74a895863a5fb57fd545529df7d") << OP_EQUALVERIFY << OP_CHECKSIG;
+    CBlock block1 = makeBlock(genesis.GetHash(), genesis.nTime + 1, {makeCoinbase(1, sender, 433748)});
+    CBlock stale = makeBlock(genesis.GetHash(), genesis.nTime + 2, {makeCoinbase(1, CScript() << OP_TRUE, 50 * COIN)});
+    omniTx.vin[0].prevout = COutPoint(block1.vtx[0]->GetHash(), 0);
+    CBlock block2 = makeBlock(block1.GetHash(), genesis.nTime + 3, {makeCoinbase(2, CScript() << OP_TRUE, 50 * COIN), omniTx});
+
+    fs::path dir = fs::temp_directory_path() / fs::PathFromString("omni_blockfiles_test");
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    {
+        std::ofstream file(fs::PathToString(dir / fs::PathFromString("blk00000.dat")), std::ios::binary);
+        for (const CBlock* block : {&genesis, &block2, &stale, &block1}) {
+            writeBlock(file, *params, *block);
+        }
+    }
+
+    std::vector<std::pair<int, OmniTxRecord>> found;
+    std::string error;
+    bool parsed = context.ParseBlockFiles(fs::PathToString(dir), 0, -1, [&](int height, const std::vector<OmniTxRecord>& records) {
+        for (const OmniTxRecord& record : records) {
+            found.emplace_back(height, record);
+        }
+    }, error);
+    fs::remove_all(dir);
+
+    if (!parsed || found.size() != 1) {
+        tfm::format(std::cerr, "block files: %s, %d Omni txs\n", error, found.size());
+        return false;
+    }
+    const auto& [height, record] = found[0];
+    if (height != 2 || memcmp(record.txid, block2.vtx[1]->GetHash().begin(), 32) != 0 || record.fee != expected.fee || record.amount != expected.amount ||
+        record.type_int != expected.type_int || memcmp(&record.sendingaddress, &expected.sendingaddress, sizeof(OmniAddress)) != 0) {
+        tfm::format(std::cerr, "block files: unexpected Omni tx at height %d\n", height);
+        return false;
+    }
+    return true;
+}
+
+// the standard tx spending the coinbase of its own block, with neither vin nor a prevout store
+static bool checkBlockPrevouts(const std::string& rawTx)
+{
+    std::unique_ptr<OmniTx> expected = ParseTx(RawTx(rawTx));
+    CMutableTransaction omniTx;
+    if (!expected || !DecodeHexTx(omniTx, RawTx(rawTx).hex)) {
+        tfm::format(std::cerr, "block prevouts: parse of the standard tx failed\n");
+        return false;
+    }
+    CScript sender = CScript() << OP_DUP << OP_HASH160 << ParseHex("88d924f51033b74a895863a5fb57fd545529df7d") << OP_EQUALVERIFY << OP_CHECKSIG;
+    CMutableTransaction coinbase = makeCoinbase(817811, sender, 433748);
+    omniTx.vin[0].prevout = COutPoint(coinbase.GetHash(), 0);
+    CBlock block = makeBlock(uint256(), 1700577787, {coinbase, omniTx});
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << block;
+
+    ParserContext context(CBaseChainParams::MAIN);
+    auto parsed = context.ParseBlock(RawBlock(strprintf("{\"height\":817811,\"hex\":\"%s\"}", HexStr(stream))));
+    if (!parsed || parsed->size() != 1 || parsed->status(0) != PARSE_OK) {
+        tfm::format(std::cerr, "block prevouts: %d Omni txs\n", parsed ? parsed->size() : 0);
+        return false;
+    }
+    std::unique_ptr<OmniTx> tx = parsed->take(0);
+    if (tx->amount != expected->amount || tx->fee != expected->fee || tx->sendingaddress != expected->sendingaddress) {
+        tfm::format(std::cerr, "block prevouts: unexpected Omni tx %s\n", tx->txid);
+        return false;
+    }
+
+    // malformed json fails the parse instead of throwing
+    for (const char* json : {"{", "{\"height\":1}", "{\"hex\":\"00\",\"height\":-1}", "[]"}) {
+        if (!RawBlock(json).error.empty() && !context.ParseBlock(RawBlock(json))) continue;
+        tfm::format(std::cerr, "block prevouts: accepts %s\n", json);
+        return false;
+    }
+    return true;
+}
+
+// test ecosystem txs, which no activation height restricts, applied and resumed from a checkpoint
+static bool checkBalances()
+{
+    ParserState state(CBaseChainParams::REGTEST, false, false);
+    fs::path path = fs::temp_directory_path() / fs::PathFromString("omni_balances_test.dat");
+    fs::remove(path);
+
+    OmniPayload create{};
+    create.type = MSC_TYPE_CREATE_PROPERTY_FIXED;
+    create.create_property = {OMNI_PROPERTY_TMSC, MSC_PROPERTY_TYPE_DIVISIBLE, 0, {}, {}, {'T'}, {}, {}, 1000};
+    OmniPayload send{};
+    send.type = MSC_TYPE_SIMPLE_SEND;
+    send.tokens = {TEST_ECO_PROPERTY_1, 400};
+    OmniPayload overdraw = send;
+    overdraw.tokens.amount = 700;
+    std::vector<BalanceTx> block1{{&create, "issuer", ""}};
+    std::vector<BalanceTx> block2{{&send, "issuer", "holder"}, {&overdraw, "issuer", "holder"}};
+
+    std::string error;
+    BalanceEngine balances(state, path, 2);
+    balances.ApplyBlock(1, 1, block1);
+    balances.ApplyBlock(2, 2, block2);
+    balances.ApplyBlock(2, 2, block2); // applied already
+    BalanceEngine resumed(state, path, 2);
+    bool loaded = resumed.Load(error);
+    fs::remove(path);
+
+    if (balances.GetBalance("issuer", TEST_ECO_PROPERTY_1) != 600 || balances.GetBalance("holder", TEST_ECO_PROPERTY_1) != 400 || !balances.IsExact(TEST_ECO_PROPERTY_1)) {
+        tfm::format(std::cerr, "balances: unexpected balances after the sends\n");
+        return false;
+    }
+    if (!loaded || resumed.Height() != 2 || resumed.GetBalance("issuer", TEST_ECO_PROPERTY_1) != 600 || resumed.GetBalance("holder", TEST_ECO_PROPERTY_1) != 400) {
+        tfm::format(std::cerr, "balances: checkpoint not resumed: %s\n", error);
+        return false;
+    }
+
+    // a test ecosystem crowdsale for OMNI is created before the crossover feature and refused from it on
+    int crossoverHeight = ConsensusParams(CBaseChainParams::REGTEST).SPCROWDCROSSOVER_FEATURE_BLOCK;
+    OmniPayload crossover = create;
+    crossover.type = MSC_TYPE_CREATE_PROPERTY_VARIABLE;
+    crossover.create_property.amount = 1;
+    crossover.create_property.property_desired = OMNI_PROPERTY_MSC;
+    crossover.create_property.deadline = std::numeric_limits<int64_t>::max();
+    std::vector<BalanceTx> before{{&crossover, "early", ""}};
+    std::vector<BalanceTx> after{{&crossover, "late", ""}, {&create, "issuer", ""}};
+    resumed.ApplyBlock(crossoverHeight - 1, 3, before);
+    resumed.ApplyBlock(crossoverHeight, 4, after);
+    if (resumed.IsExact(TEST_ECO_PROPERTY_1 + 1) || !resumed.IsExact(TEST_ECO_PROPERTY_1 + 2) || resumed.GetBalance("issuer", TEST_ECO_PROPERTY_1 + 2) != 1000) {
+        tfm::format(std::cerr, "balances: crowdsale crossover not gated on the feature height\n");
+        return false;
+    }
+    return true;
+}
+
+// a second crowdsale of an issuer is refused, but omnicore creates it if the first sold out
+static bool checkCrowdsaleNumbering()
+{
+    ParserState state(CBaseChainParams::REGTEST, false, false);
+    fs::path path = fs::temp_directory_path() / fs::PathFromString("omni_numbering_test.dat");
+    fs::remove(path);
+
+    OmniPayload fixed{};
+    fixed.type = MSC_TYPE_CREATE_PROPERTY_FIXED;
+    fixed.create_property = {OMNI_PROPERTY_TMSC, MSC_PROPERTY_TYPE_DIVISIBLE, 0, {}, {}, {'T'}, {}, {}, 1000};
+    OmniPayload crowdsale = fixed;
+    crowdsale.type = MSC_TYPE_CREATE_PROPERTY_VARIABLE;
+    crowdsale.create_property.amount = 1;
+    crowdsale.create_property.property_desired = TEST_ECO_PROPERTY_1;
+    crowdsale.create_property.deadline = 1000;
+    std::vector<BalanceTx> block1{{&fixed, "issuer", ""}, {&crowdsale, "issuer", ""}, {&crowdsale, "issuer", ""}};
+    std::vector<BalanceTx> block2{{&fixed, "other", ""}};
+
+    std::string error;
+    BalanceEngine balances(state, path, 0);
+    balances.ApplyBlock(1, 1, block1);
+    bool written = balances.Checkpoint(error);
+    BalanceEngine resumed(state, path, 0);
+    bool loaded = resumed.Load(error);
+    fs::remove(path);
+    resumed.ApplyBlock(2, 2, block2);
+
+    // omnicore has 3 or 4 now, the engine numbers it 3
+    if (!written || !loaded || !resumed.IsExact(TEST_ECO_PROPERTY_1) || resumed.IsExact(TEST_ECO_PROPERTY_1 + 2) || resumed.GetBalance("other", TEST_ECO_PROPERTY_1 + 2) != 1000) {
+        tfm::format(std::cerr, "balances: creation after a refused crowdsale counted as exact: %s\n", error);
+        return false;
+    }
+    return true;
+}
+
+// a freeze of a testnet address, parsed on testnet in a process Init'ed for mainnet
+static bool checkFreezeAddress(const std::string& rawTx)
+{
+    ParserContext context(CBaseChainParams::TESTNET);
+    RawTx raw(rawTx);
+    CMutableTransaction tx;
+    if (!DecodeHexTx(tx, raw.hex)) {
+        tfm::format(std::cerr, "freeze: standard tx not decoded\n");
+        return false;
+    }
+    // freeze of property 2147483651 at the testnet P2PKH address of hash
+    std::vector<unsigned char> hash = ParseHex("e4ef869ab7e62584be0c004f20155eefdc647892");
+    std::vector<unsigned char> payload = ParseHex("6f6d6e69" "0000" "00b9" "80000003" "0000000000000064" "6f");
+    payload.insert(payload.end(), hash.begin(), hash.end());
+    tx.vout[0].scriptPubKey = CScript() << OP_RETURN << payload;
+    raw.hex = EncodeHexTx(CTransaction(tx));
+    raw.txid = tx.GetHash().GetHex();
+    std::string json = raw.dumps();
+
+    OmniTxRecord record{};
+    OmniPayload parsed{};
+    int status = context.ParseTxPayload(json.data(), json.size(), &record, &parsed);
+    CScript frozen = GetScriptForDestination(PKHash(uint160(hash)));
+    if (status != PARSE_OK || parsed.type != MSC_TYPE_FREEZE_PROPERTY_TOKENS || parsed.tokens.property != TEST_ECO_PROPERTY_1 ||
+        parsed.tokens.address.size != frozen.size() || memcmp(parsed.tokens.address.script, frozen.data(), frozen.size()) != 0) {
+        tfm::format(std::cerr, "freeze: status %d, frozen address not the testnet one\n", status);
+        return false;
+    }
+    return true;
+}
+
+// more txs than the queue holds, alternately Omni and malformed, each back under its tag
+static bool checkParseQueue(const std::string& rawTx)
+{
+    ParserContext context(CBaseChainParams::MAIN);
+    OmniTxRecord expected{};
+    context.ParseTxRecord(rawTx.data(), rawTx.size(), &expected);
+
+    ParseQueue queue(context, 2, 8);
+    const std::string txs[2] = {rawTx, "{}"};
+    const uint64_t count = 100;
+    uint64_t submitted = 0, completed = 0;
+    while (completed < count) {
+        if (submitted < count) {
+            const std::string& tx = txs[submitted % 2];
+            size_t end = tx.size();
+            uint64_t tag = submitted;
+            submitted += queue.Submit(tx.data(), &end, &tag, 1);
+        }
+        OmniTxRecord record;
+        uint64_t tag;
+        if (!queue.Complete(&record, &tag, 1, submitted < count ? 0 : 1000)) {
+            if (submitted < count) continue;
+            tfm::format(std::cerr, "parse queue: %d of %d txs completed\n", completed, count);
+            return false;
+        }
+        ++completed;
+        bool ok = tag % 2 ? record.status == PARSE_ERR_INPUT : record.status == PARSE_OK && record.amount == expected.amount;
+        if (!ok || tag >= submitted) {
+            tfm::format(std::cerr, "parse queue: unexpected record of tag %d, status %d\n", tag, record.status);
+            return false;
+        }
+    }
+    return queue.InFlight() == 0;
+}
 
 int main(int argc, char const* argv[])
 {
     Init();
     std::string rawTx = "{\"txid\":\"41864b9e4c0d8499b785a47d48ddc0d18b57fd7948513a595ad8d4e7e7399237\",\"height\":817811,\"time\":1700577787,\"idx\":204,\"hex\":\"020000000163d95cfb3d235666cc9f7978217efe6aaade37912be4721ac61ddac713c52e38010000006a473044022042aef05b0fd6ab7d47dd4b9bf03e9311144f17e4159cf90a96ff0d692b698697022025da0f74e0234fe0f5cf56c4af009e6629c180b1a778c8acd513cabc058d94d20121030888863fcb4cdf5b7d33b40e613af35df8f39d576e7972238b0d396cd3fcc3f2feffffff030000000000000000166a146f6d6e6900000000000000030000000000002e9a6f2d0600000000001976a91488d924f51033b74a895863a5fb57fd545529df7d88ac22020000000000001976a914e4ef869ab7e62584be0c004f20155eefdc64789288ac6a7a0c00\",\"vin\":[{\"txid\":\"382ec513c7da1dc61a72e42b9137deaa6afe7e2178799fcc6656233dfb5cd963\",\"vout\":1,\"prevout\":{\"scriptPubKey\":{\"hex\":\"76a91488d924f51033b74a895863a5fb57fd545529df7d88ac\"},\"value\":433748,\"height\":817809}}]}";
     auto ret = ParseTx(RawTx(rawTx));
+    if (!ret) {
+        tfm::format(std::cerr, "ParseTx failed\n");
+        return 1;
+    }
+
+    // byte level payload extraction against the hex string code, on random scripts
+    FastRandomContext rng(true);
+    if (!checkClassA(rng) || !checkClassC(rng) || !checkWatchlist(rng) || !checkHex(rng)) {
+        return 1;
+    }
+
+    if (!checkBlockFiles(rawTx) || !checkBlockPrevouts(rawTx) || !checkBalances() || !checkCrowdsaleNumbering() || !checkParseQueue(rawTx) || !checkFreezeAddress(rawTx)) {
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
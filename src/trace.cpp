@@ -0,0 +1,193 @@
+#include "trace.h"
+#include "omni.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <vector>
+
+namespace {
+
+//! Stream buffer over a fixed array, anything past its end is cut off
+class FixedBuf : public std::streambuf
+{
+public:
+    void Reset(char* begin, size_t size)
+    {
+        setp(begin, begin + size);
+        m_overflow = false;
+    }
+    size_t Size() const
+    {
+        return pptr() - pbase();
+    }
+    bool Overflowed() const
+    {
+        return m_overflow;
+    }
+
+protected:
+    int_type overflow(int_type ch) override
+    {
+        m_overflow = true;
+        return traits_type::eof();
+    }
+
+private:
+    bool m_overflow{false};
+};
+
+struct ThreadStream {
+    FixedBuf buf;
+    std::ostream stream{&buf};
+};
+
+//! Formatting stream of the calling thread, pointed at the slot being written
+ThreadStream& threadStream()
+{
+    thread_local ThreadStream text;
+    return text;
+}
+
+//! Rings of live threads and the undrained ones of exited threads; producers only lock it once per thread, to register
+std::mutex rings_mutex;
+std::vector<std::shared_ptr<TraceRing>> rings;
+uint32_t next_thread = 0;
+//! Dropped() of the rings DrainTrace let go of
+uint64_t retired_dropped = 0;
+
+//! Owner of a thread's ring, marks it exited with the thread
+struct LocalRing {
+    std::shared_ptr<TraceRing> ring;
+
+    ~LocalRing()
+    {
+        ring->Exit();
+    }
+};
+
+void appendJsonString(std::string& out, const char* text, size_t size)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    out += '"';
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char c = text[i];
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                out += "\\u00";
+                out += hexDigits[c >> 4];
+                out += hexDigits[c & 0xF];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+const char* TraceCategoryName(TraceCategory category)
+{
+    switch (category) {
+    case TraceCategory::vin: return "vin";
+    case TraceCategory::parser_data: return "parser_data";
+    case TraceCategory::parser: return "parser";
+    case TraceCategory::script: return "script";
+    case TraceCategory::exo: return "exo";
+    case TraceCategory::parser_dex: return "parser_dex";
+    case TraceCategory::spec: return "spec";
+    case TraceCategory::verbose: return "verbose";
+    case TraceCategory::parser_readonly: return "parser_readonly";
+    }
+    return "unknown";
+}
+
+TraceRing& TraceRing::Local()
+{
+    thread_local LocalRing local{[] {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        auto ring = std::make_shared<TraceRing>(next_thread++);
+        rings.push_back(ring);
+        return ring;
+    }()};
+    return *local.ring;
+}
+
+std::ostream& TraceRing::beginEvent(TraceEvent& event, TraceCategory category)
+{
+    event.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    event.thread = m_thread;
+    event.category = category;
+
+    ThreadStream& text = threadStream();
+    text.buf.Reset(event.text, sizeof(event.text));
+    text.stream.clear();
+    return text.stream;
+}
+
+void TraceRing::endEvent(TraceEvent& event)
+{
+    ThreadStream& text = threadStream();
+    size_t size = text.buf.Size();
+    // PrintToLog lines end in a newline, events are lines already
+    while (size && event.text[size - 1] == '\n') {
+        --size;
+    }
+    event.size = size;
+    event.truncated = text.buf.Overflowed();
+}
+
+std::string DrainTrace(size_t max)
+{
+    std::vector<std::shared_ptr<TraceRing>> drained;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        drained = rings;
+    }
+
+    // one consumer at a time, the rings are single consumer
+    static std::mutex drain_mutex;
+    std::lock_guard<std::mutex> lock(drain_mutex);
+
+    std::string out;
+    size_t left = max;
+    for (const auto& ring : drained) {
+        size_t taken = ring->Drain(left, [&](const TraceEvent& event) {
+            out += strprintf("{\"time\":%u,\"thread\":%u,\"category\":\"%s\",\"text\":", event.time, event.thread, TraceCategoryName(event.category));
+            appendJsonString(out, event.text, event.size);
+            if (event.truncated) out += ",\"truncated\":true";
+            out += "}\n";
+        });
+        if (max) {
+            left -= taken;
+            if (left == 0) break;
+        }
+    }
+
+    // a ring of an exited thread gets no more events, it goes once it is drained
+    std::lock_guard<std::mutex> ringsLock(rings_mutex);
+    rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<TraceRing>& ring) {
+        if (!ring->Exited() || !ring->Empty()) return false;
+        retired_dropped += ring->Dropped();
+        return true;
+    }), rings.end());
+    return out;
+}
+
+uint64_t GetTraceDropped()
+{
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    uint64_t dropped = retired_dropped;
+    for (const auto& ring : rings) {
+        dropped += ring->Dropped();
+    }
+    return dropped;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <tinyformat.h>
+
+/**
+ * Parser trace points.
+ *
+ * PARSER_TRACE(state, category, fmt, args...) is the replacement of
+ *
+ *   if (msc_debug_category) PrintToLog(fmt, args...);
+ *
+ * Building with OMNI_DISABLE_TRACE removes the trace points, arguments included, at compile
+ * time. Otherwise the arguments are only evaluated when the context traces that category, and
+ * the line goes either to the omnicore log or, for contexts created with a trace ring, to the
+ * calling thread's TraceRing, which costs no lock and no allocation.
+ */
+#ifdef OMNI_DISABLE_TRACE
+#define PARSER_TRACE(state, category, ...) \
+    do {                                   \
+    } while (0)
+#else
+#define PARSER_TRACE(state, category, ...)                       \
+    do {                                                         \
+        if ((state).Log().category) {                            \
+            (state).Trace(TraceCategory::category, __VA_ARGS__); \
+        }                                                        \
+    } while (0)
+#endif
+
+//! One per ParserLog flag
+enum class TraceCategory : uint8_t {
+    vin,
+    parser_data,
+    parser,
+    script,
+    exo,
+    parser_dex,
+    spec,
+    verbose,
+    parser_readonly,
+};
+
+const char* TraceCategoryName(TraceCategory category);
+
+//! A trace line as stored in a ring, the text is truncated to fit
+struct TraceEvent {
+    static constexpr size_t TEXT_SIZE = 232;
+
+    uint64_t time;   // nanoseconds since the epoch
+    uint32_t thread; // index of the ring, one per thread that traced
+    TraceCategory category;
+    uint8_t truncated;
+    uint16_t size;
+    char text[TEXT_SIZE];
+};
+
+/**
+ * Single producer, single consumer ring of trace events of one thread.
+ *
+ * The owning thread formats each event in place into the next free slot and publishes it
+ * with a release store; when the ring is full the event is dropped and counted, the producer
+ * never waits. DrainTrace (omni.h) is the consumer and takes events off all rings.
+ */
+class TraceRing
+{
+public:
+    static constexpr size_t CAPACITY = 1024;
+
+    explicit TraceRing(uint32_t thread) : m_thread(thread) {}
+
+    //! Ring of the calling thread, registered on first use; DrainTrace drops it once the thread has exited and it is drained
+    static TraceRing& Local();
+
+    template <typename... Args>
+    void Write(TraceCategory category, const char* fmt, const Args&... args)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= CAPACITY) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        TraceEvent& event = m_events[head % CAPACITY];
+        std::ostream& text = beginEvent(event, category);
+        try {
+            tfm::format(text, fmt, args...);
+        } catch (const tfm::format_error&) {
+            // same as a malformed PrintToLog call: keep what was formatted
+        }
+        endEvent(event);
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    //! Consumer side: calls fn(const TraceEvent&) for up to max (0: all) pending events, returns how many
+    template <typename Fn>
+    size_t Drain(size_t max, Fn fn)
+    {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        if (max && head - tail > max) head = tail + max;
+        for (uint64_t i = tail; i < head; ++i) {
+            fn(m_events[i % CAPACITY]);
+        }
+        m_tail.store(head, std::memory_order_release);
+        return head - tail;
+    }
+
+    uint64_t Dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    //! Consumer side: no event is pending
+    bool Empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_relaxed);
+    }
+
+    //! Set by the owning thread as it exits, after its last event
+    void Exit()
+    {
+        m_exited.store(true, std::memory_order_release);
+    }
+    bool Exited() const
+    {
+        return m_exited.load(std::memory_order_acquire);
+    }
+
+private:
+    //! Stamps the event and returns a stream formatting into its text, reused by the thread
+    std::ostream& beginEvent(TraceEvent& event, TraceCategory category);
+    void endEvent(TraceEvent& event);
+
+    const uint32_t m_thread;
+    alignas(64) std::atomic<uint64_t> m_head{0};
+    alignas(64) std::atomic<uint64_t> m_tail{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<bool> m_exited{false};
+    TraceEvent m_events[CAPACITY];
+};
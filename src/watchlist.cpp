@@ -0,0 +1,98 @@
+#include "watchlist.h"
+#include "payload.h"
+#include <algorithm>
+#include <hash.h>
+
+namespace {
+
+//! Orders the stored scripts against a script to look up, bytewise
+struct ScriptLess {
+    bool operator()(const std::vector<unsigned char>& stored, Span<const unsigned char> script) const
+    {
+        return std::lexicographical_compare(stored.begin(), stored.end(), script.begin(), script.end());
+    }
+    bool operator()(Span<const unsigned char> script, const std::vector<unsigned char>& stored) const
+    {
+        return std::lexicographical_compare(script.begin(), script.end(), stored.begin(), stored.end());
+    }
+};
+
+} // namespace
+
+template <typename Fn>
+void Watchlist::forEachBit(Span<const unsigned char> script, Fn fn) const
+{
+    uint64_t mask = m_bloom.size() * 64 - 1;
+    uint32_t h1 = MurmurHash3(0x4f6d6e69, script);
+    uint32_t h2 = MurmurHash3(0x57617463, script) | 1;
+    for (unsigned int i = 0; i < BLOOM_HASHES; ++i) {
+        fn((h1 + uint64_t{i} * h2) & mask);
+    }
+}
+
+void Watchlist::rebuildBloom()
+{
+    // 16 bits per script, rounded up to a power of 2; three hashes keep false positives well below 1%
+    size_t words = 1;
+    while (words * 64 < m_scripts.size() * 16) words *= 2;
+    m_bloom.assign(words, 0);
+    for (const std::vector<unsigned char>& script : m_scripts) {
+        forEachBit(script, [&](uint64_t bit) { m_bloom[bit / 64] |= uint64_t{1} << (bit % 64); });
+    }
+}
+
+void Watchlist::AddProperty(uint32_t property)
+{
+    auto it = std::lower_bound(m_properties.begin(), m_properties.end(), property);
+    if (it == m_properties.end() || *it != property) m_properties.insert(it, property);
+}
+
+void Watchlist::AddScript(Span<const unsigned char> script)
+{
+    auto it = std::lower_bound(m_scripts.begin(), m_scripts.end(), script, ScriptLess());
+    if (it != m_scripts.end() && !ScriptLess()(script, *it)) return;
+    m_scripts.emplace(it, script.begin(), script.end());
+
+    if (m_bloom.size() * 64 < m_scripts.size() * 16) {
+        rebuildBloom();
+    } else {
+        forEachBit(script, [&](uint64_t bit) { m_bloom[bit / 64] |= uint64_t{1} << (bit % 64); });
+    }
+}
+
+void Watchlist::Clear()
+{
+    m_properties.clear();
+    m_scripts.clear();
+    m_bloom.clear();
+}
+
+bool Watchlist::HasProperty(uint32_t property) const
+{
+    return std::binary_search(m_properties.begin(), m_properties.end(), property);
+}
+
+bool Watchlist::HasPayloadProperty(Span<const unsigned char> payload) const
+{
+    uint32_t properties[2];
+    unsigned int count = GetPayloadProperties(payload, properties);
+    for (unsigned int i = 0; i < count; ++i) {
+        if (HasProperty(properties[i])) return true;
+    }
+    // send-all and the cancel of an ecosystem name no property, but may move any one of theirs
+    uint8_t ecosystem = GetPayloadEcosystem(payload);
+    if (ecosystem) {
+        for (uint32_t property : m_properties) {
+            if (GetPropertyEcosystem(property) == ecosystem) return true;
+        }
+    }
+    return false;
+}
+
+bool Watchlist::HasScript(Span<const unsigned char> script) const
+{
+    if (m_scripts.empty()) return false;
+    bool maybe = true;
+    forEachBit(script, [&](uint64_t bit) { maybe &= (m_bloom[bit / 64] >> (bit % 64)) & 1; });
+    return maybe && std::binary_search(m_scripts.begin(), m_scripts.end(), script, ScriptLess());
+}
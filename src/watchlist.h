@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <span.h>
+#include <vector>
+
+/**
+ * Properties and scriptPubKeys a context watches, for the watch stage of parseTx: an Omni tx
+ * is interpreted only if its payload names a watched property, or is a send-all or cancel of
+ * the ecosystem of one, or its sender or reference is a watched script, every other one ends
+ * as PARSE_FILTERED. Nothing watched means no filter.
+ *
+ * Lookups take no lock and don't allocate. Properties are a sorted vector, there are a handful
+ * at most. Scripts go through a Bloom filter of about 16 bits per script first, which turns
+ * away nearly all of the scripts that aren't watched with three bit tests, and then a sorted
+ * vector of the exact scripts. Adding isn't thread safe.
+ */
+class Watchlist
+{
+public:
+    void AddProperty(uint32_t property);
+    void AddScript(Span<const unsigned char> script);
+    void Clear();
+
+    bool Empty() const
+    {
+        return m_properties.empty() && m_scripts.empty();
+    }
+    bool WatchesProperties() const
+    {
+        return !m_properties.empty();
+    }
+    bool WatchesScripts() const
+    {
+        return !m_scripts.empty();
+    }
+
+    bool HasProperty(uint32_t property) const;
+    //! Whether the payload names a watched property, see GetPayloadProperties, or may move one, see GetPayloadEcosystem
+    bool HasPayloadProperty(Span<const unsigned char> payload) const;
+    bool HasScript(Span<const unsigned char> script) const;
+
+private:
+    static constexpr unsigned int BLOOM_HASHES = 3;
+
+    //! Positions of script in the Bloom filter, double hashing of two MurmurHash3 seeds
+    template <typename Fn>
+    void forEachBit(Span<const unsigned char> script, Fn fn) const;
+    void rebuildBloom();
+
+    std::vector<uint32_t> m_properties;                // sorted
+    std::vector<std::vector<unsigned char>> m_scripts; // sorted
+    std::vector<uint64_t> m_bloom;                     // a power of 2 of bits
+};
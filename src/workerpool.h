@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Fixed-size pool of worker threads consuming a FIFO task queue, may be empty
+class WorkerPool
+{
+public:
+    explicit WorkerPool(unsigned int threads)
+    {
+        m_workers.reserve(threads);
+        for (unsigned int i = 0; i < threads; ++i) {
+            m_workers.emplace_back([this] { Loop(); });
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    unsigned int size() const
+    {
+        return m_workers.size();
+    }
+
+    void Submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+        m_cond.notify_one();
+    }
+
+private:
+    void Loop()
+    {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+                if (m_tasks.empty()) return;
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::function<void()>> m_tasks;
+    std::vector<std::thread> m_workers;
+    bool m_stop{false};
+};
+
+/**
+ * Run fn(i) for every i in [0, count) on the pool, the calling thread included; returns when all are done.
+ *
+ * An exception thrown by fn stops the loop from handing out further indices and is rethrown here once
+ * every helper has finished, so no pool thread still runs fn when the caller unwinds; of several, the
+ * first one caught is rethrown.
+ */
+template <typename Fn>
+void ParallelFor(WorkerPool& pool, size_t count, Fn fn)
+{
+    if (count == 0) return;
+
+    struct State {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::atomic<size_t> next{0};
+        unsigned int running{0};
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+
+    auto work = [state, count, &fn] {
+        for (size_t i = state->next++; i < count; i = state->next++) {
+            try {
+                fn(i);
+            } catch (...) {
+                state->next = count;
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) state->error = std::current_exception();
+            }
+        }
+    };
+
+    unsigned int helpers = std::min<size_t>(pool.size(), count - 1);
+    state->running = helpers;
+    for (unsigned int h = 0; h < helpers; ++h) {
+        pool.Submit([state, work] {
+            work();
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (--state->running == 0) state->cond.notify_all();
+        });
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cond.wait(lock, [&state] { return state->running == 0; });
+    if (state->error) std::rethrow_exception(state->error);
+}
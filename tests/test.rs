@@ -1,8 +1,431 @@
+// A class C simple send of property 3 on mainnet, with its prevout
+const RAW_TX: &str = "{\"txid\":\"41864b9e4c0d8499b785a47d48ddc0d18b57fd7948513a595ad8d4e7e7399237\",\"height\":817811,\"time\":1700577787,\"idx\":204,\"hex\":\"020000000163d95cfb3d235666cc9f7978217efe6aaade37912be4721ac61ddac713c52e38010000006a473044022042aef05b0fd6ab7d47dd4b9bf03e9311144f17e4159cf90a96ff0d692b698697022025da0f74e0234fe0f5cf56c4af009e6629c180b1a778c8acd513cabc058d94d20121030888863fcb4cdf5b7d33b40e613af35df8f39d576e7972238b0d396cd3fcc3f2feffffff030000000000000000166a146f6d6e6900000000000000030000000000002e9a6f2d0600000000001976a91488d924f51033b74a895863a5fb57fd545529df7d88ac22020000000000001976a914e4ef869ab7e62584be0c004f20155eefdc64789288ac6a7a0c00\",\"vin\":[{\"txid\":\"382ec513c7da1dc61a72e42b9137deaa6afe7e2178799fcc6656233dfb5cd963\",\"vout\":1,\"prevout\":{\"scriptPubKey\":{\"hex\":\"76a91488d924f51033b74a895863a5fb57fd545529df7d88ac\"},\"value\":433748,\"height\":817809}}]}";
+
 #[test]
 fn test_omni() {
     omni_sys::init(omni_sys::Chain::Main, true);
-    let raw_str = "{\"txid\":\"41864b9e4c0d8499b785a47d48ddc0d18b57fd7948513a595ad8d4e7e7399237\",\"height\":817811,\"time\":1700577787,\"idx\":204,\"hex\":\"020000000163d95cfb3d235666cc9f7978217efe6aaade37912be4721ac61ddac713c52e38010000006a473044022042aef05b0fd6ab7d47dd4b9bf03e9311144f17e4159cf90a96ff0d692b698697022025da0f74e0234fe0f5cf56c4af009e6629c180b1a778c8acd513cabc058d94d20121030888863fcb4cdf5b7d33b40e613af35df8f39d576e7972238b0d396cd3fcc3f2feffffff030000000000000000166a146f6d6e6900000000000000030000000000002e9a6f2d0600000000001976a91488d924f51033b74a895863a5fb57fd545529df7d88ac22020000000000001976a914e4ef869ab7e62584be0c004f20155eefdc64789288ac6a7a0c00\",\"vin\":[{\"txid\":\"382ec513c7da1dc61a72e42b9137deaa6afe7e2178799fcc6656233dfb5cd963\",\"vout\":1,\"prevout\":{\"scriptPubKey\":{\"hex\":\"76a91488d924f51033b74a895863a5fb57fd545529df7d88ac\"},\"value\":433748,\"height\":817809}}]}";
 
-    let mut ret = omni_sys::parse_tx(raw_str).unwrap();
+    let mut ret = omni_sys::parse_tx(RAW_TX).unwrap();
     println!("{}", ret.dumps());
 }
+
+#[test]
+fn test_omni_batch() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+
+    omni_sys::set_parse_threads(4);
+    let results = omni_sys::parse_txs(&[RAW_TX, "{}", RAW_TX]);
+    assert_eq!(results.len(), 3);
+    assert!(results[0].is_ok());
+    assert_eq!(results[1].as_ref().err(), Some(&-203));
+    let mut tx = results.into_iter().last().unwrap().unwrap();
+    assert_eq!(tx.txid(), "41864b9e4c0d8499b785a47d48ddc0d18b57fd7948513a595ad8d4e7e7399237");
+
+    // the second parse of the same sender is served from the address cache
+    let parser = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    parser.parse_tx(RAW_TX).unwrap();
+    let hits = parser.address_cache_stats().hits;
+    parser.parse_tx(RAW_TX).unwrap();
+    assert!(parser.address_cache_stats().hits > hits);
+}
+
+#[test]
+fn test_prefilter() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+    let omni_hex = "020000000163d95cfb3d235666cc9f7978217efe6aaade37912be4721ac61ddac713c52e38010000006a473044022042aef05b0fd6ab7d47dd4b9bf03e9311144f17e4159cf90a96ff0d692b698697022025da0f74e0234fe0f5cf56c4af009e6629c180b1a778c8acd513cabc058d94d20121030888863fcb4cdf5b7d33b40e613af35df8f39d576e7972238b0d396cd3fcc3f2feffffff030000000000000000166a146f6d6e6900000000000000030000000000002e9a6f2d0600000000001976a91488d924f51033b74a895863a5fb57fd545529df7d88ac22020000000000001976a914e4ef869ab7e62584be0c004f20155eefdc64789288ac6a7a0c00";
+    assert!(omni_sys::is_omni_candidate(omni_hex));
+    assert!(omni_sys::is_omni_candidate(&omni_hex.to_uppercase()));
+    assert!(!omni_sys::is_omni_candidate(&omni_hex.replace("6f6d6e69", "6f6d6e68")));
+}
+
+fn from_hex(hex: &str) -> Vec<u8> {
+    (0..hex.len())
+        .step_by(2)
+        .map(|i| u8::from_str_radix(&hex[i..i + 2], 16).unwrap())
+        .collect()
+}
+
+#[test]
+fn test_omni_bin() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+    let tx = from_hex("020000000163d95cfb3d235666cc9f7978217efe6aaade37912be4721ac61ddac713c52e38010000006a473044022042aef05b0fd6ab7d47dd4b9bf03e9311144f17e4159cf90a96ff0d692b698697022025da0f74e0234fe0f5cf56c4af009e6629c180b1a778c8acd513cabc058d94d20121030888863fcb4cdf5b7d33b40e613af35df8f39d576e7972238b0d396cd3fcc3f2feffffff030000000000000000166a146f6d6e6900000000000000030000000000002e9a6f2d0600000000001976a91488d924f51033b74a895863a5fb57fd545529df7d88ac22020000000000001976a914e4ef869ab7e62584be0c004f20155eefdc64789288ac6a7a0c00");
+    let mut prev_txid = from_hex("382ec513c7da1dc61a72e42b9137deaa6afe7e2178799fcc6656233dfb5cd963");
+    prev_txid.reverse();
+    let script = from_hex("76a91488d924f51033b74a895863a5fb57fd545529df7d88ac");
+
+    let mut raw = omni_sys::RawTxBin::new(&tx, 817811, 1700577787, 204);
+    raw.add_prevout(&prev_txid.try_into().unwrap(), 1, 433748, 817809, &script);
+
+    let mut ret = omni_sys::parse_tx_bin(raw.as_bytes()).unwrap();
+    assert_eq!(ret.txid(), "41864b9e4c0d8499b785a47d48ddc0d18b57fd7948513a595ad8d4e7e7399237");
+    assert!(omni_sys::parse_tx_bin(&raw.as_bytes()[1..]).is_err());
+
+    let record = omni_sys::parse_tx_bin_record(raw.as_bytes());
+    assert!(record.is_omni());
+    assert_eq!(record.propertyid, 3);
+    assert_eq!(record.amount, 11930);
+    assert_eq!(record.sendingaddress(), ret.sendingaddress());
+    assert_eq!(record.referenceaddress(), ret.referenceaddress());
+    assert_eq!(record.fee(), ret.fee());
+}
+
+#[test]
+fn test_parser_chains() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+
+    let main = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    let test = omni_sys::Parser::new(omni_sys::Chain::Test, false);
+
+    // the same class C tx on both chains, from both parsers at once
+    std::thread::scope(|s| {
+        let main_tx = s.spawn(|| main.parse_tx(RAW_TX).unwrap().sendingaddress());
+        let test_tx = s.spawn(|| test.parse_tx(RAW_TX).unwrap().sendingaddress());
+        let main_sender = main_tx.join().unwrap();
+        let test_sender = test_tx.join().unwrap();
+        assert!(main_sender.starts_with('1'));
+        assert!(test_sender.starts_with('m') || test_sender.starts_with('n'));
+    });
+
+    let record = test.parse_tx_record(RAW_TX);
+    assert!(record.is_omni());
+    assert!(test.format_address(&record.sendingaddress).starts_with(['m', 'n']));
+}
+
+#[test]
+fn test_trace_ring() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+
+    let parser = omni_sys::Parser::new_traced(omni_sys::Chain::Main);
+    parser.parse_tx(RAW_TX).unwrap();
+
+    let trace = omni_sys::drain_trace(0);
+    if cfg!(feature = "no-trace") {
+        assert!(trace.is_empty());
+    } else {
+        let line: serde_json::Value = serde_json::from_str(trace.lines().next().unwrap()).unwrap();
+        assert!(line["category"].is_string());
+        assert!(trace.contains("Class C transaction detected"));
+    }
+}
+
+#[test]
+fn test_metrics() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+
+    let parser = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    parser.parse_tx(RAW_TX).unwrap();
+    assert!(parser.parse_tx("{}").is_err());
+
+    let metrics = parser.metrics();
+    assert_eq!(metrics.status_count(0), 1);
+    assert_eq!(metrics.status_count(-203), 1);
+    assert_eq!(metrics.class_count('C'), 1);
+    assert_eq!(metrics.type_count(0), 1);
+    assert_eq!(metrics.stage(6).0, 2); // total
+    assert_eq!(metrics.stage(4).0, 0); // no Class B
+
+    let text = metrics.to_prometheus("chain=\"main\"");
+    assert!(text.contains("omni_parse_stage_seconds_count{chain=\"main\",stage=\"decode\"} 1"));
+    assert!(text.contains("omni_parse_status_total{chain=\"main\",status=\"0\"} 1"));
+}
+
+#[test]
+fn test_prevout_store() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+    // a block paying 13X2AX5NJtBHeVvHp7wEB1EfCZAn36rtcU, then a Class C send from that output, without vin
+    let raw_block = "{\"height\":817810,\"hex\":\"0000002000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000e8be5c6594380517000000000102000000011111111111111111111111111111111111111111111111111111111111111111000000006a476564c7e81e4339dee6505bce425ccda1a18426298daaa9462a02a6111f985607154634dafa616795fdef70e59b18dfa4afe21c9496a3a25d2edd18bfdf7c83ac3145739f377ccc210380411a1fd1ff1647471e0729bd691daf8696176c7af9af2b8862744f7c756f6afeffffff0120a10700000000001976a9141b9db3c1a686f03f45bc414abb12a8734d77afdf88ac927a0c00\",\"vin\":[]}";
+    let raw_str = "{\"txid\":\"c90007eb5581330d6d869a9d67d40f79999d3b7c1d4ae336a483e47f496642f0\",\"height\":817811,\"time\":1700577787,\"idx\":1,\"hex\":\"0200000001d3de2cadaab49f740e0fb0b0cb20fa4a9ab006ba2b9e45b06a99b9926aa26175000000006a4704d3b467f1fc6c0558b5915ef078435b4d87300aa08f78cc4118631908314f06fb0096814885efcd5bfd401d08f425c632003a40df80432e3f359aaeea544ab8c2e55e088feb98210282a5d7325d7d623ef5638b8dc6e8507ceaf39c083fa4ef6d78c6561643ce1a21feffffff030000000000000000166a146f6d6e69000000000000001f0000000005f5e10022020000000000001976a91498d3184179643c73dd9df07d1191247db444927088ac107a0700000000001976a9141b9db3c1a686f03f45bc414abb12a8734d77afdf88ac927a0c00\"}";
+
+    let path = std::env::temp_dir().join(format!("omni-prevouts-{}", std::process::id()));
+    let mut parser = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    assert!(parser.parse_tx(raw_str).is_err());
+
+    // without a store, the send resolves its input in a block that holds both
+    let fund_hex = raw_block.split("\"hex\":\"").nth(1).unwrap().split('"').next().unwrap()[162..].to_string();
+    let send_hex = raw_str.split("\"hex\":\"").nth(1).unwrap().split('"').next().unwrap();
+    let both = format!("{{\"height\":817811,\"hex\":\"{}02{}{}\"}}", "00".repeat(80), fund_hex, send_hex);
+    let mut txs = parser.parse_block(&both).unwrap();
+    assert_eq!(txs.len(), 1);
+    assert_eq!(txs[0].sendingaddress(), "13X2AX5NJtBHeVvHp7wEB1EfCZAn36rtcU");
+    assert_eq!(txs[0].amount(), 100000000);
+
+    // malformed json is an error, not an abort
+    for json in ["{", "{\"height\":817811}", "{\"height\":\"817811\",\"hex\":\"00\"}", "{\"hex\":\"00\",\"height\":1,\"vin\":[{}]}"] {
+        assert!(parser.parse_block(json).is_err());
+    }
+
+    parser.open_prevout_store(path.to_str().unwrap(), 8 << 20).unwrap();
+    assert_eq!(parser.prevout_store_height(), -1);
+    assert!(parser.parse_block(raw_block).unwrap().is_empty());
+    assert_eq!(parser.prevout_store_height(), 817810);
+
+    let mut tx = parser.parse_tx(raw_str).unwrap();
+    assert_eq!(tx.sendingaddress(), "13X2AX5NJtBHeVvHp7wEB1EfCZAn36rtcU");
+    assert_eq!(tx.referenceaddress(), "1Ew4bH9wd51b3eRUGqaQXjVXXjqKbjnvMT");
+    assert_eq!(tx.propertyid(), 31);
+    assert_eq!(tx.amount(), 100000000);
+
+    // its block spends the output, which stays for a parse on confirmation
+    let raw_block = format!("{{\"height\":817811,\"hex\":\"{}01{}\"}}", "00".repeat(80), send_hex);
+    assert_eq!(parser.parse_block(&raw_block).unwrap().len(), 1);
+    assert_eq!(parser.prevout_store_height(), 817811);
+    assert_eq!(parser.parse_tx(raw_str).unwrap().amount(), 100000000);
+
+    drop(parser);
+    std::fs::remove_dir_all(path).unwrap();
+}
+
+#[test]
+fn test_reusable_parser() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+
+    let parser = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    let expected = parser.parse_tx_record(RAW_TX);
+    let mut reusable = parser.reusable();
+    // the buffers left behind by one parse must not leak into the next
+    for _ in 0..3 {
+        let record = reusable.parse_tx_record(RAW_TX);
+        assert!(record.is_omni());
+        assert_eq!(record.txid(), expected.txid());
+        assert_eq!(record.fee(), expected.fee());
+        assert_eq!(record.amount, expected.amount);
+        assert_eq!(record.sendingaddress(), expected.sendingaddress());
+        assert_eq!(record.referenceaddress(), expected.referenceaddress());
+        assert_eq!(reusable.parse_tx_record("{}").status(), -203);
+    }
+}
+
+#[test]
+fn test_parse_cache() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+
+    let parser = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    parser.set_parse_cache_size(1024);
+    let expected = parser.parse_tx_record(RAW_TX);
+    assert!(expected.is_omni());
+    assert_eq!(parser.parse_cache_stats().misses, 1);
+
+    // the same tx a few blocks later, within the same rules
+    let later = RAW_TX.replace("\"height\":817811", "\"height\":817815");
+    let record = parser.parse_tx_record(&later);
+    let stats = parser.parse_cache_stats();
+    assert_eq!(stats.hits, 1);
+    assert_eq!(stats.size, 1);
+    assert_eq!(record.txid(), expected.txid());
+    assert_eq!(record.fee(), expected.fee());
+    assert_eq!(record.amount, expected.amount);
+    assert_eq!(record.sendingaddress(), expected.sendingaddress());
+    assert_eq!(record.referenceaddress(), expected.referenceaddress());
+
+    // other prevouts are another key
+    let other = RAW_TX.replace("\"value\":433748", "\"value\":433749");
+    assert_eq!(parser.parse_tx_record(&other).fee, expected.fee + 1);
+    assert_eq!(parser.parse_cache_stats().misses, 2);
+
+    // the txid the json declares plays no part, another tx under it is parsed on its own
+    let forged = RAW_TX.replace("0000000000002e9a", "0000000000002e9b");
+    assert_eq!(parser.parse_tx_record(&forged).amount, expected.amount + 1);
+    assert_eq!(parser.parse_cache_stats().misses, 3);
+
+    parser.set_parse_cache_size(0);
+    assert_eq!(parser.parse_cache_stats().size, 0);
+}
+
+#[test]
+fn test_watchlist() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+    // a simple send of property 3 from 1DUb2YYbQA1jjaNYzVXLZ7ZioEhLXtbUru to 1MsW1HLBuLvwgRopLdgYdMjLcDB7Y8ZsN1
+    let mut parser = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    parser.watch_property(31).unwrap();
+    assert_eq!(parser.parse_tx_record(RAW_TX).status(), -204);
+    parser.watch_property(3).unwrap();
+    assert!(parser.parse_tx_record(RAW_TX).is_omni());
+
+    parser.clear_watchlist();
+    parser.watch_address("1111111111111111111114oLvT2").unwrap();
+    assert_eq!(parser.parse_tx_record(RAW_TX).status(), -204);
+    for address in ["1DUb2YYbQA1jjaNYzVXLZ7ZioEhLXtbUru", "1MsW1HLBuLvwgRopLdgYdMjLcDB7Y8ZsN1"] {
+        parser.clear_watchlist();
+        parser.watch_property(31).unwrap();
+        parser.watch_address(address).unwrap();
+        assert!(parser.parse_tx_record(RAW_TX).is_omni());
+    }
+    assert!(parser.watch_address("bc1qw508d6qejxtdg4y5r3zarvary0c5xw7kv8f3t4").is_err());
+    assert_eq!(parser.metrics().status_count(-204), 2);
+}
+
+#[test]
+fn test_payload() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+
+    let (record, payload) = omni_sys::parse_tx_payload(RAW_TX);
+    assert!(record.is_omni());
+    assert_eq!(payload, Some(omni_sys::Payload::SimpleSend { property: 3, amount: 11930 }));
+
+    let parser = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    let (record, payload) = parser.parse_tx_payload(RAW_TX);
+    assert_eq!(record.amount, 11930);
+    assert!(matches!(payload, Some(omni_sys::Payload::SimpleSend { property: 3, .. })));
+    let (record, payload) = parser.parse_tx_payload("{}");
+    assert_eq!(record.status(), -203);
+    assert_eq!(payload, None);
+}
+
+#[test]
+fn test_corpus_expect() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+    // Class A, B and C txs, DEx payments and plain txs, each with the result it was built for
+    let corpus = include_str!("../bench/corpus.ndjson");
+
+    let mut lines = 0;
+    for line in corpus.lines() {
+        let sample: serde_json::Value = serde_json::from_str(line).unwrap();
+        let expect = &sample["expect"];
+        let record = omni_sys::parse_tx_record(line);
+        assert_eq!(record.status() as i64, expect["status"].as_i64().unwrap(), "{}", sample["txid"]);
+        if record.is_omni() {
+            assert_eq!(record.type_int as u64, expect["type"].as_u64().unwrap());
+            assert_eq!(record.propertyid as u64, expect["propertyid"].as_u64().unwrap());
+            assert_eq!(record.amount, expect["amount"].as_u64().unwrap());
+            assert_eq!(record.sendingaddress(), expect["sendingaddress"].as_str().unwrap());
+            assert_eq!(record.referenceaddress(), expect["referenceaddress"].as_str().unwrap_or(""));
+        }
+        lines += 1;
+    }
+    assert_eq!(lines, 500);
+}
+
+#[test]
+fn test_balances() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+    let path = std::env::temp_dir().join("omni_sys_test_balances.dat");
+    let _ = std::fs::remove_file(&path);
+
+    let mut parser = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    assert_eq!(parser.balances_height(), -1);
+    parser.open_balances(path.to_str().unwrap(), 0).unwrap();
+    assert_eq!(parser.balance("1MsW1HLBuLvwgRopLdgYdMjLcDB7Y8ZsN1", 31), 0);
+    assert!(!parser.is_balance_exact(1));
+    parser.checkpoint_balances().unwrap();
+
+    let mut resumed = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    resumed.open_balances(path.to_str().unwrap(), 0).unwrap();
+    assert_eq!(resumed.balances_height(), -1);
+    let mut testnet = omni_sys::Parser::new(omni_sys::Chain::Test, false);
+    assert!(testnet.open_balances(path.to_str().unwrap(), 0).is_err());
+
+    // the balances need every Omni tx, a watchlist would filter some
+    assert!(resumed.watch_property(31).is_err());
+    assert!(resumed.watch_address("1MsW1HLBuLvwgRopLdgYdMjLcDB7Y8ZsN1").is_err());
+    let mut watching = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    watching.watch_property(31).unwrap();
+    assert!(watching.open_balances(path.to_str().unwrap(), 0).is_err());
+    std::fs::remove_file(&path).unwrap();
+}
+
+/// Compares the exact balances with omnicore's over real blocks, opt in as it needs chain data:
+/// OMNI_TEST_BLOCKS is a file of mainnet blocks in parse_block's json, one per line in chain
+/// order from before the first Omni tx, and OMNI_TEST_BALANCES omnicore's balances at the last
+/// of them, one "address property balance" line each, balances in the smallest unit
+#[test]
+fn test_balances_omnicore() {
+    let (blocks, expected) = match (std::env::var("OMNI_TEST_BLOCKS"), std::env::var("OMNI_TEST_BALANCES")) {
+        (Ok(blocks), Ok(expected)) => (blocks, expected),
+        _ => return,
+    };
+    let dir = std::env::temp_dir().join("omni_sys_test_balances_omnicore");
+    let _ = std::fs::remove_dir_all(&dir);
+    std::fs::create_dir_all(&dir).unwrap();
+
+    let mut parser = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    parser.open_prevout_store(dir.join("prevouts").to_str().unwrap(), 64 << 20).unwrap();
+    parser.open_balances(dir.join("balances.dat").to_str().unwrap(), 0).unwrap();
+    for block in std::fs::read_to_string(blocks).unwrap().lines() {
+        parser.parse_block(block).unwrap();
+    }
+
+    let mut compared = 0;
+    for line in std::fs::read_to_string(expected).unwrap().lines() {
+        let fields: Vec<&str> = line.split_whitespace().collect();
+        let property: u32 = fields[1].parse().unwrap();
+        if parser.is_balance_exact(property) {
+            assert_eq!(parser.balance(fields[0], property), fields[2].parse::<i64>().unwrap(), "{}", line);
+            compared += 1;
+        }
+    }
+    assert!(compared > 0);
+    std::fs::remove_dir_all(&dir).unwrap();
+}
+
+/// Drives a future on the calling thread, parking it until the future's waker unparks it
+fn block_on<F: std::future::Future>(future: F) -> F::Output {
+    struct Unpark(std::thread::Thread);
+    impl std::task::Wake for Unpark {
+        fn wake(self: std::sync::Arc<Self>) {
+            self.0.unpark();
+        }
+    }
+
+    let waker = std::task::Waker::from(std::sync::Arc::new(Unpark(std::thread::current())));
+    let mut cx = std::task::Context::from_waker(&waker);
+    let mut future = Box::pin(future);
+    loop {
+        if let std::task::Poll::Ready(output) = std::future::Future::poll(future.as_mut(), &mut cx) {
+            return output;
+        }
+        std::thread::park();
+    }
+}
+
+#[test]
+fn test_async_parser() {
+    omni_sys::init(omni_sys::Chain::Main, false);
+
+    let parser = omni_sys::Parser::new(omni_sys::Chain::Main, false);
+    let expected = parser.parse_tx_record(RAW_TX);
+    // more callers than capacity, so some of them wait for a slot
+    let async_parser = parser.async_parser(2, 4);
+    std::thread::scope(|scope| {
+        for i in 0..16 {
+            let async_parser = &async_parser;
+            scope.spawn(move || {
+                for _ in 0..50 {
+                    if i % 2 == 0 {
+                        let record = block_on(async_parser.parse(RAW_TX));
+                        assert!(record.is_omni());
+                        assert_eq!(record.txid(), expected.txid());
+                        assert_eq!(record.amount, expected.amount);
+                    } else {
+                        assert_eq!(block_on(async_parser.parse("{}")).status(), -203);
+                    }
+                }
+            });
+        }
+    });
+    assert_eq!(async_parser.in_flight(), 0);
+
+    // a future dropped after it submitted doesn't hold its slot
+    struct Noop;
+    impl std::task::Wake for Noop {
+        fn wake(self: std::sync::Arc<Self>) {}
+    }
+    let waker = std::task::Waker::from(std::sync::Arc::new(Noop));
+    let mut pending = Box::pin(async_parser.parse(RAW_TX));
+    let _ = std::future::Future::poll(pending.as_mut(), &mut std::task::Context::from_waker(&waker));
+    drop(pending);
+    assert!(block_on(async_parser.parse(RAW_TX)).is_omni());
+
+    // a future polled again while it waits for a slot, then dropped, doesn't take the wakeup
+    // of the one waiting after it
+    let single = parser.async_parser(1, 1);
+    let mut sent = Box::pin(single.parse(RAW_TX));
+    let mut blocked = Box::pin(single.parse(RAW_TX));
+    let mut cx = std::task::Context::from_waker(&waker);
+    let _ = std::future::Future::poll(sent.as_mut(), &mut cx);
+    let _ = std::future::Future::poll(blocked.as_mut(), &mut cx);
+    let _ = std::future::Future::poll(blocked.as_mut(), &mut cx);
+    let next = single.parse(RAW_TX);
+    drop(blocked);
+    assert!(block_on(next).is_omni());
+    drop(sent);
+}